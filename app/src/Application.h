@@ -1,11 +1,15 @@
 #pragma once
 
 #include <audio_processing.h>
+#include <FftPlan.h>
 #include <ArgParse.h>
 #include "spdlog/spdlog.h"
 #include <iomanip>
 #include <Usb.h>
 #include <AudioDrawer.h>
+#include <Metrics.h>
+#include <Tracer.h>
+#include <MockUsbTransport.h>
 
 #include <iostream>
 #include <vector>
@@ -46,6 +50,111 @@ public:
             this->m_sz = std::stoi(value);
             std::cout << "Size option value: " << this->m_sz << std::endl;
         }, false, "An example size option");
+        parser.on("source", [this](const std::string& value) {
+            this->drawer.set_source(value);
+        }, false, "Audio source: ALSA device (hw:0,0), file:path.wav[?pace=fast&loop=1] or synth:sine=440&noise=0.1&click=120[&pace=fast]");
+        parser.on("fft-wisdom", [](const std::string& value) {
+            audio_processing::FftPlanCache::instance().set_wisdom_file(value);
+        }, false, "FFTW wisdom file, loaded at startup and updated when new plans are made");
+        parser.on("fft-effort", [](const std::string& value) {
+            auto& cache = audio_processing::FftPlanCache::instance();
+            if (value == "estimate") cache.set_effort(audio_processing::FftEffort::Estimate);
+            else if (value == "measure") cache.set_effort(audio_processing::FftEffort::Measure);
+            else if (value == "patient") cache.set_effort(audio_processing::FftEffort::Patient);
+            else throw std::runtime_error("Unknown fft-effort: " + value);
+        }, false, "FFTW planning effort: estimate, measure (default) or patient");
+        parser.on("wire-format", [this](const std::string& value) {
+            if (value == "v1") this->drawer.set_wire_format(UsbOutput::WireFormat::Raw);
+            else if (value == "v2") this->drawer.set_wire_format(UsbOutput::WireFormat::Delta);
+            else throw std::runtime_error("Unknown wire-format: " + value);
+        }, false, "USB frame format: v1 (whole frame, default) or v2 (changed spans with periodic keyframes)");
+        parser.on("stft", [this](const std::string& value) {
+            // fft_size[:hop]
+            auto colon = value.find(':');
+            size_t fft_size = std::stoul(value.substr(0, colon));
+            size_t hop = colon == std::string::npos ? fft_size / 4 : std::stoul(value.substr(colon + 1));
+            this->drawer.set_stft(fft_size, hop);
+        }, false, "Sliding STFT independent of the capture period, e.g. 2048:256 (hop defaults to a quarter of the FFT)");
+        parser.on("bands", [this](const std::string& value) {
+            if (value == "resample") this->drawer.set_band_scale(audio_processing::BandScale::Resample);
+            else if (value == "linear") this->drawer.set_band_scale(audio_processing::BandScale::Linear);
+            else if (value == "log") this->drawer.set_band_scale(audio_processing::BandScale::Log);
+            else if (value == "mel") this->drawer.set_band_scale(audio_processing::BandScale::Mel);
+            else throw std::runtime_error("Unknown bands: " + value);
+        }, false, "Spectrum bands: resample (default), linear, log or mel");
+        parser.on("channels", [this](const std::string& value) {
+            this->drawer.set_num_channels(static_cast<uint32_t>(std::stoul(value)));
+        }, false, "Capture channels (default 1); each gets its own spectrum");
+        parser.on("channel-layout", [this](const std::string& value) {
+            if (value == "separate") this->drawer.set_channel_layout(audio_processing::ChannelLayout::Separate);
+            else if (value == "mid-side") this->drawer.set_channel_layout(audio_processing::ChannelLayout::MidSide);
+            else throw std::runtime_error("Unknown channel-layout: " + value);
+        }, false, "Stereo spectra: separate (left/right, default) or mid-side (the main spectrum becomes the downmix)");
+        parser.on("fps", [this](const std::string& value) {
+            this->drawer.set_target_fps(std::stod(value));
+        }, false, "LED refresh rate (default 60)");
+        parser.on("render-latency-ms", [this](const std::string& value) {
+            this->drawer.set_render_latency(std::chrono::microseconds(static_cast<int64_t>(std::stod(value) * 1000)));
+        }, false, "Time from render to the LEDs lighting up; frames use the audio closest to that moment");
+        parser.on("gamma", [this](const std::string& value) {
+            auto config = this->drawer.output_stage();
+            config.gamma = std::stof(value);
+            this->drawer.set_output_stage(config);
+        }, false, "LED gamma correction (default 1, e.g. 2.2)");
+        parser.on("brightness", [this](const std::string& value) {
+            auto config = this->drawer.output_stage();
+            config.brightness = std::stof(value);
+            this->drawer.set_output_stage(config);
+        }, false, "Global brightness, 0..1 (default 1)");
+        parser.on("white-balance", [this](const std::string& value) {
+            auto config = this->drawer.output_stage();
+            size_t first = value.find(',');
+            size_t second = value.find(',', first + 1);
+            if (first == std::string::npos || second == std::string::npos) {
+                throw std::runtime_error("white-balance needs r,g,b: " + value);
+            }
+            config.balance = {std::stof(value.substr(0, first)), std::stof(value.substr(first + 1, second - first - 1)),
+                std::stof(value.substr(second + 1))};
+            this->drawer.set_output_stage(config);
+        }, false, "Per channel scale r,g,b, each 0..1 (default 1,1,1)");
+        parser.on("dither", [this](const std::string& value) {
+            auto config = this->drawer.output_stage();
+            if (value == "on") config.dither = true;
+            else if (value == "off") config.dither = false;
+            else throw std::runtime_error("Unknown dither: " + value);
+            this->drawer.set_output_stage(config);
+        }, false, "Temporal dithering of the gamma corrected levels: on or off (default)");
+        parser.on("max-milliamps", [this](const std::string& value) {
+            auto config = this->drawer.output_stage();
+            config.max_milliamps = std::stof(value);
+            this->drawer.set_output_stage(config);
+        }, false, "Power supply budget for the LEDs in mA, brightness is capped to stay under it (default none)");
+        parser.on("panels", [this](const std::string& value) {
+            std::vector<UsbOutputGroup::Panel> panels;
+            if (UsbOutputGroup::parse_panels(value, panels) != 0 || this->drawer.set_panels(panels) != 0) {
+                throw std::runtime_error("Unable to use panels: " + value);
+            }
+        }, false, "Several controllers, one tile each: 'serial@x,y,wxh[:wiring];...' with wiring rows, serpentine or columns (default: the first device found)");
+        parser.on("metrics-file", [](const std::string& value) {
+            if (Metrics::instance().start_export(value) != 0) {
+                throw std::runtime_error("Unable to write metrics to " + value);
+            }
+        }, false, "Rewrite per stage counters and latency histograms to this file every second (JSON if it ends in .json)");
+        parser.on("trace", [](const std::string& value) {
+            if (Tracer::instance().watch(value) != 0) {
+                throw std::runtime_error("Unable to write a trace to " + value);
+            }
+        }, false, "Record per thread spans and write them to this file as Chrome trace JSON on SIGUSR1 and at exit (SIGUSR2 toggles recording)");
+        parser.on("mock-usb", [this](const std::string& value) {
+            auto transport = std::make_unique<MockUsbTransport>();
+            transport->set_latency(std::chrono::microseconds(std::stoll(value)));
+            if (this->drawer.set_transport(std::move(transport)) != 0) {
+                throw std::runtime_error("Unable to use a mock USB device");
+            }
+        }, false, "Send frames to a fake USB device whose transfers take this many microseconds instead of real hardware");
+        parser.on("latency-report", [this](const std::string& value) {
+            this->m_latency_report = std::chrono::milliseconds(static_cast<int64_t>(std::stod(value) * 1000));
+        }, false, "Run for this many seconds, print p50/p99/max capture to USB latency per stage and exit; use a realtime file: or synth: source with --mock-usb to measure without hardware");
         parser.parse(argc, argv);
     }
 
@@ -172,16 +281,26 @@ public:
         // usb_led_test(u);
         // resample_test();
         drawer.start();
-
+        if (m_latency_report.count() > 0) {
+            AudioDrawer::reset_latency();
+            std::this_thread::sleep_for(m_latency_report);
+            drawer.stop();
+            AudioDrawer::write_latency_report(std::cout);
+        }
     }
 
     void waitForExit() {
-        std::cout << "Press Enter to exit..." << std::endl;
-        std::cin.get();
+        if (m_latency_report.count() == 0) {
+            std::cout << "Press Enter to exit..." << std::endl;
+            std::cin.get();
+        }
+        drawer.stop();
+        Tracer::instance().unwatch();
     }
 
 public:
     ArgParse parser;
     int m_sz = 0;
+    std::chrono::milliseconds m_latency_report{0};
     AudioDrawer drawer;
 };
\ No newline at end of file
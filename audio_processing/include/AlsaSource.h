@@ -0,0 +1,48 @@
+#pragma once
+
+#include <AudioSource.h>
+
+#include <string>
+#include <vector>
+#include <poll.h>
+
+struct _snd_pcm;
+typedef struct _snd_pcm snd_pcm_t;
+struct _snd_pcm_hw_params;
+typedef struct _snd_pcm_hw_params snd_pcm_hw_params_t;
+
+// ALSA capture. By default uses blocking snd_pcm_readi; with mmap enabled the
+// device is opened with SND_PCM_ACCESS_MMAP_INTERLEAVED, waits on the PCM's
+// poll descriptors and can hand out views straight into the ALSA ring buffer.
+class AlsaSource : public AudioSource {
+public:
+    AlsaSource(const std::string& device_name = "hw:0,0", bool mmap = false) : m_device_name(device_name), m_mmap(mmap) {}
+    ~AlsaSource() override;
+
+    int open(AudioFormat& format) override;
+    int read(int16_t* buffer, size_t frames, tp& timestamp, uint64_t& frame_num) override;
+    void close() override;
+    std::string name() const override { return m_device_name; }
+
+    bool has_views() const override { return m_mmap; }
+    int acquire_view(AudioPeriod& view, size_t frames) override;
+    int release_view(const AudioPeriod& view) override;
+
+    uint64_t xruns() const { return m_xruns; }
+
+private:
+    int wait_for_frames(size_t frames);
+    int recover(int err);
+    void read_timestamp(tp& read_time, uint64_t& frame_num);
+
+private:
+    std::string m_device_name;
+    bool m_mmap = false;
+    snd_pcm_t *m_handle = nullptr;
+    snd_pcm_hw_params_t *m_params = nullptr;
+    uint32_t m_num_channels = 2;
+    std::vector<struct pollfd> m_poll_fds;
+    unsigned long m_view_offset = 0;
+    unsigned long m_view_frames = 0;
+    uint64_t m_xruns = 0;
+};
@@ -4,31 +4,73 @@
 #include <AudioProcess.h>
 #include <AudioListener.h>
 #include <Usb.h>
+#include <UsbOutput.h>
+#include <UsbOutputGroup.h>
+#include <RenderScheduler.h>
+#include <Metrics.h>
+#include <memory>
+#include <ostream>
 #include <vector>
-#include <thread>
-#include <mutex>
-#include <condition_variable>
+#include <chrono>
 #include <cstdint>
+#include <string>
 
 class AudioDrawer {
 public:
+    // Time spent in one stage between capture and the USB transfer completing
+    struct LatencyStage {
+        const char* name;
+        Metrics::Histogram::Snapshot snapshot;
+    };
+
     AudioDrawer();
     virtual ~AudioDrawer();
     void start();
     void stop();
+    // Audio source spec, see AudioSource::create
+    void set_source(const std::string& spec) { m_process.set_device_name(spec); }
     void update(const AudioProcess *process);
+    void set_wire_format(UsbOutput::WireFormat format) { m_output.set_wire_format(format); }
+    // Writes to something other than the first USB device, e.g. a MockUsbTransport; only while stopped
+    int set_transport(std::unique_ptr<UsbTransport> transport) { return m_output.set_transport(std::move(transport)); }
+    // Gamma, brightness, white balance, dithering and power cap on the way out
+    const OutputStage::Config& output_stage() const { return m_output_config; }
+    void set_output_stage(const OutputStage::Config& config);
+    // Drives several controllers instead of the first device found, each
+    // showing its tile of a grid sized to cover them all
+    int set_panels(const std::vector<UsbOutputGroup::Panel>& panels);
+    // See AudioProcess::set_stft
+    void set_stft(size_t fft_size, size_t hop_size) { m_process.set_stft(fft_size, hop_size); }
+    void set_band_scale(audio_processing::BandScale scale) { m_process.set_band_scale(scale); }
+    // Captured channels (1 by default), each analysed in one batched FFT
+    void set_num_channels(uint32_t channels) { m_process.set_num_channels(channels); }
+    void set_channel_layout(audio_processing::ChannelLayout layout) { m_process.set_channel_layout(layout); }
+    // LED refresh rate, independent of the capture period
+    void set_target_fps(double fps) { m_scheduler.set_target_fps(fps); }
+    void set_render_latency(std::chrono::microseconds latency) { m_scheduler.set_latency(latency); }
+    UsbOutput::Stats usb_stats() const { return m_output.stats(); }
+    RenderScheduler::Stats render_stats() const { return m_scheduler.stats(); }
+    // Per stage and total, from capture timestamp to USB completion, since the last reset
+    static std::vector<LatencyStage> latency();
+    static void reset_latency();
+    // p50/p99/max of latency() in ms
+    static void write_latency_report(std::ostream& out);
 private:
-    void draw_thread();
-    void draw();
+    void render(const AnalysisFrame& frame);
+    // origin_ns: when the audio being shown was captured, on Metrics::now_ns()'s clock
+    void draw(uint64_t origin_ns);
+    void log_stats();
 private:
     GridData m_grid;
-    std::vector<uint8_t> m_data;
     AudioProcess m_process;
-    Usb m_usb;
-    std::thread m_thread;
-    std::mutex m_mutex;
-    std::condition_variable m_cv;
-    bool m_data_loaded = false;
+    UsbOutput m_output{std::make_unique<Usb>()};
+    OutputStage::Config m_output_config;
+    std::unique_ptr<UsbOutputGroup> m_group;
+    RenderScheduler m_scheduler;
+    std::chrono::steady_clock::time_point m_last_stats;
+    UsbOutput::Stats m_prev_stats;
+    // frames are drawn at the render rate, often more than once; only the first counts for latency.schedule_ns
+    uint64_t m_last_scheduled_frame = UINT64_MAX;
     //m_sample_rate(44100),
     //m_samples_per_frame(1024),
     //m_period(std::chrono::milliseconds(static_cast<int>(1000.0f * m_samples_per_frame / m_sample_rate))),
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <AudioRing.h>
+#include <AudioSource.h>
+
+#include <memory>
 #include <string>
 #include <functional>
 #include <vector>
@@ -8,11 +12,6 @@
 #include <thread>
 #include <chrono>
 
-struct _snd_pcm;
-typedef struct _snd_pcm snd_pcm_t;
-struct _snd_pcm_hw_params;
-typedef struct _snd_pcm_hw_params snd_pcm_hw_params_t;
-
 class AudioListener {
 public:
     AudioListener(const std::string& device_name = "hw:0,0", uint32_t sample_rate = 44100, uint32_t samples_per_frame = 1024, uint32_t num_channels = 2):
@@ -24,21 +23,35 @@ public:
     void set_sample_rate(uint32_t rate) { m_sample_rate = rate; }
     void set_samples_per_frame(uint32_t spf) { m_samples_per_frame = spf; }
     void set_num_channels(uint32_t channels) { m_num_channels = channels; }
-    void set_device_name(const std::string& name) { m_device_name = name; }
+    // Device spec handed to AudioSource::create (hw:0,0, file:..., synth:...)
+    void set_device_name(const std::string& name) { m_device_name = name; m_source.reset(); }
+    // Overrides the device spec with an already built source
+    void set_source(std::unique_ptr<AudioSource> source) { m_source = std::move(source); }
+    uint32_t sample_rate() const { return m_sample_rate; }
+    uint32_t samples_per_frame() const { return m_samples_per_frame; }
+    uint32_t num_channels() const { return m_num_channels; }
     int listen(
         const std::function<void(
             const std::vector<int16_t>&,
             const std::chrono::time_point<std::chrono::high_resolution_clock> &,
             const uint64_t&)>& callback,
         int duration_seconds = 10);
+    // Hands every period to callback on the capture thread. With a source that
+    // has views (ALSA mmap) the period points into the driver's buffer and is only
+    // valid for the duration of the callback; otherwise it points at a scratch buffer.
+    int listen_in_place(const std::function<void(const AudioPeriod&)>& callback, int duration_seconds = 10);
+    // Captures straight into the ring (resized to the negotiated period) without an intermediate copy
+    int listen(AudioRing& ring, int duration_seconds = 10, size_t ring_periods = 8);
     void stop();
     void block_until_stopped();
 
+private:
+    int open_source();
+
 private:
     std::atomic_bool m_stop_flag = true;
     std::thread m_listener_thread;
-    snd_pcm_t *m_handle = nullptr;
-    snd_pcm_hw_params_t *m_params = nullptr;
+    std::unique_ptr<AudioSource> m_source;
     uint32_t m_sample_rate = 44100;
     uint32_t m_samples_per_frame = 1024;
     uint32_t m_num_channels = 2;
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <AudioProcess.h>
+#include <WorkerPool.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Several capture sources analysed by one shared pool of workers instead of a
+// processing thread each. Every source is a full AudioProcess with its own
+// capture ring, spectrum, features and callbacks; its capture thread only
+// schedules a drain of its ring on the pool. A source is drained by at most
+// one worker at a time, so its periods stay in order, and a drain gives the
+// worker back after a few periods so a busy source can't starve the others.
+class AudioPipeline {
+public:
+    struct SourceStats {
+        std::string name;
+        uint64_t processed = 0;
+        uint64_t overruns = 0;
+        size_t max_occupancy = 0;
+    };
+
+    // 0 workers means one per core
+    explicit AudioPipeline(size_t num_workers = 0);
+    virtual ~AudioPipeline();
+
+    // Adds a source (see AudioSource::create for the spec) and returns its
+    // AudioProcess to be configured (channels, bands, callbacks...) before start().
+    AudioProcess& add_source(const std::string& name, const std::string& spec);
+    AudioProcess& add_source(const std::string& name, std::unique_ptr<AudioSource> source);
+    size_t num_sources() const { return m_sources.size(); }
+    AudioProcess& source(size_t index) { return *m_sources[index]->process; }
+    size_t num_workers() const { return m_pool.size(); }
+
+    int start();
+    void stop();
+    std::vector<SourceStats> stats() const;
+    std::vector<WorkerPool::Stats> worker_stats() const { return m_pool.stats(); }
+
+private:
+    AudioPipeline(const AudioPipeline&) = delete;
+    AudioPipeline& operator=(const AudioPipeline&) = delete;
+
+    struct Source {
+        std::string name;
+        std::unique_ptr<AudioProcess> process;
+        // a drain is queued or running
+        std::atomic_bool scheduled = false;
+        std::atomic<uint64_t> processed = 0;
+    };
+
+    void schedule(Source& source);
+    void submit(Source& source);
+    void drain(Source& source);
+
+private:
+    WorkerPool m_pool;
+    std::vector<std::unique_ptr<Source> > m_sources;
+    // drain tasks queued or running
+    std::atomic<size_t> m_in_flight = 0;
+    bool m_running = false;
+};
@@ -1,20 +1,38 @@
 #pragma once
 
 #include <AudioListener.h>
+#include <AudioRing.h>
+#include <FftPlan.h>
+#include <SampleKernels.h>
+#include <Filterbank.h>
+#include <Resampler.h>
+#include <BeatTracker.h>
+#include <SampleHistory.h>
+#include <SpectrumHistory.h>
 
 #include <vector>
 #include <cstdint>
 #include <chrono>
-#include <tuple>
 #include <cmath>
-#include <mutex>
-#include <condition_variable>
+#include <span>
 #include <thread>
 #include <atomic>
 #include <string>
 #include <map>
 #include <functional>
+#include <memory>
 
+namespace audio_processing {
+
+// What the spectra of two channel input are of
+enum class ChannelLayout {
+    // left and right as captured
+    Separate,
+    // (L + R) / 2 and (L - R) / 2, so m_fft is the downmix
+    MidSide,
+};
+
+}
 
 class AudioProcess {
 public:
@@ -24,10 +42,10 @@ public:
         m_num_channels(num_channels),
         m_device_name(device_name),
         //   m_fft_bins(m_samples_per_frame / 2 + 1),
-        m_fft_bins(512),
-        m_history(5),
-        m_history_index(0)
-    {}
+        m_fft_bins(512)
+    {
+        m_history.reset(5, m_fft_bins);
+    }
     virtual ~AudioProcess() { stop(); }
 private:
     AudioProcess(const AudioProcess&) = delete;
@@ -35,25 +53,48 @@ private:
     AudioProcess(AudioProcess&&) = delete;
     AudioProcess& operator=(AudioProcess&&) = delete;
 public:
-    void set_sample_rate(uint32_t rate) { m_sample_rate = rate; }
-    void set_samples_per_frame(uint32_t spf) { m_samples_per_frame = spf; }
-    void set_num_channels(uint32_t channels) { m_num_channels = channels; }
-    void set_device_name(const std::string& name) { m_device_name = name; }
+    void set_sample_rate(uint32_t rate) { m_sample_rate = rate; m_listener.set_sample_rate(rate); }
+    void set_samples_per_frame(uint32_t spf) { m_samples_per_frame = spf; m_listener.set_samples_per_frame(spf); }
+    void set_num_channels(uint32_t channels) { m_num_channels = channels; m_listener.set_num_channels(channels); }
+    void set_device_name(const std::string& name) { m_device_name = name; m_listener.set_device_name(name); }
+    void set_source(std::unique_ptr<AudioSource> source) { m_listener.set_source(std::move(source)); }
+    void set_ring_periods(size_t periods) { m_ring_periods = periods; }
+    // Analyse each period on the capture thread straight out of the source's
+    // buffer (zero copy with ALSA mmap) instead of going through the ring.
+    // Only for when process() is comfortably faster than one period.
+    void set_process_in_place(bool in_place) { m_process_in_place = in_place; }
+    // Analysis window applied before the FFT (Hann by default)
+    void set_window(audio_processing::WindowType type) { m_window_type = type; m_window.reset(0, type); }
+    // How the spectrum is reduced to m_fft_bins bands (Resample, box averaged, by default)
+    void set_band_scale(audio_processing::BandScale scale) { m_band_scale = scale; }
+    void set_channel_layout(audio_processing::ChannelLayout layout) { m_channel_layout = layout; }
+    // Sliding STFT: a fft_size point FFT every hop_size samples from a history
+    // of recent samples, independent of the capture period. fft_size 0 goes
+    // back to one FFT per period. Call before start().
+    void set_stft(size_t fft_size, size_t hop_size) {
+        m_stft_size = fft_size;
+        m_hop_size = hop_size ? hop_size : fft_size;
+        m_samples.reset(0, 0);
+    }
+    const AudioRing& ring() const { return m_ring; }
 public:
     void stop();
     void start();
-    void queue_data(const std::vector<int16_t>& audio_data,
+    // Capture only: periods queue up in ring() and on_period is called on the
+    // capture thread after each one; whoever it notifies calls drain().
+    int start_capture(std::function<void()> on_period);
+    // Processes up to max_periods queued periods, returns how many. Not to be
+    // called concurrently with itself or with start()'s processing thread.
+    size_t drain(size_t max_periods);
+    // Copies a period into the capture ring; for producers other than m_listener
+    void queue_data(std::span<const int16_t> audio_data,
             const std::chrono::time_point<std::chrono::high_resolution_clock>& timestamp,
             const uint64_t& frame_num);
-    void process(const std::vector<int16_t>& audio_data,
+    void process(std::span<const int16_t> audio_data,
             const std::chrono::time_point<std::chrono::high_resolution_clock>& timestamp,
             const uint64_t& frame_num);
-    void set_history_size(size_t size) {
-        m_history.resize(size);
-        for (auto& entry : m_history) {
-            std::get<std::vector<float> >(entry) = std::vector<float>(m_fft_bins, 0.0f);
-        }
-    }
+    // Keeps the last `size` spectra; only allocates when growing past any earlier size
+    void set_history_size(size_t size) { m_history.reset(size, m_fft_bins); }
     void set_num_fft_bins(size_t size) {m_fft_bins = size;}
     void add_process_callback(const std::string& key, const std::function<void(const AudioProcess*)>& cb) {m_callbacks[key] = cb;}
     void remove_process_callback(const std::string& key) {
@@ -64,18 +105,43 @@ public:
     // template <typename DurationType>
     // void set_history_size(const DurationType& dur) { set_history_size(std::round(dur/m_period)); }
 protected:
-    bool detect_beat(const std::vector<int16_t>& audio_data);
-    void compute_fft(const std::vector<int16_t>& audio_data);
+    bool detect_beat(double frame_rate);
+    int prepare_channels(size_t frames);
+    int prepare_stft(size_t num_channels, size_t frames);
+    void process_stft(std::span<const int16_t> audio_data, size_t frames,
+            const std::chrono::time_point<std::chrono::high_resolution_clock>& timestamp,
+            const uint64_t& frame_num);
+    // Runs the FFT on the plan's input and hands the result to the callbacks
+    void publish(const std::chrono::time_point<std::chrono::high_resolution_clock>& timestamp, uint64_t frame_num, double frame_rate);
+    void compute_fft(float* out);
+    // The plan's spectrum down to m_fft_bins bands
+    int reduce_bands(const float* spectrum, float* out);
+    void start_processing_thread();
     void on_beat();
 protected:
     std::thread m_processing_thread;
-    std::vector<std::tuple<std::vector<int16_t>, std::chrono::time_point<std::chrono::high_resolution_clock>, uint64_t> > m_audio_buffer = 
-        std::vector<std::tuple<std::vector<int16_t>, std::chrono::time_point<std::chrono::high_resolution_clock>, uint64_t> >(2);
-    size_t m_buffer_index = 1;
-    size_t m_load_buffer_index = 0;
-    std::mutex m_mutex;
-    std::condition_variable m_cond_var;
+    AudioRing m_ring;
+    size_t m_ring_periods = 8;
+    std::atomic_bool m_capture_ready = false;
+    bool m_process_in_place = false;
     std::map<std::string, std::function<void(const AudioProcess*)> > m_callbacks;
+    audio_processing::FftPlan m_fft_plan;
+    audio_processing::WindowType m_window_type = audio_processing::WindowType::Hann;
+    audio_processing::WindowTable m_window;
+    // Deinterleaved, windowed samples, written straight into the batched FFT's inputs
+    std::vector<float*> m_channels;
+    audio_processing::ChannelLayout m_channel_layout = audio_processing::ChannelLayout::Separate;
+    // Bands of channels after the first, which go to m_history
+    std::vector<AlignedBuffer<float> > m_channel_spectra;
+    audio_processing::BandScale m_band_scale = audio_processing::BandScale::Resample;
+    audio_processing::Filterbank m_filterbank;
+    audio_processing::Resampler m_resampler;
+    audio_processing::BeatTracker m_beat_tracker;
+    size_t m_stft_size = 0;
+    size_t m_hop_size = 0;
+    SampleHistory m_samples;
+    // absolute sample index the next STFT window ends at
+    uint64_t m_next_window_end = 0;
 public:
     std::atomic_bool m_stop = false;
 
@@ -87,14 +153,27 @@ public:
     // // Right channel sample
     // right_channel[i] = buffer[i * 2 + 1];
     float m_bpm = 0;
+    // RMS and peak of the last period, in S16 units
     float m_volume = 0;
-    std::vector<float>* m_fft = nullptr;
+    float m_peak = 0;
+    // The newest spectrum, a row of m_history; empty until the first one
+    std::span<const float> m_fft;
+    // One spectrum per channel (mid and side with ChannelLayout::MidSide),
+    // m_channel_fft[0] is m_fft
+    std::vector<std::span<const float> > m_channel_fft;
+    // RMS and peak of each captured channel, in S16 units
+    std::vector<audio_processing::SampleStats> m_channel_levels;
+    // set for the analysis frame a beat falls in
     bool m_beat_detected = false;
+    bool m_onset = false;
+    // 0 on a beat, rising to 1 just before the next
+    float m_beat_phase = 0;
     size_t m_fft_bins = 0;
-    // vector of time, fft, volume
-    std::vector<std::tuple<std::chrono::time_point<std::chrono::high_resolution_clock>, std::vector<float>, float> > m_history;
-    size_t m_history_index = 0;
+    SpectrumHistory m_history;
     std::chrono::time_point<std::chrono::high_resolution_clock> m_cur_time;
+    uint64_t m_cur_frame = 0;
+    // ring of the last m_history.size() beats, m_last_beat_index is the next to be written
     std::vector<std::chrono::time_point<std::chrono::high_resolution_clock> > m_last_beat_times;
+    size_t m_last_beat_index = 0;
     AudioListener m_listener;
 };
\ No newline at end of file
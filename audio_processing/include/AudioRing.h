@@ -0,0 +1,144 @@
+#pragma once
+
+#include <AlignedBuffer.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+struct AudioPeriod {
+    int16_t* samples = nullptr;
+    size_t num_samples = 0;
+    std::chrono::time_point<std::chrono::high_resolution_clock> timestamp;
+    uint64_t frame_num = 0;
+
+    std::span<const int16_t> view() const { return {samples, num_samples}; }
+};
+
+// Preallocated single-producer/single-consumer ring of capture periods.
+// The producer (capture thread) writes samples straight into write_slot() and
+// publishes them with commit(); it never blocks. When every slot is still
+// unprocessed the period goes into a spare slot and is dropped (counted as an
+// overrun) so the slot being read is never touched. The consumer waits on an
+// atomic sequence number, so no mutex is shared between the two threads.
+class AudioRing {
+public:
+    static constexpr size_t CACHE_LINE = 64;
+
+    AudioRing(size_t num_periods = 8, size_t samples_per_period = 2048) { resize(num_periods, samples_per_period); }
+
+    // Not thread safe, call before the producer and consumer are started
+    void resize(size_t num_periods, size_t samples_per_period) {
+        if (num_periods < 2) num_periods = 2;
+        // keep every period on its own cache lines
+        const size_t per_line = CACHE_LINE / sizeof(int16_t);
+        m_stride = (samples_per_period + per_line - 1) / per_line * per_line;
+        m_samples_per_period = samples_per_period;
+        m_periods.resize(num_periods + 1);
+        m_samples.resize(m_stride * (num_periods + 1));
+        for (size_t i = 0; i < m_periods.size(); ++i) {
+            m_periods[i].samples = m_samples.data() + i * m_stride;
+            m_periods[i].num_samples = 0;
+        }
+        m_capacity = num_periods;
+        m_head.store(0);
+        m_tail.store(0);
+        m_overruns.store(0);
+        m_committed.store(0);
+        m_max_occupancy.store(0);
+    }
+
+    size_t capacity() const { return m_capacity; }
+    size_t samples_per_period() const { return m_samples_per_period; }
+    // Called on the producer thread after every committed period, for
+    // consumers that are scheduled rather than waiting. Set before starting.
+    void set_notify(std::function<void()> notify) { m_notify = std::move(notify); }
+
+    // Producer: buffer of samples_per_period() samples to capture into
+    int16_t* write_slot() {
+        auto head = m_head.load(std::memory_order_relaxed);
+        m_writing_spare = head - m_tail.load(std::memory_order_acquire) >= m_capacity;
+        return m_writing_spare ? m_periods[m_capacity].samples : m_periods[head % m_capacity].samples;
+    }
+
+    // Producer: publish what was captured into write_slot(), returns false if it was dropped
+    bool commit(size_t num_samples, const std::chrono::time_point<std::chrono::high_resolution_clock>& timestamp, uint64_t frame_num) {
+        if (m_writing_spare) {
+            m_overruns.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        auto head = m_head.load(std::memory_order_relaxed);
+        auto& period = m_periods[head % m_capacity];
+        period.num_samples = num_samples;
+        period.timestamp = timestamp;
+        period.frame_num = frame_num;
+        m_head.store(head + 1, std::memory_order_release);
+        m_committed.fetch_add(1, std::memory_order_relaxed);
+        auto occupancy = head + 1 - m_tail.load(std::memory_order_relaxed);
+        if (occupancy > m_max_occupancy.load(std::memory_order_relaxed)) {
+            m_max_occupancy.store(occupancy, std::memory_order_relaxed);
+        }
+        wake();
+        if (m_notify) {
+            m_notify();
+        }
+        return true;
+    }
+
+    // Consumer: oldest unprocessed period, or nullptr when empty
+    const AudioPeriod* read_slot() const {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &m_periods[tail % m_capacity];
+    }
+
+    // Consumer: hand the period returned by read_slot() back to the producer
+    void release() {
+        m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer: block until there is data or stop is set (set it before calling wake())
+    void wait(const std::atomic_bool& stop) {
+        auto seq = m_sequence.load(std::memory_order_acquire);
+        if (read_slot() == nullptr && !stop.load()) {
+            m_sequence.wait(seq, std::memory_order_acquire);
+        }
+    }
+
+    void wake() {
+        m_sequence.fetch_add(1, std::memory_order_release);
+        m_sequence.notify_one();
+    }
+
+    size_t occupancy() const { return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire); }
+    size_t max_occupancy() const { return m_max_occupancy.load(std::memory_order_relaxed); }
+    uint64_t overruns() const { return m_overruns.load(std::memory_order_relaxed); }
+    uint64_t committed() const { return m_committed.load(std::memory_order_relaxed); }
+
+private:
+    AudioRing(const AudioRing&) = delete;
+    AudioRing& operator=(const AudioRing&) = delete;
+
+private:
+    // producer owned
+    alignas(CACHE_LINE) std::atomic<size_t> m_head{0};
+    bool m_writing_spare = false;
+    std::atomic<uint64_t> m_overruns{0};
+    std::atomic<uint64_t> m_committed{0};
+    std::atomic<size_t> m_max_occupancy{0};
+    // consumer owned
+    alignas(CACHE_LINE) std::atomic<size_t> m_tail{0};
+    alignas(CACHE_LINE) std::atomic<uint32_t> m_sequence{0};
+    alignas(CACHE_LINE) size_t m_capacity = 0;
+    size_t m_samples_per_period = 0;
+    size_t m_stride = 0;
+    std::vector<AudioPeriod> m_periods;
+    AlignedBuffer<int16_t, CACHE_LINE> m_samples;
+    std::function<void()> m_notify;
+};
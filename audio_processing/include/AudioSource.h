@@ -0,0 +1,66 @@
+#pragma once
+
+#include <AudioRing.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+struct AudioFormat {
+    uint32_t sample_rate = 44100;
+    uint32_t num_channels = 2;
+    uint32_t frames_per_period = 1024;
+};
+
+// Where AudioListener gets its samples from. Samples are interleaved S16.
+class AudioSource {
+public:
+    using tp = std::chrono::time_point<std::chrono::high_resolution_clock>;
+    // read() result once a finite source has nothing left
+    static constexpr int END_OF_STREAM = -1000;
+
+    virtual ~AudioSource() = default;
+    // Prepares the source; format is updated with what was actually negotiated
+    virtual int open(AudioFormat& format) = 0;
+    // Reads up to `frames` frames into buffer. Returns the number of frames read
+    // (0 after a recovered error), or < 0 when capture cannot continue.
+    virtual int read(int16_t* buffer, size_t frames, tp& timestamp, uint64_t& frame_num) = 0;
+    virtual void close() = 0;
+    virtual std::string name() const = 0;
+
+    // Zero-copy capture for sources that can expose their own buffer (ALSA mmap).
+    // Points view at up to `frames` captured frames in place and returns how many;
+    // the memory stays valid until release_view().
+    virtual bool has_views() const { return false; }
+    virtual int acquire_view(AudioPeriod&, size_t) { return -1; }
+    virtual int release_view(const AudioPeriod&) { return 0; }
+
+    // Builds a source from a device spec:
+    //   hw:0,0 / default / plughw:...                    ALSA capture device (?mmap=1 for mmap/poll capture)
+    //   file:song.wav?pace=fast&loop=1                   WAV file (raw PCM with rate= and channels=)
+    //   synth:sine=440,1000&noise=0.1&click=120&pace=fast  generated signal
+    static std::unique_ptr<AudioSource> create(const std::string& spec);
+    static void parse_spec(const std::string& spec, std::string& scheme, std::string& path, std::map<std::string, std::string>& params);
+    // A spec parameter that must be a finite number, all of it; -1 otherwise
+    static int parse_number(const std::string& text, double& value);
+};
+
+// Sample clock for sources that are not driven by hardware. In realtime mode
+// advance() sleeps until the period would have been captured; otherwise it
+// returns immediately so the pipeline runs as fast as it can.
+class SourceClock {
+public:
+    void reset(uint32_t sample_rate, bool realtime);
+    AudioSource::tp advance(size_t frames);
+    uint64_t position() const { return m_position; }
+    bool realtime() const { return m_realtime; }
+
+private:
+    bool m_realtime = true;
+    uint32_t m_sample_rate = 44100;
+    uint64_t m_position = 0;
+    AudioSource::tp m_start;
+};
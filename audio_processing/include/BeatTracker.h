@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace audio_processing {
+
+// Onset detection and tempo/beat tracking over a stream of spectrum frames.
+//
+// Onsets: spectral flux of the log compressed bands, picked when a local peak
+// rises above a running median of recent flux values.
+// Tempo: an autocorrelation of the flux kept per candidate beat period and
+// updated incrementally, weighted towards ~120 BPM to avoid octave jumps.
+// Beats: a phase accumulator running at that tempo and pulled towards onsets
+// that land near a predicted beat.
+// Every frame costs O(bands + candidate periods), no history is rescanned.
+class BeatTracker {
+public:
+    static constexpr double MIN_BPM = 60.0;
+    static constexpr double MAX_BPM = 200.0;
+
+    // frame_rate: spectrum frames per second
+    void reset(double frame_rate);
+    // Feeds one frame of band magnitudes, returns true when a beat falls in it
+    bool process(const float* bands, size_t num_bands);
+
+    double frame_rate() const { return m_frame_rate; }
+    float bpm() const { return m_bpm; }
+    // 0 on a beat, rising to 1 just before the next
+    float phase() const { return static_cast<float>(m_phase); }
+    // The previous frame was an onset (peak picking needs one frame of look ahead)
+    bool onset() const { return m_onset; }
+    float flux() const { return m_flux; }
+
+private:
+    float median() const;
+    void update_tempo(float novelty);
+    bool update_phase();
+
+private:
+    double m_frame_rate = 0;
+    uint64_t m_frames = 0;
+    std::vector<float> m_prev_bands;
+
+    // onset detection
+    std::vector<float> m_flux_window;
+    std::vector<float> m_sorted;
+    size_t m_flux_pos = 0;
+    float m_flux = 0;
+    float m_prev_flux = 0;
+    uint64_t m_last_onset = 0;
+    size_t m_min_onset_gap = 1;
+    bool m_onset = false;
+
+    // tempo, lags are in frames
+    size_t m_min_lag = 1;
+    size_t m_max_lag = 1;
+    std::vector<float> m_novelty;
+    size_t m_novelty_pos = 0;
+    std::vector<float> m_autocorr;
+    std::vector<float> m_score;
+    std::vector<float> m_prior;
+    float m_decay = 0.99f;
+    double m_period = 0;
+    float m_bpm = 0;
+
+    // beat phase
+    double m_phase = 0;
+    size_t m_missed = 0;
+    bool m_locked = false;
+};
+
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+struct fftwf_plan_s;
+typedef struct fftwf_plan_s* fftwf_plan;
+
+namespace audio_processing {
+
+enum class FftKind {
+    Dct2,        // FFTW_REDFT10, what audio_processing::fft has always computed
+    HalfComplex, // FFTW_R2HC
+};
+
+enum class FftEffort {
+    Estimate,
+    Measure,
+    Patient,
+};
+
+// Process-wide cache of FFTW plans keyed by (size, kind, alignment, howmany).
+// Plans are created once (with FFTW_MEASURE by default) and reused for the
+// life of the process through the thread-safe new-array execute interface.
+// alignment is 0 for arrays with FFTW's SIMD alignment, -1 for anything else
+// (those get an FFTW_UNALIGNED plan). howmany > 1 gets one batched plan over
+// that many transforms, batch_stride(size) floats apart.
+class FftPlanCache {
+public:
+    static FftPlanCache& instance();
+    ~FftPlanCache();
+
+    fftwf_plan get(size_t size, FftKind kind, int alignment, size_t howmany = 1);
+    static int alignment_of(const float* in, const float* out);
+    // size rounded up to a cache line, so every transform in a batch starts aligned
+    static size_t batch_stride(size_t size) { return (size + 15) / 16 * 16; }
+
+    void set_effort(FftEffort effort);
+    FftEffort effort() const { return m_effort; }
+    // Loads wisdom from path (if it exists) and re-exports it there whenever a new plan is made
+    int set_wisdom_file(const std::string& path);
+    int save_wisdom();
+    void clear();
+    size_t size();
+
+private:
+    FftPlanCache() = default;
+    FftPlanCache(const FftPlanCache&) = delete;
+    FftPlanCache& operator=(const FftPlanCache&) = delete;
+
+private:
+    std::mutex m_mutex;
+    std::map<std::tuple<size_t, FftKind, int, size_t>, fftwf_plan> m_plans;
+    FftEffort m_effort = FftEffort::Measure;
+    std::string m_wisdom_file;
+};
+
+// Reusable transform of a fixed size with its own FFTW-aligned buffers.
+// Fill input(), call execute(), read output(). Cheap to keep across frames;
+// the underlying plan is shared through FftPlanCache. With howmany > 1 there
+// are that many inputs and outputs (e.g. one per channel) laid out back to
+// back, and execute() transforms them all in one FFTW call.
+class FftPlan {
+public:
+    FftPlan() = default;
+    FftPlan(size_t size, FftKind kind = FftKind::Dct2, size_t howmany = 1);
+    ~FftPlan();
+    FftPlan(FftPlan&& other) noexcept;
+    FftPlan& operator=(FftPlan&& other) noexcept;
+
+    int reset(size_t size, FftKind kind = FftKind::Dct2, size_t howmany = 1);
+    bool valid() const { return m_plan != nullptr; }
+    size_t size() const { return m_size; }
+    size_t howmany() const { return m_howmany; }
+    FftKind kind() const { return m_kind; }
+    float* input(size_t index = 0) { return m_in + index * m_stride; }
+    float* output(size_t index = 0) { return m_out + index * m_stride; }
+    const float* output(size_t index = 0) const { return m_out + index * m_stride; }
+    void execute();
+
+private:
+    FftPlan(const FftPlan&) = delete;
+    FftPlan& operator=(const FftPlan&) = delete;
+    void release();
+
+private:
+    fftwf_plan m_plan = nullptr;
+    size_t m_size = 0;
+    size_t m_howmany = 1;
+    size_t m_stride = 0;
+    FftKind m_kind = FftKind::Dct2;
+    float* m_in = nullptr;
+    float* m_out = nullptr;
+};
+
+}
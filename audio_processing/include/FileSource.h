@@ -0,0 +1,41 @@
+#pragma once
+
+#include <AudioSource.h>
+
+#include <map>
+#include <string>
+
+// Plays back a WAV (16-bit PCM) or headerless S16_LE file through a read-only mmap.
+class FileSource : public AudioSource {
+public:
+    FileSource(const std::string& path, const std::map<std::string, std::string>& params = {});
+    ~FileSource() override;
+
+    int open(AudioFormat& format) override;
+    int read(int16_t* buffer, size_t frames, tp& timestamp, uint64_t& frame_num) override;
+    void close() override;
+    std::string name() const override { return "file:" + m_path; }
+
+    size_t total_frames() const { return m_total_frames; }
+
+private:
+    int parse_wav(AudioFormat& format);
+
+private:
+    std::string m_path;
+    bool m_raw = false;
+    bool m_loop = false;
+    bool m_realtime = true;
+    uint32_t m_raw_rate = 44100;
+    uint32_t m_raw_channels = 2;
+    // a bad parameter, reported by open()
+    std::string m_param_error;
+    int m_fd = -1;
+    const uint8_t* m_map = nullptr;
+    size_t m_map_size = 0;
+    const int16_t* m_samples = nullptr;
+    size_t m_total_frames = 0;
+    size_t m_cursor = 0;
+    uint32_t m_num_channels = 2;
+    SourceClock m_clock;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <AlignedBuffer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace audio_processing {
+
+enum class BandScale {
+    // the raw spectrum squeezed with a Resampler
+    Resample,
+    Linear,
+    Log,
+    Mel,
+};
+
+// Triangular bands over an FFT spectrum, built once and applied every frame.
+// Every band covers a contiguous run of bins, so the weights are stored as one
+// run per band (first bin, offset into the weight array) and applied with
+// band_sums(). Weights of a band add up to 1, making a band the average
+// magnitude of its bins; a band narrower than a bin takes the nearest bin.
+class Filterbank {
+public:
+    Filterbank() = default;
+
+    // num_bins spectrum bins bin_hz apart. max_hz 0 means up to the last bin.
+    int build(size_t num_bins, double bin_hz, size_t num_bands, BandScale scale, double min_hz = 30.0, double max_hz = 0.0);
+    // out has num_bands() floats
+    void apply(const float* spectrum, float* out) const;
+    void apply_scalar(const float* spectrum, float* out) const;
+
+    size_t num_bins() const { return m_num_bins; }
+    size_t num_bands() const { return m_first_bins.size(); }
+    size_t num_weights() const { return m_weights.size(); }
+    double bin_hz() const { return m_bin_hz; }
+    BandScale scale() const { return m_scale; }
+    // Centre frequency of a band
+    double center_hz(size_t band) const { return m_centers[band]; }
+
+private:
+    size_t m_num_bins = 0;
+    double m_bin_hz = 0;
+    BandScale m_scale = BandScale::Mel;
+    std::vector<uint32_t> m_first_bins;
+    // num_bands + 1 entries
+    std::vector<uint32_t> m_offsets;
+    AlignedBuffer<float> m_weights;
+    std::vector<double> m_centers;
+};
+
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class AudioProcess;
+
+// What a frame is drawn from: a copy of one AudioProcess result
+struct AnalysisFrame {
+    // when the audio was captured
+    std::chrono::time_point<std::chrono::high_resolution_clock> timestamp;
+    // when its analysis was handed to the scheduler
+    std::chrono::time_point<std::chrono::high_resolution_clock> analysed;
+    uint64_t frame_num = 0;
+    float volume = 0;
+    bool beat = false;
+    float bpm = 0;
+    float beat_phase = 0;
+    std::vector<float> fft;
+};
+
+// Renders at a fixed target FPS, independent of the capture period. Results
+// are pushed from the processing thread with their capture timestamps; for each
+// frame the scheduler picks the one closest to when the frame will be shown
+// (now + latency). A frame whose best result is older than stale_after is
+// dropped, and when rendering or the output falls behind by whole frames those
+// deadlines are skipped rather than rendered in a burst.
+class RenderScheduler {
+public:
+    using clock = std::chrono::steady_clock;
+    using tp = std::chrono::time_point<std::chrono::high_resolution_clock>;
+
+    struct Stats {
+        double target_fps = 0;
+        // over the last stats window
+        double fps = 0;
+        double jitter_ms = 0;
+        double max_late_ms = 0;
+        uint64_t rendered = 0;
+        // no result close enough to the presentation time
+        uint64_t stale = 0;
+        // deadlines missed because a frame took too long
+        uint64_t skipped = 0;
+    };
+
+    RenderScheduler(size_t history = 16) : m_frames(history < 2 ? 2 : history) {}
+    virtual ~RenderScheduler() { stop(); }
+
+    void set_target_fps(double fps);
+    // Time from render to light, e.g. the USB transfer
+    void set_latency(std::chrono::microseconds latency) { m_latency = latency; }
+    void set_stale_after(std::chrono::microseconds stale_after) { m_stale_after = stale_after; }
+
+    // Processing thread: keep a copy of the latest result
+    void push(const AudioProcess& process);
+    void push(const AnalysisFrame& frame);
+
+    int start(const std::function<void(const AnalysisFrame&)>& render);
+    void stop();
+    Stats stats() const;
+
+    // Closest result to `target`, false when there is none
+    bool select(const tp& target, AnalysisFrame& out) const;
+
+private:
+    RenderScheduler(const RenderScheduler&) = delete;
+    RenderScheduler& operator=(const RenderScheduler&) = delete;
+
+    void run();
+    void record(clock::time_point deadline, clock::time_point woke);
+
+private:
+    std::vector<AnalysisFrame> m_frames;
+    size_t m_next = 0;
+    size_t m_count = 0;
+    mutable std::mutex m_frames_mutex;
+
+    std::function<void(const AnalysisFrame&)> m_render;
+    std::thread m_thread;
+    std::atomic_bool m_stop = true;
+    std::atomic<clock::duration> m_period{std::chrono::microseconds(1000000 / 60)};
+    std::chrono::microseconds m_latency{0};
+    std::chrono::microseconds m_stale_after{std::chrono::milliseconds(100)};
+
+    // frame timing, window is reset every STATS_WINDOW
+    mutable std::mutex m_stats_mutex;
+    Stats m_stats;
+    clock::time_point m_window_start;
+    clock::time_point m_last_render;
+    uint64_t m_window_frames = 0;
+    double m_window_sum = 0;
+    double m_window_sum_sq = 0;
+    double m_window_max_late = 0;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <AlignedBuffer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace audio_processing {
+
+enum class ResampleMode {
+    // interpolates between the two nearest inputs
+    Linear,
+    // averages every input an output covers (falls back to Linear when upsampling)
+    Box,
+};
+
+// Resamples a fixed size input to a fixed size output. Indices and weights
+// are worked out once in reset(); every call is then a gather of `taps()`
+// inputs per output, see gather_sums(). Input i is taken as the centre of
+// [i, i + 1), so both ends line up whatever the ratio.
+class Resampler {
+public:
+    Resampler() = default;
+    Resampler(size_t input_size, size_t output_size, ResampleMode mode = ResampleMode::Linear) { reset(input_size, output_size, mode); }
+
+    int reset(size_t input_size, size_t output_size, ResampleMode mode = ResampleMode::Linear);
+    // in has input_size() floats, out output_size()
+    void process(const float* in, float* out) const;
+    void process_scalar(const float* in, float* out) const;
+
+    size_t input_size() const { return m_input_size; }
+    size_t output_size() const { return m_output_size; }
+    ResampleMode mode() const { return m_mode; }
+    size_t taps() const { return m_taps; }
+
+private:
+    size_t m_input_size = 0;
+    size_t m_output_size = 0;
+    ResampleMode m_mode = ResampleMode::Linear;
+    size_t m_taps = 0;
+    // m_taps rows of m_output_size
+    AlignedBuffer<int32_t> m_indices;
+    AlignedBuffer<float> m_weights;
+};
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <AlignedBuffer.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Recent deinterleaved samples, one contiguous float buffer per channel, so
+// any window that is still held can be read without wrapping. Samples are
+// addressed by their absolute index since reset(). New samples are appended
+// at the end; when there is no room the ones before keep_from are dropped and
+// the rest moved to the front, which happens once every (capacity - window)
+// samples.
+class SampleHistory {
+public:
+    void reset(size_t num_channels, size_t capacity) {
+        m_buffers.resize(num_channels);
+        for (auto& buffer : m_buffers) {
+            buffer.resize(capacity);
+        }
+        m_write.assign(num_channels, nullptr);
+        m_capacity = capacity;
+        m_begin = 0;
+        m_fill = 0;
+    }
+
+    size_t num_channels() const { return m_buffers.size(); }
+    size_t capacity() const { return m_capacity; }
+    // Absolute index of the oldest held sample and one past the newest
+    uint64_t begin() const { return m_begin; }
+    uint64_t end() const { return m_begin + m_fill; }
+
+    // Write pointers for `frames` more samples per channel, or nullptr if they
+    // don't fit even after dropping everything before keep_from
+    float* const* reserve(size_t frames, uint64_t keep_from) {
+        if (m_fill + frames > m_capacity) {
+            size_t drop = keep_from > m_begin ? static_cast<size_t>(std::min<uint64_t>(keep_from - m_begin, m_fill)) : 0;
+            for (auto& buffer : m_buffers) {
+                std::memmove(buffer.data(), buffer.data() + drop, (m_fill - drop) * sizeof(float));
+            }
+            m_begin += drop;
+            m_fill -= drop;
+            if (m_fill + frames > m_capacity) {
+                return nullptr;
+            }
+        }
+        for (size_t c = 0; c < m_buffers.size(); ++c) {
+            m_write[c] = m_buffers[c].data() + m_fill;
+        }
+        return m_write.data();
+    }
+
+    // Publishes what was written through reserve()
+    void commit(size_t frames) { m_fill += frames; }
+
+    // Samples of `channel` from absolute index `from`, which must be held
+    const float* channel(size_t channel, uint64_t from) const {
+        return m_buffers[channel].data() + (from - m_begin);
+    }
+
+private:
+    std::vector<AlignedBuffer<float> > m_buffers;
+    std::vector<float*> m_write;
+    size_t m_capacity = 0;
+    uint64_t m_begin = 0;
+    size_t m_fill = 0;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <AlignedBuffer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace audio_processing {
+
+enum class WindowType {
+    Rectangular,
+    Hann,
+    Hamming,
+    Blackman,
+};
+
+// Precomputed analysis window, aligned for the SIMD kernels
+class WindowTable {
+public:
+    WindowTable() = default;
+    WindowTable(size_t size, WindowType type) { reset(size, type); }
+
+    void reset(size_t size, WindowType type);
+    const float* data() const { return m_table.data(); }
+    size_t size() const { return m_table.size(); }
+    WindowType type() const { return m_type; }
+
+private:
+    AlignedBuffer<float> m_table;
+    WindowType m_type = WindowType::Hann;
+};
+
+// Levels of the unwindowed input, in S16 units
+struct SampleStats {
+    float rms = 0;
+    float peak = 0;
+};
+
+// One pass over interleaved S16: splits `frames` frames of `num_channels`
+// channels into out[0..num_channels), converts to float, multiplies by window
+// (frames long, or nullptr for none) and measures RMS and peak across all
+// channels, and per channel into channel_stats[0..num_channels) if given.
+// Picks the widest instruction set the CPU has.
+SampleStats deinterleave_window(const int16_t* in, size_t frames, size_t num_channels, const float* window,
+        float* const* out, SampleStats* channel_stats = nullptr);
+// Plain C++ version, for comparison
+SampleStats deinterleave_window_scalar(const int16_t* in, size_t frames, size_t num_channels, const float* window,
+        float* const* out, SampleStats* channel_stats = nullptr);
+// Sparse weighted sums of magnitudes: band b covers the bins starting at
+// first_bins[b] with weights[offsets[b] .. offsets[b + 1]), so
+//   out[b] = sum_i weights[offsets[b] + i] * |spectrum[first_bins[b] + i]|
+void band_sums(const float* spectrum, const uint32_t* first_bins, const uint32_t* offsets,
+        const float* weights, size_t num_bands, float* out);
+void band_sums_scalar(const float* spectrum, const uint32_t* first_bins, const uint32_t* offsets,
+        const float* weights, size_t num_bands, float* out);
+// Fixed tap count gather: tables are taps rows of n, so
+//   out[i] = sum_k in[indices[k * n + i]] * weights[k * n + i]
+void gather_sums(const float* in, const int32_t* indices, const float* weights, size_t taps, size_t n, float* out);
+void gather_sums_scalar(const float* in, const int32_t* indices, const float* weights, size_t taps, size_t n, float* out);
+// "avx2", "sse2", "neon" or "scalar"
+const char* simd_name();
+// Every instruction set simd_name() could be on this CPU, widest first,
+// and deinterleave_window on one of them, to check them all against scalar
+std::vector<const char*> simd_names();
+SampleStats deinterleave_window_with(const char* simd, const int16_t* in, size_t frames, size_t num_channels,
+        const float* window, float* const* out, SampleStats* channel_stats = nullptr);
+
+}
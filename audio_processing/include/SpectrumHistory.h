@@ -0,0 +1,90 @@
+#pragma once
+
+#include <AlignedBuffer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <span>
+
+// The last `rows` spectra in one contiguous row-major block, with their
+// timestamps and volumes in parallel arrays. Rows are padded to a cache line
+// so each starts 64 byte aligned. push() hands out the oldest row to be
+// overwritten; rows are addressed by age, 0 being the newest. A column is the
+// time series of one bin, read in place with a stride of one row.
+// reset() only allocates when the ring outgrows what it has held before.
+class SpectrumHistory {
+public:
+    using tp = std::chrono::time_point<std::chrono::high_resolution_clock>;
+
+    // One bin over time, newest first
+    class Column {
+    public:
+        Column(const SpectrumHistory& history, size_t bin) : m_history(history), m_bin(bin) {}
+        size_t size() const { return m_history.size(); }
+        float operator[](size_t age) const { return m_history.slot(age)[m_bin]; }
+
+    private:
+        const SpectrumHistory& m_history;
+        size_t m_bin;
+    };
+
+    void reset(size_t rows, size_t bins) {
+        rows = std::max<size_t>(rows, 1);
+        const size_t stride = (bins + FLOATS_PER_LINE - 1) / FLOATS_PER_LINE * FLOATS_PER_LINE;
+        if (rows * stride > m_data.size()) {
+            m_data.resize(rows * stride);
+        }
+        if (rows > m_timestamps.size()) {
+            m_timestamps.resize(rows);
+            m_volumes.resize(rows);
+        }
+        std::fill(m_data.begin(), m_data.begin() + rows * stride, 0.0f);
+        std::fill(m_timestamps.begin(), m_timestamps.begin() + rows, tp());
+        std::fill(m_volumes.begin(), m_volumes.begin() + rows, 0.0f);
+        m_rows = rows;
+        m_bins = bins;
+        m_stride = stride;
+        m_head = 0;
+        m_size = 0;
+    }
+
+    // Capacity in spectra, and how many have been pushed up to that
+    size_t rows() const { return m_rows; }
+    size_t size() const { return m_size; }
+    size_t bins() const { return m_bins; }
+    // Floats from one row to the next
+    size_t stride() const { return m_stride; }
+
+    // Makes the oldest row the newest and returns it to be filled with bins() values
+    float* push(const tp& timestamp, float volume) {
+        m_head = (m_head + 1) % m_rows;
+        m_size = std::min(m_size + 1, m_rows);
+        m_timestamps[m_head] = timestamp;
+        m_volumes[m_head] = volume;
+        return m_data.data() + m_head * m_stride;
+    }
+
+    std::span<const float> row(size_t age) const { return {slot(age), m_bins}; }
+    std::span<float> newest() { return {m_data.data() + m_head * m_stride, m_bins}; }
+    const tp& timestamp(size_t age) const { return m_timestamps[index(age)]; }
+    float volume(size_t age) const { return m_volumes[index(age)]; }
+    void set_volume(size_t age, float volume) { m_volumes[index(age)] = volume; }
+    Column column(size_t bin) const { return Column(*this, bin); }
+
+private:
+    size_t index(size_t age) const { return (m_head + m_rows - age % m_rows) % m_rows; }
+    const float* slot(size_t age) const { return m_data.data() + index(age) * m_stride; }
+
+private:
+    static constexpr size_t FLOATS_PER_LINE = 64 / sizeof(float);
+
+    AlignedBuffer<float> m_data;
+    AlignedBuffer<tp> m_timestamps;
+    AlignedBuffer<float> m_volumes;
+    size_t m_rows = 0;
+    size_t m_bins = 0;
+    size_t m_stride = 0;
+    size_t m_head = 0;
+    size_t m_size = 0;
+};
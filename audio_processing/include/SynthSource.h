@@ -0,0 +1,47 @@
+#pragma once
+
+#include <AudioSource.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Generated test signal: a sum of sines, white noise and a click track.
+//   sine=440,1000  frequencies in Hz
+//   noise=0.1      noise amplitude (0-1)
+//   click=120      click track tempo in BPM
+//   amp=0.5        overall amplitude (0-1)
+//   pace=fast      don't pace to the sample rate
+//   seconds=10     stop after this much audio (default: never)
+class SynthSource : public AudioSource {
+public:
+    SynthSource(const std::map<std::string, std::string>& params = {});
+
+    int open(AudioFormat& format) override;
+    int read(int16_t* buffer, size_t frames, tp& timestamp, uint64_t& frame_num) override;
+    void close() override {}
+    std::string name() const override { return "synth"; }
+
+    void set_sines(const std::vector<float>& frequencies) { m_frequencies = frequencies; }
+    void set_noise(float amplitude) { m_noise = amplitude; }
+    void set_click_bpm(float bpm) { m_click_bpm = bpm; }
+    void set_realtime(bool realtime) { m_realtime = realtime; }
+
+private:
+    float next_noise();
+
+private:
+    std::vector<float> m_frequencies;
+    std::vector<double> m_phases;
+    float m_noise = 0.0f;
+    float m_click_bpm = 0.0f;
+    float m_amplitude = 0.5f;
+    bool m_realtime = true;
+    double m_seconds = 0.0;
+    uint32_t m_sample_rate = 44100;
+    uint32_t m_num_channels = 2;
+    uint64_t m_noise_state = 0x9E3779B97F4A7C15ull;
+    // a bad parameter, reported by open()
+    std::string m_param_error;
+    SourceClock m_clock;
+};
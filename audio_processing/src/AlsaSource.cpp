@@ -0,0 +1,270 @@
+#include <AlsaSource.h>
+#include <alsa/asoundlib.h>
+#include <spdlog/spdlog.h>
+#include <fmt/chrono.h>
+
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+
+// How long a poll() may block before the capture loop gets to check its stop flag
+static const int POLL_TIMEOUT_MS = 200;
+
+AlsaSource::~AlsaSource() {
+    close();
+}
+
+int AlsaSource::open(AudioFormat& format) {
+    int rc;
+    int dir;
+    
+    // Open PCM device for recording (capture).
+    // Replace "hw:1,0" with your specific card and device numbers if different.
+    rc = snd_pcm_open(&m_handle, m_device_name.c_str(), SND_PCM_STREAM_CAPTURE, 0);
+    if (rc < 0) {
+        std::cerr << "unable to open pcm device: " << snd_strerror(rc) << std::endl;
+        m_handle = nullptr;
+        return 1;
+    }
+    spdlog::info("PCM device {} opened for recording.", m_device_name);
+
+    // Allocate a hardware parameters object.
+    snd_pcm_hw_params_alloca(&m_params);
+
+    // Fill it with default values.
+    snd_pcm_hw_params_any(m_handle, m_params);
+
+    // Set the desired hardware parameters.
+    // Interleaved mode
+    rc = snd_pcm_hw_params_set_access(m_handle, m_params, m_mmap ? SND_PCM_ACCESS_MMAP_INTERLEAVED : SND_PCM_ACCESS_RW_INTERLEAVED);
+    if (rc < 0 && m_mmap) {
+        spdlog::warn("{} does not support mmap capture ({}), falling back to read", m_device_name, snd_strerror(rc));
+        m_mmap = false;
+        snd_pcm_hw_params_set_access(m_handle, m_params, SND_PCM_ACCESS_RW_INTERLEAVED);
+    }
+
+    // Signed 16-bit little-endian format
+    snd_pcm_hw_params_set_format(m_handle, m_params, SND_PCM_FORMAT_S16_LE);
+
+    // 2 channels (stereo)
+    snd_pcm_hw_params_set_channels(m_handle, m_params, format.num_channels);
+
+    snd_pcm_hw_params_set_rate_near(m_handle, m_params, &format.sample_rate, &dir);
+
+    // Set period size (frames per period)
+    snd_pcm_uframes_t frames = format.frames_per_period;
+    snd_pcm_hw_params_set_period_size_near(m_handle, m_params, &frames, &dir);
+    // A whole number of periods so mmap views of one period never wrap
+    unsigned int periods = 4;
+    snd_pcm_hw_params_set_periods_near(m_handle, m_params, &periods, &dir);
+
+
+    spdlog::info("Audio parameters set: rate={} Hz, channels={}, format=S16_LE", format.sample_rate, format.num_channels);
+    // Write the parameters to the driver
+    rc = snd_pcm_hw_params(m_handle, m_params);
+    if (rc < 0) {
+        std::cerr << "unable to set hw parameters: " << snd_strerror(rc) << std::endl;
+        return -1;
+    }
+
+    // Get period size
+    snd_pcm_hw_params_get_period_size(m_params, &frames, &dir);
+    format.frames_per_period = frames;
+    m_num_channels = format.num_channels;
+    // m_params was alloca'd in this frame
+    m_params = nullptr;
+
+    /* Allocate a temporary swparams struct */
+    snd_pcm_sw_params_t *swparams;
+    snd_pcm_sw_params_alloca(&swparams);
+
+    /* Retrieve current SW parameters. */
+    snd_pcm_sw_params_current(m_handle, swparams);
+
+    /* Change software parameters. */
+    snd_pcm_sw_params_set_tstamp_mode(m_handle, swparams, SND_PCM_TSTAMP_ENABLE);
+    snd_pcm_sw_params_set_tstamp_type(m_handle, swparams, SND_PCM_TSTAMP_TYPE_GETTIMEOFDAY);
+    // Only wake up from poll() once a whole period is there
+    snd_pcm_sw_params_set_avail_min(m_handle, swparams, frames);
+
+    /* Apply updated software parameters to PCM interface. */
+    snd_pcm_sw_params(m_handle, swparams);
+
+    if (m_mmap) {
+        int count = snd_pcm_poll_descriptors_count(m_handle);
+        if (count <= 0) {
+            spdlog::error("Unable to get poll descriptors for {}", m_device_name);
+            return -1;
+        }
+        m_poll_fds.resize(count);
+        snd_pcm_poll_descriptors(m_handle, m_poll_fds.data(), count);
+        // Capture does not start by itself without a read call
+        rc = snd_pcm_start(m_handle);
+        if (rc < 0) {
+            spdlog::error("Unable to start capture on {}: {}", m_device_name, snd_strerror(rc));
+            return -1;
+        }
+        spdlog::info("{} capturing through mmap with {} poll descriptors", m_device_name, count);
+    }
+    return 0;
+}
+
+int AlsaSource::recover(int err) {
+    if (err == -EPIPE || err == -ESTRPIPE) {
+        m_xruns++;
+        spdlog::error("Overrun occurred ({} so far)", m_xruns);
+    }
+    int rc = snd_pcm_recover(m_handle, err, 1);
+    if (rc < 0) {
+        spdlog::error("Unable to recover from {}: {}", snd_strerror(err), snd_strerror(rc));
+        return rc;
+    }
+    if (m_mmap && snd_pcm_state(m_handle) != SND_PCM_STATE_RUNNING) {
+        rc = snd_pcm_start(m_handle);
+    }
+    return rc;
+}
+
+int AlsaSource::wait_for_frames(size_t frames) {
+    while (true) {
+        snd_pcm_sframes_t avail = snd_pcm_avail_update(m_handle);
+        if (avail < 0) {
+            int rc = recover(avail);
+            if (rc < 0) return rc;
+            continue;
+        }
+        if (static_cast<size_t>(avail) >= frames) {
+            return avail;
+        }
+        int rc = poll(m_poll_fds.data(), m_poll_fds.size(), POLL_TIMEOUT_MS);
+        if (rc < 0) {
+            if (errno == EINTR) continue;
+            spdlog::error("poll failed on {}: {}", m_device_name, strerror(errno));
+            return -errno;
+        }
+        if (rc == 0) {
+            // timed out, let the caller look at its stop flag
+            return 0;
+        }
+        unsigned short revents = 0;
+        snd_pcm_poll_descriptors_revents(m_handle, m_poll_fds.data(), m_poll_fds.size(), &revents);
+        if (revents & POLLERR) {
+            rc = recover(snd_pcm_state(m_handle) == SND_PCM_STATE_SUSPENDED ? -ESTRPIPE : -EPIPE);
+            if (rc < 0) return rc;
+        }
+    }
+}
+
+void AlsaSource::read_timestamp(tp& read_time, uint64_t& frame_num) {
+    snd_htimestamp_t ts;
+    snd_pcm_uframes_t num_frames;
+    int rc = snd_pcm_htimestamp(m_handle, &num_frames, &ts);
+    if (rc < 0) {
+        spdlog::warn("Unable to get timestamp: {}", snd_strerror(rc));
+        return;
+    }
+    if (ts.tv_sec != 0) {
+        auto d = std::chrono::seconds{ts.tv_sec}
+                + std::chrono::nanoseconds{ts.tv_nsec};
+        read_time = std::chrono::time_point<std::chrono::high_resolution_clock>(d);
+    }
+    frame_num = num_frames;
+}
+
+int AlsaSource::acquire_view(AudioPeriod& view, size_t frames) {
+    int rc = wait_for_frames(frames);
+    if (rc <= 0) {
+        return rc;
+    }
+    view.timestamp = std::chrono::high_resolution_clock::now();
+    read_timestamp(view.timestamp, view.frame_num);
+
+    const snd_pcm_channel_area_t* areas = nullptr;
+    snd_pcm_uframes_t offset = 0;
+    snd_pcm_uframes_t count = frames;
+    rc = snd_pcm_mmap_begin(m_handle, &areas, &offset, &count);
+    if (rc < 0) {
+        return recover(rc) < 0 ? rc : 0;
+    }
+    // Interleaved: every channel shares the first area, step is a whole frame in bits
+    auto base = static_cast<uint8_t*>(areas[0].addr) + areas[0].first / 8 + offset * (areas[0].step / 8);
+    view.samples = reinterpret_cast<int16_t*>(base);
+    view.num_samples = count * m_num_channels;
+    m_view_offset = offset;
+    m_view_frames = count;
+    return count;
+}
+
+int AlsaSource::release_view(const AudioPeriod&) {
+    if (m_view_frames == 0) {
+        return 0;
+    }
+    snd_pcm_sframes_t committed = snd_pcm_mmap_commit(m_handle, m_view_offset, m_view_frames);
+    auto expected = m_view_frames;
+    m_view_frames = 0;
+    if (committed < 0 || static_cast<snd_pcm_uframes_t>(committed) != expected) {
+        return recover(committed >= 0 ? -EPIPE : committed);
+    }
+    return 0;
+}
+
+int AlsaSource::read(int16_t* buffer, size_t frames, tp& read_time, uint64_t& frame_num) {
+    if (m_mmap) {
+        AudioPeriod view;
+        int count = acquire_view(view, frames);
+        if (count <= 0) {
+            return count;
+        }
+        std::memcpy(buffer, view.samples, view.num_samples * sizeof(int16_t));
+        read_time = view.timestamp;
+        frame_num = view.frame_num;
+        int rc = release_view(view);
+        return rc < 0 ? rc : count;
+    }
+    spdlog::debug("Asking for {} frames of audio data", frames);
+    int rc = snd_pcm_readi(m_handle, buffer, frames);
+    read_time = std::chrono::high_resolution_clock::now();
+    int read = rc;
+    if (rc == -EPIPE) {
+        // EPIPE means overrun
+        spdlog::error("Overrun occurred");
+        snd_pcm_prepare(m_handle);
+        read = 0;
+    } else if (rc < 0) {
+        std::string err_msg = snd_strerror(rc);
+        spdlog::error("Error from read: {}", err_msg);
+        read = 0;
+    } else if (rc != (int)frames) {
+        spdlog::warn("short read, read {} frames", rc);
+    }
+
+    snd_htimestamp_t ts;
+    snd_pcm_uframes_t num_frames;
+    rc = snd_pcm_htimestamp(m_handle, &num_frames, &ts);
+    if (rc < 0)
+    {
+        spdlog::warn("Unable to get timestamp: {}", snd_strerror(rc));
+        return rc;
+    }
+    if (ts.tv_sec != 0) {
+        auto d = std::chrono::seconds{ts.tv_sec}
+                + std::chrono::nanoseconds{ts.tv_nsec};
+        read_time = std::chrono::time_point<std::chrono::high_resolution_clock>(d);
+    } else {
+        spdlog::warn("Timestamp is zero, using current time.");
+    }
+    frame_num = num_frames;
+
+    spdlog::debug("Captured {} frames of audio data: num_frames {} time: {}", read, num_frames, read_time);
+    return read;
+}
+
+void AlsaSource::close() {
+    m_poll_fds.clear();
+    m_view_frames = 0;
+    if (m_handle) {
+        snd_pcm_drain(m_handle);
+        snd_pcm_close(m_handle);
+        m_handle = nullptr;
+    }
+}
@@ -1,10 +1,15 @@
 #include <AudioDrawer.h>
+#include <Metrics.h>
+#include <Tracer.h>
 
 #include <spdlog/spdlog.h>
+#include <fmt/core.h>
 #include <chrono>
 
 using namespace std::chrono_literals;
 
+static const auto STATS_INTERVAL = 10s;
+
 AudioDrawer::AudioDrawer(): m_grid(16, 16) {
     m_process.set_sample_rate(44100);
     m_process.set_samples_per_frame(1024);
@@ -20,38 +25,166 @@ AudioDrawer::~AudioDrawer() {
     stop();
 }
 
-void AudioDrawer::draw_thread() {
-    while (!m_process.m_stop) {
-        std::unique_lock<std::mutex> lk(m_mutex);
-        m_cv.wait(lk, [this]{ return this->m_data_loaded; });
-        m_data_loaded = false;
-        if (!m_process.m_stop) {
-            m_usb.write_and_reopen(m_data);
+void AudioDrawer::set_output_stage(const OutputStage::Config& config) {
+    m_output_config = config;
+    m_output.set_output_stage(config);
+    if (m_group) {
+        m_group->set_output_stage(config);
+    }
+}
+
+int AudioDrawer::set_panels(const std::vector<UsbOutputGroup::Panel>& panels) {
+    auto group = std::make_unique<UsbOutputGroup>();
+    if (group->add_devices(panels) != 0 || group->num_panels() == 0) {
+        spdlog::error("Unable to set up the panels");
+        return -1;
+    }
+    group->set_output_stage(m_output_config);
+    m_grid.resize(group->width(), group->height());
+    spdlog::info("{} panels, {}x{} grid", group->num_panels(), group->width(), group->height());
+    m_group = std::move(group);
+    return 0;
+}
+
+// Looked up once, recording never locks
+struct RenderMetrics {
+    Metrics::Counter& frames = Metrics::instance().counter("render.frames");
+    // drawing the grid and handing it to the output
+    Metrics::Histogram& draw_ns = Metrics::instance().histogram("render.draw_ns");
+    // spectrum ready to its frame being rendered
+    Metrics::Histogram& schedule_latency_ns = Metrics::instance().histogram("latency.schedule_ns");
+};
+
+// From capture to the USB transfer completing, in order. The stages don't
+// quite add up to the total: a frame can also wait for a free transfer.
+static const std::pair<const char*, const char*> LATENCY_STAGES[] = {
+    {"analysis", "latency.analysis_ns"},
+    {"schedule", "latency.schedule_ns"},
+    {"draw", "render.draw_ns"},
+    {"usb", "latency.usb_ns"},
+    {"total", "latency.total_ns"},
+};
+
+static RenderMetrics& render_metrics() {
+    static RenderMetrics metrics;
+    return metrics;
+}
+
+void AudioDrawer::render(const AnalysisFrame& frame) {
+    spdlog::debug("Rendering audio frame {}", frame.frame_num);
+    auto& metrics = render_metrics();
+    Tracer::set_frame(frame.frame_num);
+    const auto now = std::chrono::high_resolution_clock::now();
+    const uint64_t start = Metrics::now_ns();
+    if (frame.frame_num != m_last_scheduled_frame && frame.analysed != decltype(frame.analysed)() && now >= frame.analysed) {
+        m_last_scheduled_frame = frame.frame_num;
+        metrics.schedule_latency_ns.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - frame.analysed).count());
+    }
+    // The capture time moved onto the clock the USB side measures with
+    uint64_t origin_ns = 0;
+    const uint64_t age = now >= frame.timestamp
+        ? std::chrono::duration_cast<std::chrono::nanoseconds>(now - frame.timestamp).count() : 0;
+    if (age > 0 && age < start) {
+        origin_ns = start - age;
+    }
+    {
+        Metrics::Timer timer(metrics.draw_ns);
+        Tracer::Span span("render.draw");
+        draw(origin_ns);
+    }
+    metrics.frames.add();
+    log_stats();
+}
+
+void AudioDrawer::log_stats() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_last_stats < STATS_INTERVAL) {
+        return;
+    }
+    m_last_stats = now;
+    if (m_group) {
+        spdlog::info("Panels: frame {}, {} skipped while a panel was busy", m_group->frame_number(), m_group->skipped());
+        for (const auto& panel : m_group->stats()) {
+            spdlog::info("  {}: {} submitted, {} failed, {} dropped, {:.0f} mA{}", panel.panel.serial,
+                panel.output.submitted, panel.output.failed, panel.output.dropped, panel.output.milliamps,
+                panel.output.connected ? "" : ", disconnected");
+        }
+    } else {
+        auto stats = m_output.stats();
+        auto frames = stats.submitted - m_prev_stats.submitted;
+        auto bytes = stats.bytes_sent - m_prev_stats.bytes_sent;
+        auto raw = stats.raw_bytes - m_prev_stats.raw_bytes;
+        spdlog::info("USB: {} frames, {:.0f} bytes/frame ({:.1f}% of v1), {} keyframes, {} unchanged, {} dropped, {} failed",
+            frames, frames ? static_cast<double>(bytes) / frames : 0.0, raw ? 100.0 * bytes / raw : 0.0,
+            stats.keyframes - m_prev_stats.keyframes, stats.unchanged - m_prev_stats.unchanged,
+            stats.dropped - m_prev_stats.dropped, stats.failed - m_prev_stats.failed);
+        if (m_output_config.max_milliamps > 0) {
+            spdlog::info("Power: {:.0f}/{:.0f} mA, brightness {:.2f}, {} frames limited", stats.milliamps,
+                m_output_config.max_milliamps, stats.output_scale, stats.power_limited - m_prev_stats.power_limited);
         }
+        m_prev_stats = stats;
+    }
+    auto render = m_scheduler.stats();
+    spdlog::info("Render: {:.1f}/{:.1f} fps, {:.2f} ms jitter, {:.2f} ms max late, {} stale, {} skipped",
+        render.fps, render.target_fps, render.jitter_ms, render.max_late_ms, render.stale, render.skipped);
+}
+
+std::vector<AudioDrawer::LatencyStage> AudioDrawer::latency() {
+    std::vector<LatencyStage> stages;
+    for (const auto& [name, histogram] : LATENCY_STAGES) {
+        stages.push_back(LatencyStage{name, Metrics::instance().histogram(histogram).snapshot()});
+    }
+    return stages;
+}
+
+void AudioDrawer::reset_latency() {
+    for (const auto& [name, histogram] : LATENCY_STAGES) {
+        Metrics::instance().histogram(histogram).reset();
+    }
+}
+
+void AudioDrawer::write_latency_report(std::ostream& out) {
+    out << fmt::format("{:<10} {:>8} {:>9} {:>9} {:>9}\n", "latency", "count", "p50 ms", "p99 ms", "max ms");
+    for (const auto& stage : latency()) {
+        const auto& s = stage.snapshot;
+        out << fmt::format("{:<10} {:>8} {:>9.3f} {:>9.3f} {:>9.3f}\n", stage.name, s.count,
+            s.quantile(0.5) / 1e6, s.quantile(0.99) / 1e6, s.max / 1e6);
     }
 }
 
 void AudioDrawer::start() {
-    m_usb.open();
+    // Opens (and reopens) the device(s) on their own threads
+    if (m_group) {
+        m_group->start();
+    } else {
+        m_output.start();
+    }
+    m_last_stats = std::chrono::steady_clock::now();
     m_process.start();
-    m_thread = std::thread(&AudioDrawer::draw_thread, this);
+    m_scheduler.start([this](const AnalysisFrame& frame) {
+        this->render(frame);
+    });
 }
+
 void AudioDrawer::stop() {
     m_process.stop();
-    m_data_loaded = true;
-    m_cv.notify_all();
-    m_thread.join();
-    m_thread = std::thread();
+    m_scheduler.stop();
+    m_output.stop();
+    if (m_group) {
+        m_group->stop();
+    }
 }
 
-void AudioDrawer::draw() {
+void AudioDrawer::draw(uint64_t origin_ns) {
     spdlog::debug("Writing data to USB device");
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_data = m_grid.data();
-    m_data_loaded = true;
-    m_cv.notify_all();
+    // UsbOutput pads (and maybe delta encodes) at submit time
+    if (m_group) {
+        m_group->send(m_grid, origin_ns);
+    } else {
+        m_output.send(m_grid.vector(), 0, origin_ns);
+    }
 }
 
 void AudioDrawer::update(const AudioProcess *process) {
-    spdlog::debug("GOT UPDATE, WRITING DATA");
+    m_scheduler.push(*process);
 }
@@ -1,5 +1,6 @@
 #include <AudioListener.h>
-#include <alsa/asoundlib.h>
+#include <Metrics.h>
+#include <Tracer.h>
 #include <spdlog/spdlog.h>
 #include <fmt/chrono.h>
 
@@ -8,10 +9,43 @@
 #include <thread>
 #include <chrono>
 
+// Looked up once, recording never locks
+struct CaptureMetrics {
+    Metrics::Counter& periods = Metrics::instance().counter("capture.periods");
+    Metrics::Counter& overruns = Metrics::instance().counter("capture.overruns");
+    Metrics::Gauge& ring_occupancy = Metrics::instance().gauge("capture.ring_occupancy");
+    // time blocked waiting for the source, about a period when it keeps up
+    Metrics::Histogram& read_ns = Metrics::instance().histogram("capture.read_ns");
+    // in place processing of a period on the capture thread
+    Metrics::Histogram& callback_ns = Metrics::instance().histogram("capture.callback_ns");
+};
+
+static CaptureMetrics& capture_metrics() {
+    static CaptureMetrics metrics;
+    return metrics;
+}
+
 AudioListener::~AudioListener() {
     stop();
 }
 
+int AudioListener::open_source() {
+    if (!m_source) {
+        m_source = AudioSource::create(m_device_name);
+    }
+    AudioFormat format{m_sample_rate, m_num_channels, m_samples_per_frame};
+    int rc = m_source->open(format);
+    if (rc != 0) {
+        spdlog::error("Unable to open audio source {}", m_source->name());
+        m_source->close();
+        return rc;
+    }
+    m_sample_rate = format.sample_rate;
+    m_num_channels = format.num_channels;
+    m_samples_per_frame = format.frames_per_period;
+    return 0;
+}
+
 int AudioListener::listen(
     const std::function<void(
         const std::vector<int16_t>&,
@@ -24,115 +58,166 @@ int AudioListener::listen(
     } else {
         m_stop_flag.store(false);
     }
-    
-    int rc;
-    int dir;
-    
-    // Open PCM device for recording (capture).
-    // Replace "hw:1,0" with your specific card and device numbers if different.
-    rc = snd_pcm_open(&m_handle, m_device_name.c_str(), SND_PCM_STREAM_CAPTURE, 0);
-    if (rc < 0) {
-        std::cerr << "unable to open pcm device: " << snd_strerror(rc) << std::endl;
-        return 1;
-    }
-    spdlog::info("PCM device {} opened for recording.", m_device_name);
-
-    // Allocate a hardware parameters object.
-    snd_pcm_hw_params_alloca(&m_params);
-
-    // Fill it with default values.
-    snd_pcm_hw_params_any(m_handle, m_params);
 
-    // Set the desired hardware parameters.
-    // Interleaved mode
-    snd_pcm_hw_params_set_access(m_handle, m_params, SND_PCM_ACCESS_RW_INTERLEAVED);
-
-    // Signed 16-bit little-endian format
-    snd_pcm_hw_params_set_format(m_handle, m_params, SND_PCM_FORMAT_S16_LE);
-
-    // 2 channels (stereo)
-    snd_pcm_hw_params_set_channels(m_handle, m_params, m_num_channels);
-
-    snd_pcm_hw_params_set_rate_near(m_handle, m_params, &m_sample_rate, &dir);
-
-    // Set period size (frames per period)
-    snd_pcm_uframes_t frames = m_samples_per_frame;
-    snd_pcm_hw_params_set_period_size_near(m_handle, m_params, &frames, &dir);
-
-
-    spdlog::info("Audio parameters set: rate={} Hz, channels={}, format=S16_LE", m_sample_rate, m_num_channels);
-    // Write the parameters to the driver
-    rc = snd_pcm_hw_params(m_handle, m_params);
-    if (rc < 0) {
-        std::cerr << "unable to set hw parameters: " << snd_strerror(rc) << std::endl;
-        return -1;
+    int rc = open_source();
+    if (rc != 0) {
+        return rc;
     }
-
-    // Get period size
-    snd_pcm_hw_params_get_period_size(m_params, &frames, &dir);
-    m_samples_per_frame = frames;
-
-    /* Allocate a temporary swparams struct */
-    snd_pcm_sw_params_t *swparams;
-    snd_pcm_sw_params_alloca(&swparams);
-
-    /* Retrieve current SW parameters. */
-    snd_pcm_sw_params_current(m_handle, swparams);
-
-    /* Change software parameters. */
-    snd_pcm_sw_params_set_tstamp_mode(m_handle, swparams, SND_PCM_TSTAMP_ENABLE);
-    snd_pcm_sw_params_set_tstamp_type(m_handle, swparams, SND_PCM_TSTAMP_TYPE_GETTIMEOFDAY);
-
-    /* Apply updated software parameters to PCM interface. */
-    snd_pcm_sw_params(m_handle, swparams);
+    size_t frames = m_samples_per_frame;
 
     // Get buffer size in bytes
     // 1 int16_t per sample (S16_LE) * 2 channels
     std::vector<int16_t> buffer(frames * m_num_channels);
 
     m_listener_thread = std::thread([=, this]() mutable {
+        Tracer::set_thread_name("capture");
+        auto& metrics = capture_metrics();
         // Loop for capturing audio data
         long loops = duration_seconds * (this->m_sample_rate / (float)frames);
         if (duration_seconds <= 0) {
             loops = 1;
         }
         spdlog::info("Starting audio capture for {} periods...", loops);
+        std::chrono::time_point<std::chrono::high_resolution_clock> read_time;
+        uint64_t num_frames = 0;
         while (loops > 0 && !this->m_stop_flag.load()) {
             if (duration_seconds > 0) {
                 loops--;
             }
-            spdlog::debug("Asking for {} frames of audio data", frames);
-            rc = snd_pcm_readi(this->m_handle, buffer.data(), frames);
-            auto read_time = std::chrono::high_resolution_clock::now();
-            if (rc == -EPIPE) {
-                // EPIPE means overrun
-                spdlog::error("Overrun occurred");
-                snd_pcm_prepare(this->m_handle);
-            } else if (rc < 0) {
-                std::string err_msg = snd_strerror(rc);
-                spdlog::error("Error from read: {}", err_msg);
-            } else if (rc != (int)frames) {
-                spdlog::warn("short read, read {} frames", rc);
+            const uint64_t start = Metrics::now_ns();
+            int read = 0;
+            {
+                Tracer::Span span("capture.read");
+                read = this->m_source->read(buffer.data(), frames, read_time, num_frames);
+                Tracer::set_frame(num_frames);
+            }
+            if (read < 0) {
+                spdlog::info("Audio source {} stopped ({})", this->m_source->name(), read);
+                return;
             }
+            metrics.read_ns.record(Metrics::now_ns() - start);
+            metrics.periods.add();
+            Metrics::Timer timer(metrics.callback_ns);
+            Tracer::Span span("capture.callback");
+            callback(buffer, read_time, num_frames);
+        }
+    });
+    return 0;
+}
+
+int AudioListener::listen_in_place(const std::function<void(const AudioPeriod&)>& callback, int duration_seconds) {
+    if (m_listener_thread.joinable()) {
+        spdlog::warn("Listener is already running.");
+        return -1;
+    } else {
+        m_stop_flag.store(false);
+    }
+
+    int rc = open_source();
+    if (rc != 0) {
+        return rc;
+    }
+    size_t frames = m_samples_per_frame;
 
-            snd_htimestamp_t ts;
-            snd_pcm_uframes_t num_frames;
-            rc = snd_pcm_htimestamp(this->m_handle, &num_frames, &ts);
-            if (rc < 0)
+    m_listener_thread = std::thread([=, this]() {
+        long loops = duration_seconds * (this->m_sample_rate / (float)frames);
+        if (duration_seconds <= 0) {
+            loops = 1;
+        }
+        const bool views = this->m_source->has_views();
+        spdlog::info("Starting in place audio capture ({}) for {} periods...", views ? "zero copy" : "scratch buffer", loops);
+        std::vector<int16_t> scratch(views ? 0 : frames * this->m_num_channels);
+        AudioPeriod period;
+        Tracer::set_thread_name("capture");
+        auto& metrics = capture_metrics();
+        while (loops > 0 && !this->m_stop_flag.load()) {
+            if (duration_seconds > 0) {
+                loops--;
+            }
+            int read = 0;
+            const uint64_t start = Metrics::now_ns();
             {
-                spdlog::warn("Unable to get timestamp: {}", snd_strerror(rc));
+                Tracer::Span span("capture.read");
+                if (views) {
+                    read = this->m_source->acquire_view(period, frames);
+                } else {
+                    read = this->m_source->read(scratch.data(), frames, period.timestamp, period.frame_num);
+                    period.samples = scratch.data();
+                    period.num_samples = read > 0 ? read * this->m_num_channels : 0;
+                }
+                Tracer::set_frame(period.frame_num);
+            }
+            if (read < 0) {
+                spdlog::info("Audio source {} stopped ({})", this->m_source->name(), read);
                 return;
             }
-            if (ts.tv_sec != 0) {
-                auto d = std::chrono::seconds{ts.tv_sec}
-                        + std::chrono::nanoseconds{ts.tv_nsec};
-                read_time = std::chrono::time_point<std::chrono::high_resolution_clock>(d);
-            } else {
-                spdlog::warn("Timestamp is zero, using current time.");
+            const uint64_t read_done = Metrics::now_ns();
+            metrics.read_ns.record(read_done - start);
+            if (read > 0) {
+                metrics.periods.add();
+                Tracer::Span span("capture.callback");
+                callback(period);
+                metrics.callback_ns.record(Metrics::now_ns() - read_done);
+            }
+            if (views && read > 0 && this->m_source->release_view(period) < 0) {
+                spdlog::error("Unable to release capture view on {}", this->m_source->name());
+                return;
             }
+        }
+    });
+    return 0;
+}
 
-            spdlog::debug("Captured {} frames of audio data: num_frames {} time: {}", rc, num_frames, read_time);
-            callback(buffer, read_time, num_frames);
+int AudioListener::listen(AudioRing& ring, int duration_seconds, size_t ring_periods) {
+    if (m_listener_thread.joinable()) {
+        spdlog::warn("Listener is already running.");
+        return -1;
+    } else {
+        m_stop_flag.store(false);
+    }
+
+    int rc = open_source();
+    if (rc != 0) {
+        return rc;
+    }
+    size_t frames = m_samples_per_frame;
+    ring.resize(ring_periods, frames * m_num_channels);
+
+    m_listener_thread = std::thread([=, this, &ring]() {
+        long loops = duration_seconds * (this->m_sample_rate / (float)frames);
+        if (duration_seconds <= 0) {
+            loops = 1;
+        }
+        spdlog::info("Starting audio capture into a {} period ring for {} periods...", ring.capacity(), loops);
+        std::chrono::time_point<std::chrono::high_resolution_clock> read_time;
+        uint64_t num_frames = 0;
+        Tracer::set_thread_name("capture");
+        auto& metrics = capture_metrics();
+        while (loops > 0 && !this->m_stop_flag.load()) {
+            if (duration_seconds > 0) {
+                loops--;
+            }
+            const uint64_t start = Metrics::now_ns();
+            int read = 0;
+            {
+                Tracer::Span span("capture.read");
+                read = this->m_source->read(ring.write_slot(), frames, read_time, num_frames);
+                Tracer::set_frame(num_frames);
+            }
+            if (read < 0) {
+                spdlog::info("Audio source {} stopped ({})", this->m_source->name(), read);
+                return;
+            }
+            metrics.read_ns.record(Metrics::now_ns() - start);
+            if (read == 0) {
+                continue;
+            }
+            metrics.periods.add();
+            if (!ring.commit(read * this->m_num_channels, read_time, num_frames)) {
+                metrics.overruns.add();
+                spdlog::debug("Capture ring full, dropped period {} ({} overruns)", num_frames, ring.overruns());
+            }
+            metrics.ring_occupancy.set(static_cast<double>(ring.occupancy()));
         }
     });
     return 0;
@@ -145,10 +230,8 @@ void AudioListener::stop() {
         m_stop_flag.store(false);
     }
     m_listener_thread = std::thread();
-    if (m_handle) {
-        snd_pcm_drain(m_handle);
-        snd_pcm_close(m_handle);
-        m_handle = nullptr;
+    if (m_source) {
+        m_source->close();
     }
 }
 
@@ -0,0 +1,109 @@
+#include <AudioPipeline.h>
+
+#include "spdlog/spdlog.h"
+
+#include <thread>
+
+// Periods a worker handles for one source before requeueing it
+static const size_t DRAIN_BATCH = 4;
+
+AudioPipeline::AudioPipeline(size_t num_workers) : m_pool(num_workers) {}
+
+AudioPipeline::~AudioPipeline() {
+    stop();
+}
+
+AudioProcess& AudioPipeline::add_source(const std::string& name, const std::string& spec) {
+    auto source = std::make_unique<Source>();
+    source->name = name;
+    source->process = std::make_unique<AudioProcess>();
+    source->process->set_device_name(spec);
+    m_sources.push_back(std::move(source));
+    return *m_sources.back()->process;
+}
+
+AudioProcess& AudioPipeline::add_source(const std::string& name, std::unique_ptr<AudioSource> audio_source) {
+    AudioProcess& process = add_source(name, audio_source ? audio_source->name() : std::string());
+    process.set_source(std::move(audio_source));
+    return process;
+}
+
+int AudioPipeline::start() {
+    if (m_running) {
+        spdlog::warn("Audio pipeline is already running");
+        return -1;
+    }
+    m_running = true;
+    for (auto& source : m_sources) {
+        Source* s = source.get();
+        if (s->process->start_capture([this, s]() { this->schedule(*s); }) != 0) {
+            spdlog::error("Unable to start source {}", s->name);
+            stop();
+            return -1;
+        }
+    }
+    spdlog::info("Audio pipeline: {} sources on {} workers", m_sources.size(), m_pool.size());
+    return 0;
+}
+
+void AudioPipeline::stop() {
+    if (!m_running) {
+        return;
+    }
+    for (auto& source : m_sources) {
+        source->process->stop();
+    }
+    // stop() makes drains return early, wait for the ones queued or running
+    while (m_in_flight.load(std::memory_order_acquire) > 0) {
+        std::this_thread::yield();
+    }
+    m_running = false;
+}
+
+void AudioPipeline::schedule(Source& source) {
+    // pairs with the fence in drain(): either it sees the new period or this sees scheduled cleared
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (source.scheduled.exchange(true)) {
+        // the queued or running drain will pick this period up
+        return;
+    }
+    submit(source);
+}
+
+void AudioPipeline::submit(Source& source) {
+    m_in_flight.fetch_add(1, std::memory_order_relaxed);
+    m_pool.submit([this, &source]() {
+        this->drain(source);
+        // the last touch of either, stop() may return (and the source go away) after this
+        m_in_flight.fetch_sub(1, std::memory_order_release);
+    });
+}
+
+void AudioPipeline::drain(Source& source) {
+    while (true) {
+        size_t count = source.process->drain(DRAIN_BATCH);
+        source.processed.fetch_add(count, std::memory_order_relaxed);
+        if (count == DRAIN_BATCH && source.process->ring().occupancy() > 0) {
+            // more to do, but let other sources have the worker first
+            submit(source);
+            return;
+        }
+        source.scheduled.store(false);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // a period committed after the last read_slot() saw scheduled still set
+        if (source.process->m_stop || source.process->ring().occupancy() == 0
+                || source.scheduled.exchange(true)) {
+            return;
+        }
+    }
+}
+
+std::vector<AudioPipeline::SourceStats> AudioPipeline::stats() const {
+    std::vector<SourceStats> stats;
+    for (const auto& source : m_sources) {
+        const AudioRing& ring = source->process->ring();
+        stats.push_back(SourceStats{source->name, source->processed.load(std::memory_order_relaxed),
+            ring.overruns(), ring.max_occupancy()});
+    }
+    return stats;
+}
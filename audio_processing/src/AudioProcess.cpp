@@ -1,120 +1,375 @@
 #include <AudioProcess.h>
+#include <Metrics.h>
+#include <Tracer.h>
 #include <audio_processing.h>
 #include "spdlog/spdlog.h"
 #include <fmt/chrono.h>
-#include <numeric>
+#include <algorithm>
 
 using tp = std::chrono::time_point<std::chrono::high_resolution_clock>;
 
+// In place (L, R) -> ((L + R) / 2, (L - R) / 2)
+static void to_mid_side(float* left, float* right, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        const float l = left[i];
+        const float r = right[i];
+        left[i] = 0.5f * (l + r);
+        right[i] = 0.5f * (l - r);
+    }
+}
+
+// Looked up once, recording never locks
+struct ProcessMetrics {
+    // one period, analysis and callbacks
+    Metrics::Histogram& period_ns = Metrics::instance().histogram("process.period_ns");
+    Metrics::Histogram& fft_ns = Metrics::instance().histogram("process.fft_ns");
+    Metrics::Counter& spectra = Metrics::instance().counter("process.spectra");
+    // periods queue_data() dropped because the ring was full
+    Metrics::Counter& queue_overruns = Metrics::instance().counter("process.queue_overruns");
+    // captured to spectrum ready
+    Metrics::Histogram& analysis_latency_ns = Metrics::instance().histogram("latency.analysis_ns");
+};
+
+static ProcessMetrics& process_metrics() {
+    static ProcessMetrics metrics;
+    return metrics;
+}
+
 void AudioProcess::stop() {
     m_stop = true;
     if (m_processing_thread.joinable()) {
-        m_cond_var.notify_all();
+        m_ring.wake();
         m_processing_thread.join();
         m_processing_thread = std::thread();
     }
     m_listener.stop();
 }
 
+int AudioProcess::start_capture(std::function<void()> on_period) {
+    m_stop = false;
+    // Periods captured before the negotiated format is copied below wait in the ring
+    m_capture_ready = false;
+    m_ring.set_notify([this, on_period]() {
+        if (m_capture_ready.load(std::memory_order_acquire)) {
+            on_period();
+        }
+    });
+    if (m_listener.listen(m_ring, 0, m_ring_periods) != 0) {
+        spdlog::error("Unable to start audio capture");
+        return -1;
+    }
+    m_sample_rate = m_listener.sample_rate();
+    m_samples_per_frame = m_listener.samples_per_frame();
+    m_num_channels = m_listener.num_channels();
+    m_capture_ready.store(true, std::memory_order_release);
+    on_period();
+    return 0;
+}
+
+size_t AudioProcess::drain(size_t max_periods) {
+    size_t count = 0;
+    while (count < max_periods && !m_stop) {
+        auto period = m_ring.read_slot();
+        if (!period) {
+            break;
+        }
+        process(period->view(), period->timestamp, period->frame_num);
+        m_ring.release();
+        count++;
+    }
+    return count;
+}
+
 void AudioProcess::start() {
     m_stop = false;
-    m_listener.listen([this](const std::vector<int16_t>& audio_data,
-            const std::chrono::time_point<std::chrono::high_resolution_clock>& timestamp,
-            const uint64_t& frame_num) {
-        this->queue_data(audio_data, timestamp, frame_num);
-    }, 0); // 0 duration means run indefinitely until stopped
+    m_ring.set_notify(nullptr);
+    // 0 duration means run indefinitely until stopped
+    int rc = 0;
+    if (m_process_in_place) {
+        rc = m_listener.listen_in_place([this](const AudioPeriod& period) {
+            this->process(period.view(), period.timestamp, period.frame_num);
+        }, 0);
+    } else {
+        rc = m_listener.listen(m_ring, 0, m_ring_periods);
+    }
+    if (rc != 0) {
+        spdlog::error("Unable to start audio capture");
+        return;
+    }
+    // The source may have negotiated something other than what was asked for
+    m_sample_rate = m_listener.sample_rate();
+    m_samples_per_frame = m_listener.samples_per_frame();
+    m_num_channels = m_listener.num_channels();
+    if (!m_process_in_place) {
+        start_processing_thread();
+    }
+}
+
+void AudioProcess::start_processing_thread() {
+    if (m_processing_thread.joinable()) {
+        return;
+    }
+    m_processing_thread = std::thread([this]() {
+        Tracer::set_thread_name("process");
+        while (!m_stop) {
+            auto period = m_ring.read_slot();
+            if (!period) {
+                m_ring.wait(m_stop);
+                continue;
+            }
+            process(period->view(), period->timestamp, period->frame_num);
+            m_ring.release();
+        }
+    });
 }
 
-void AudioProcess::queue_data(const std::vector<int16_t>& audio_data,
+void AudioProcess::queue_data(std::span<const int16_t> audio_data,
             const tp& timestamp,
             const uint64_t& frame_num) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_load_buffer_index = (m_load_buffer_index + 1) % m_audio_buffer.size();
-    if (m_load_buffer_index == m_buffer_index) {
-        spdlog::warn("Audio buffer overrun, overwriting unprocessed data.");
-        m_load_buffer_index = (m_load_buffer_index + 1) % m_audio_buffer.size();
-    }
-    auto& load = m_audio_buffer[m_load_buffer_index];
-    auto& aud_buf = std::get<std::vector<int16_t> >(load);
-    if (aud_buf.size() != audio_data.size()) {
-        spdlog::warn("Resizing audio buffer ({}) from {} to {}", m_load_buffer_index, aud_buf.size(), audio_data.size());
-        aud_buf.resize(audio_data.size());
-    }
-    std::get<tp>(load) = timestamp;
-    std::get<uint64_t>(load) = frame_num;
-    if (!m_processing_thread.joinable() && !m_stop) {
-        m_processing_thread = std::thread([this]() {
-            while (!m_stop) {
-                std::unique_lock<std::mutex> lock(m_mutex);
-                m_cond_var.wait(lock, [this]() {
-                    return m_load_buffer_index != m_buffer_index || m_stop;
-                });
-                m_buffer_index = m_load_buffer_index;
-                auto& data = m_audio_buffer[m_buffer_index];
-                lock.unlock();
-                process(std::get<std::vector<int16_t> >(data), std::get<tp>(data), std::get<uint64_t>(data));
-            }
-        });
-        // NOTE: could be a small race condition here if the thread takes a while to startup...
-        // If this seems like an issue, just add a small sleep here so the thread has time to start before the condition is notified
+    if (audio_data.size() > m_ring.samples_per_period()) {
+        if (m_processing_thread.joinable()) {
+            spdlog::error("Period of {} samples does not fit the capture ring ({})", audio_data.size(), m_ring.samples_per_period());
+            return;
+        }
+        spdlog::warn("Resizing capture ring from {} to {} samples", m_ring.samples_per_period(), audio_data.size());
+        m_ring.resize(m_ring_periods, audio_data.size());
+    }
+    std::copy(audio_data.begin(), audio_data.end(), m_ring.write_slot());
+    if (!m_ring.commit(audio_data.size(), timestamp, frame_num)) {
+        process_metrics().queue_overruns.add();
+        spdlog::debug("Capture ring full, dropped period {} ({} overruns)", frame_num, m_ring.overruns());
+    }
+    if (!m_stop) {
+        start_processing_thread();
     }
-    m_cond_var.notify_one();
 }
 
-void AudioProcess::process(const std::vector<int16_t>& audio_data,
+void AudioProcess::process(std::span<const int16_t> audio_data,
             const tp& timestamp,
             const uint64_t& frame_num) {
-    m_history_index = (m_history_index + 1) % m_history.size();
+    Metrics::Timer timer(process_metrics().period_ns);
+    Tracer::set_frame(frame_num);
+    Tracer::Span span("process");
     spdlog::info("Audio data size: {}, Timestamp: {}, Frame number: {}", audio_data.size(), timestamp, frame_num);
-    m_volume = std::accumulate(audio_data.begin(), audio_data.end(), 0.0f, [](float sum, int16_t val) {
-            return sum + std::abs(val);
-        }) / audio_data.size();
+    const size_t num_channels = std::max<uint32_t>(m_num_channels, 1);
+    const size_t frames = audio_data.size() / num_channels;
+    if (frames == 0) {
+        return;
+    }
+    // A longer period means the configuration changed; a shorter one is a
+    // short read (ALSA, the end of a file) and keeps the configured period
+    if (frames > m_samples_per_frame) {
+        m_samples_per_frame = static_cast<uint32_t>(frames);
+    }
+    if (m_stft_size > 0) {
+        process_stft(audio_data, frames, timestamp, frame_num);
+        return;
+    }
+    // The FFT stays at the configured period, short reads are zero padded
+    // instead of planning (and writing wisdom) on this thread
+    const size_t size = m_samples_per_frame;
+    if (prepare_channels(size) != 0) {
+        return;
+    }
+    // Deinterleave, convert, window and measure in one pass
+    auto levels = audio_processing::deinterleave_window(audio_data.data(), frames, num_channels, m_window.data(),
+        m_channels.data(), m_channel_levels.data());
+    if (frames < size) {
+        for (float* channel : m_channels) {
+            std::fill(channel + frames, channel + size, 0.0f);
+        }
+    }
+    m_volume = levels.rms;
+    m_peak = levels.peak;
+    if (m_channel_layout == audio_processing::ChannelLayout::MidSide && num_channels == 2) {
+        // the transform is linear, so this is the same as converting the spectra
+        to_mid_side(m_channels[0], m_channels[1], frames);
+    }
+    // The beat tracker runs at the configured period's rate, resetting it for
+    // one short read would throw away its tempo and phase
+    publish(timestamp, frame_num, static_cast<double>(m_sample_rate) / m_samples_per_frame);
+}
+
+void AudioProcess::process_stft(std::span<const int16_t> audio_data, size_t frames,
+            const tp& timestamp,
+            const uint64_t& frame_num) {
+    const size_t num_channels = std::max<uint32_t>(m_num_channels, 1);
+    if (prepare_stft(num_channels, frames) != 0) {
+        return;
+    }
+    auto out = m_samples.reserve(frames, m_next_window_end - std::min<uint64_t>(m_next_window_end, m_stft_size));
+    if (!out) {
+        // longer period than the history was sized for
+        m_samples.reset(0, 0);
+        if (prepare_stft(num_channels, frames) != 0) {
+            return;
+        }
+        out = m_samples.reserve(frames, 0);
+    }
+    auto levels = audio_processing::deinterleave_window(audio_data.data(), frames, num_channels, nullptr, out, m_channel_levels.data());
+    m_samples.commit(frames);
+    m_volume = levels.rms;
+    m_peak = levels.peak;
+
+    // The period's timestamp is for its last sample, windows that end earlier are back dated
+    const uint64_t end = m_samples.end();
+    const float* window = m_window.data();
+    const bool mid_side = m_channel_layout == audio_processing::ChannelLayout::MidSide && num_channels == 2;
+    while (m_next_window_end <= end) {
+        for (size_t c = 0; c < num_channels; ++c) {
+            const float* samples = m_samples.channel(c, m_next_window_end - m_stft_size);
+            float* in = m_fft_plan.input(c);
+            for (size_t i = 0; i < m_stft_size; ++i) {
+                in[i] = samples[i] * window[i];
+            }
+        }
+        if (mid_side) {
+            to_mid_side(m_fft_plan.input(0), m_fft_plan.input(1), m_stft_size);
+        }
+        auto age = std::chrono::duration<double>(static_cast<double>(end - m_next_window_end) / m_sample_rate);
+        publish(timestamp - std::chrono::duration_cast<tp::duration>(age), frame_num, static_cast<double>(m_sample_rate) / m_hop_size);
+        m_next_window_end += m_hop_size;
+    }
+}
+
+int AudioProcess::prepare_stft(size_t num_channels, size_t frames) {
+    if ((m_fft_plan.size() != m_stft_size || m_fft_plan.howmany() != num_channels)
+            && m_fft_plan.reset(m_stft_size, audio_processing::FftKind::Dct2, num_channels) != 0) {
+        spdlog::error("Unable to create FFT plan for {} x {} samples", num_channels, m_stft_size);
+        return -1;
+    }
+    m_channel_levels.resize(num_channels);
+    if (m_window.size() != m_stft_size) {
+        m_window.reset(m_stft_size, m_window_type);
+    }
+    if (m_samples.num_channels() != num_channels || m_samples.capacity() < m_stft_size + frames) {
+        // room for a window plus a few periods between moves
+        m_samples.reset(num_channels, 2 * m_stft_size + 4 * frames);
+        m_next_window_end = m_stft_size;
+        spdlog::info("STFT: {} point FFT every {} samples ({:.1f} per second)", m_stft_size, m_hop_size,
+            static_cast<double>(m_sample_rate) / m_hop_size);
+    }
+    return 0;
+}
+
+void AudioProcess::publish(const tp& timestamp, uint64_t frame_num, double frame_rate) {
     m_cur_time = timestamp;
-    compute_fft(audio_data);
-    std::get<tp>(m_history[m_history_index]) = timestamp;
-    std::get<float>(m_history[m_history_index]) = m_volume;
-    if (detect_beat(audio_data)) {
+    m_cur_frame = frame_num;
+    if (m_history.bins() != m_fft_bins) {
+        m_history.reset(m_history.rows(), m_fft_bins);
+    }
+    auto& metrics = process_metrics();
+    const uint64_t start = Metrics::now_ns();
+    {
+        Tracer::Span span("process.fft");
+        compute_fft(m_history.push(timestamp, m_volume));
+    }
+    metrics.fft_ns.record(Metrics::now_ns() - start);
+    metrics.spectra.add();
+    {
+        Tracer::Span span("process.beat");
+        m_beat_detected = detect_beat(frame_rate);
+    }
+    if (m_beat_detected) {
         on_beat();
     }
+    const auto age = std::chrono::high_resolution_clock::now() - timestamp;
+    if (age.count() >= 0) {
+        metrics.analysis_latency_ns.record(std::chrono::duration_cast<std::chrono::nanoseconds>(age).count());
+    }
+    Tracer::Span span("process.callbacks");
     for (const auto& [key, cb] : m_callbacks) {
         cb(this);
     }
 }
 
 void AudioProcess::on_beat() {
-    spdlog::info("Beat detected at {:?}!", m_cur_time);
-    m_beat_detected = true;
-    // TODO: set bpm
-    m_bpm = 120.0f;
-    m_last_beat_times.push_back(m_cur_time);
-    if (m_last_beat_times.size() > m_history.size()) {
-        m_last_beat_times.erase(m_last_beat_times.begin());
+    spdlog::info("Beat detected at {:?}, {:.1f} BPM", m_cur_time, m_bpm);
+    if (m_last_beat_times.size() != m_history.rows()) {
+        m_last_beat_times.assign(m_history.rows(), tp());
+        m_last_beat_index = 0;
+    }
+    m_last_beat_times[m_last_beat_index] = m_cur_time;
+    m_last_beat_index = (m_last_beat_index + 1) % m_last_beat_times.size();
+}
+
+bool AudioProcess::detect_beat(double frame_rate) {
+    if (m_fft.empty()) {
+        return false;
     }
+    // only when the period, hop or sample rate is reconfigured
+    if (m_beat_tracker.frame_rate() != frame_rate) {
+        m_beat_tracker.reset(frame_rate);
+    }
+    bool beat = m_beat_tracker.process(m_fft.data(), m_fft.size());
+    m_bpm = m_beat_tracker.bpm();
+    m_beat_phase = m_beat_tracker.phase();
+    m_onset = m_beat_tracker.onset();
+    return beat;
 }
 
-bool AudioProcess::detect_beat(const std::vector<int16_t>& audio_data) {
-    // Placeholder for beat detection logic
-    spdlog::debug("Detecting beat in audio data...");
-    return false;
+int AudioProcess::prepare_channels(size_t frames) {
+    const size_t num_channels = std::max<uint32_t>(m_num_channels, 1);
+    // The plan handle, window and channel pointers live across frames
+    if ((m_fft_plan.size() != frames || m_fft_plan.howmany() != num_channels)
+            && m_fft_plan.reset(frames, audio_processing::FftKind::Dct2, num_channels) != 0) {
+        spdlog::error("Unable to create FFT plan for {} x {} samples", num_channels, frames);
+        return -1;
+    }
+    if (m_window.size() != frames) {
+        m_window.reset(frames, m_window_type);
+    }
+    if (m_channels.size() != num_channels || m_channels[0] != m_fft_plan.input()) {
+        m_channels.clear();
+        for (size_t c = 0; c < num_channels; ++c) {
+            m_channels.push_back(m_fft_plan.input(c));
+        }
+    }
+    m_channel_levels.resize(num_channels);
+    return 0;
 }
 
-void AudioProcess::compute_fft(const std::vector<int16_t>& audio_data) {
+void AudioProcess::compute_fft(float* out) {
     spdlog::debug("Computing FFT...");
-    static std::vector<float> fft_in_buffer(audio_data.size(), 0.0f);
-    static std::vector<float> fft_out_buffer(audio_data.size(), 0.0f);
-    if (fft_in_buffer.size() != audio_data.size()) {
-        fft_in_buffer.resize(audio_data.size(), 0.0f);
-        fft_out_buffer.resize(audio_data.size(), 0.0f);
-    }
-    
-    audio_processing::fft(fft_in_buffer, fft_out_buffer);
-    auto& final_buffer = std::get<std::vector<float> >(m_history[m_history_index]);
-    if (final_buffer.size() != m_fft_bins) {
-        final_buffer.resize(m_fft_bins, 0.0f);
-    }
-    audio_processing::resample(fft_out_buffer, final_buffer);
-    m_fft = &final_buffer;
-    spdlog::debug("FFT computed: {}", final_buffer.size());
-    // Units of the bins of the DFT are: 
-    //   freq = i * sample_rate / N
+    // Every channel, windowed, is already in the plan's inputs
+    m_fft_plan.execute();
+    const size_t num_channels = m_fft_plan.howmany();
+    m_channel_spectra.resize(num_channels - 1);
+    m_channel_fft.resize(num_channels);
+    for (size_t c = 0; c < num_channels; ++c) {
+        float* bands = out;
+        if (c > 0) {
+            m_channel_spectra[c - 1].resize(m_fft_bins);
+            bands = m_channel_spectra[c - 1].data();
+        }
+        if (reduce_bands(m_fft_plan.output(c), bands) != 0) {
+            return;
+        }
+        m_channel_fft[c] = std::span<const float>(bands, m_fft_bins);
+    }
+    m_fft = m_channel_fft[0];
+    spdlog::debug("FFT computed: {} x {}", num_channels, m_fft.size());
+}
+
+int AudioProcess::reduce_bands(const float* spectrum, float* out) {
+    if (m_band_scale == audio_processing::BandScale::Resample) {
+        // box averaged when shrinking so it doesn't alias
+        if (m_resampler.input_size() != m_fft_plan.size() || m_resampler.output_size() != m_fft_bins) {
+            if (m_resampler.reset(m_fft_plan.size(), m_fft_bins, audio_processing::ResampleMode::Box) != 0) {
+                return -1;
+            }
+        }
+        m_resampler.process(spectrum, out);
+        return 0;
+    }
+    // DCT-II bins are sample_rate / 2N apart
+    const double bin_hz = m_sample_rate / (2.0 * m_fft_plan.size());
+    if (m_filterbank.num_bins() != m_fft_plan.size() || m_filterbank.num_bands() != m_fft_bins
+            || m_filterbank.scale() != m_band_scale || m_filterbank.bin_hz() != bin_hz) {
+        if (m_filterbank.build(m_fft_plan.size(), bin_hz, m_fft_bins, m_band_scale) != 0) {
+            return -1;
+        }
+    }
+    m_filterbank.apply(spectrum, out);
+    return 0;
 }
@@ -0,0 +1,94 @@
+#include <AudioSource.h>
+#include <AlsaSource.h>
+#include <FileSource.h>
+#include <SynthSource.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <thread>
+
+void AudioSource::parse_spec(const std::string& spec, std::string& scheme, std::string& path, std::map<std::string, std::string>& params) {
+    scheme.clear();
+    path = spec;
+    params.clear();
+    auto colon = spec.find(':');
+    if (colon != std::string::npos) {
+        scheme = spec.substr(0, colon);
+        path = spec.substr(colon + 1);
+    }
+    std::string query;
+    auto question = path.find('?');
+    if (question != std::string::npos) {
+        query = path.substr(question + 1);
+        path = path.substr(0, question);
+    } else if (scheme == "synth") {
+        // synth has no path, everything is a parameter
+        query = path;
+        path.clear();
+    }
+    size_t pos = 0;
+    while (pos < query.size()) {
+        auto amp = query.find('&', pos);
+        auto item = query.substr(pos, amp == std::string::npos ? std::string::npos : amp - pos);
+        auto eq = item.find('=');
+        if (!item.empty()) {
+            if (eq == std::string::npos) {
+                params[item] = "";
+            } else {
+                params[item.substr(0, eq)] = item.substr(eq + 1);
+            }
+        }
+        if (amp == std::string::npos) break;
+        pos = amp + 1;
+    }
+}
+
+int AudioSource::parse_number(const std::string& text, double& value) {
+    if (text.empty()) {
+        return -1;
+    }
+    char* end = nullptr;
+    const double parsed = std::strtod(text.c_str(), &end);
+    if (end != text.c_str() + text.size() || !std::isfinite(parsed)) {
+        return -1;
+    }
+    value = parsed;
+    return 0;
+}
+
+std::unique_ptr<AudioSource> AudioSource::create(const std::string& spec) {
+    std::string scheme;
+    std::string path;
+    std::map<std::string, std::string> params;
+    parse_spec(spec, scheme, path, params);
+    if (scheme == "file" || scheme == "raw") {
+        if (scheme == "raw") {
+            params["raw"] = "1";
+        }
+        return std::make_unique<FileSource>(path, params);
+    }
+    if (scheme == "synth") {
+        return std::make_unique<SynthSource>(params);
+    }
+    // Anything else is an ALSA PCM name (hw:0,0, plughw:1, default, null, ...)
+    auto device = spec.substr(0, spec.find('?'));
+    auto mmap = params.find("mmap");
+    return std::make_unique<AlsaSource>(device, mmap != params.end() && mmap->second != "0");
+}
+
+void SourceClock::reset(uint32_t sample_rate, bool realtime) {
+    m_sample_rate = sample_rate;
+    m_realtime = realtime;
+    m_position = 0;
+    m_start = std::chrono::high_resolution_clock::now();
+}
+
+AudioSource::tp SourceClock::advance(size_t frames) {
+    m_position += frames;
+    auto due = m_start + std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(
+        std::chrono::duration<double>(static_cast<double>(m_position) / m_sample_rate));
+    if (m_realtime) {
+        std::this_thread::sleep_until(due);
+    }
+    return due;
+}
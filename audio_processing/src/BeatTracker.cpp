@@ -0,0 +1,195 @@
+#include <BeatTracker.h>
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace audio_processing {
+
+// Log compression of band magnitudes before taking the flux
+static const float COMPRESSION = 1e-3f;
+// Flux has to beat MEDIAN_SCALE * median + MEDIAN_OFFSET to count as an onset
+static const float MEDIAN_SCALE = 1.5f;
+static const float MEDIAN_OFFSET = 1e-3f;
+static const double MEDIAN_SECONDS = 0.5;
+static const double MIN_ONSET_GAP_SECONDS = 0.1;
+// How long the tempo estimate remembers, and how long before beats come from it
+static const double TEMPO_MEMORY_SECONDS = 8.0;
+static const double WARMUP_SECONDS = 3.0;
+static const double PRIOR_BPM = 120.0;
+static const double PRIOR_OCTAVES = 0.5;
+// Phase correction per onset, and the window around a predicted beat it applies in
+static const double PHASE_GAIN = 0.2;
+static const double PHASE_WINDOW = 0.2;
+static const size_t MAX_MISSED = 4;
+
+void BeatTracker::reset(double frame_rate) {
+    if (frame_rate <= 0) {
+        spdlog::error("Invalid beat tracker frame rate {}", frame_rate);
+        return;
+    }
+    m_frame_rate = frame_rate;
+    m_frames = 0;
+    m_prev_bands.clear();
+
+    m_flux_window.assign(std::max<size_t>(3, static_cast<size_t>(MEDIAN_SECONDS * frame_rate)), 0.0f);
+    m_sorted = m_flux_window;
+    m_flux_pos = 0;
+    m_flux = m_prev_flux = 0;
+    m_last_onset = 0;
+    m_min_onset_gap = std::max<size_t>(1, static_cast<size_t>(MIN_ONSET_GAP_SECONDS * frame_rate));
+    m_onset = false;
+
+    m_min_lag = std::max<size_t>(1, static_cast<size_t>(std::floor(60.0 * frame_rate / MAX_BPM)));
+    m_max_lag = std::max(m_min_lag + 2, static_cast<size_t>(std::ceil(60.0 * frame_rate / MIN_BPM)));
+    // lags up to twice the longest period, see update_tempo()
+    m_novelty.assign(2 * m_max_lag + 2, 0.0f);
+    m_novelty_pos = 0;
+    m_autocorr.assign(m_novelty.size(), 0.0f);
+    m_score.assign(m_max_lag + 1, 0.0f);
+    m_prior.assign(m_max_lag + 1, 0.0f);
+    for (size_t lag = m_min_lag; lag <= m_max_lag; ++lag) {
+        double octaves = std::log2(60.0 * frame_rate / lag / PRIOR_BPM) / PRIOR_OCTAVES;
+        m_prior[lag] = static_cast<float>(std::exp(-0.5 * octaves * octaves));
+    }
+    m_decay = static_cast<float>(std::exp(-1.0 / (TEMPO_MEMORY_SECONDS * frame_rate)));
+    m_period = 60.0 * frame_rate / PRIOR_BPM;
+    m_bpm = 0;
+
+    m_phase = 0;
+    m_missed = 0;
+    m_locked = false;
+}
+
+float BeatTracker::median() const {
+    return m_sorted[m_sorted.size() / 2];
+}
+
+bool BeatTracker::process(const float* bands, size_t num_bands) {
+    if (m_frame_rate <= 0 || num_bands == 0) {
+        return false;
+    }
+    if (m_prev_bands.size() != num_bands) {
+        m_prev_bands.assign(num_bands, 0.0f);
+        for (size_t b = 0; b < num_bands; ++b) {
+            m_prev_bands[b] = std::log1p(COMPRESSION * std::abs(bands[b]));
+        }
+    }
+    m_frames++;
+
+    // Half wave rectified flux of the compressed spectrum
+    float flux = 0;
+    for (size_t b = 0; b < num_bands; ++b) {
+        float level = std::log1p(COMPRESSION * std::abs(bands[b]));
+        flux += std::max(0.0f, level - m_prev_bands[b]);
+        m_prev_bands[b] = level;
+    }
+    flux /= static_cast<float>(num_bands);
+
+    // Running median: swap the oldest value for the new one in the sorted copy
+    float oldest = m_flux_window[m_flux_pos];
+    m_flux_window[m_flux_pos] = flux;
+    m_flux_pos = (m_flux_pos + 1) % m_flux_window.size();
+    auto it = std::lower_bound(m_sorted.begin(), m_sorted.end(), oldest);
+    m_sorted.erase(it);
+    m_sorted.insert(std::upper_bound(m_sorted.begin(), m_sorted.end(), flux), flux);
+    const float threshold = MEDIAN_SCALE * median() + MEDIAN_OFFSET;
+
+    // The previous frame is an onset if it peaks above the threshold
+    m_onset = m_flux > m_prev_flux && m_flux >= flux && m_flux > threshold
+        && m_frames - m_last_onset > m_min_onset_gap;
+    if (m_onset) {
+        m_last_onset = m_frames;
+    }
+    m_prev_flux = m_flux;
+    m_flux = flux;
+
+    update_tempo(std::max(0.0f, flux - median()));
+    return update_phase();
+}
+
+void BeatTracker::update_tempo(float novelty) {
+    m_novelty[m_novelty_pos] = novelty;
+    const size_t size = m_novelty.size();
+    for (size_t lag = 1; lag < size; ++lag) {
+        float past = m_novelty[(m_novelty_pos + size - lag) % size];
+        m_autocorr[lag] = m_decay * m_autocorr[lag] + novelty * past;
+    }
+    m_novelty_pos = (m_novelty_pos + 1) % size;
+
+    // A period that falls between two lags splits its energy across both, so
+    // neighbours are summed; the double period backs up the candidate so
+    // half tempo doesn't win on the prior alone.
+    size_t best = 0;
+    float best_score = 0;
+    for (size_t lag = m_min_lag; lag <= m_max_lag; ++lag) {
+        float score = m_autocorr[lag - 1] + m_autocorr[lag] + m_autocorr[lag + 1];
+        if (2 * lag + 1 < size) {
+            score += 0.5f * (m_autocorr[2 * lag - 1] + m_autocorr[2 * lag] + m_autocorr[2 * lag + 1]);
+        }
+        m_score[lag] = score * m_prior[lag];
+        if (m_score[lag] > best_score) {
+            best_score = m_score[lag];
+            best = lag;
+        }
+    }
+    if (best == 0) {
+        return;
+    }
+    // The period comes from the sharpest peak available: around twice the lag
+    // when it is in range, halved, so rounding to whole frames costs half as much
+    const size_t multiple = 2 * best + 2 < size ? 2 : 1;
+    size_t peak = multiple * best;
+    for (size_t lag = peak - 1; lag <= multiple * best + 1; ++lag) {
+        if (m_autocorr[lag] > m_autocorr[peak]) {
+            peak = lag;
+        }
+    }
+    // Parabolic interpolation between neighbouring lags for a fractional period
+    double period = static_cast<double>(peak);
+    if (peak > 1 && peak + 1 < size) {
+        double left = m_autocorr[peak - 1];
+        double right = m_autocorr[peak + 1];
+        double denom = left - 2.0 * m_autocorr[peak] + right;
+        if (denom < 0) {
+            period += std::clamp(0.5 * (left - right) / denom, -0.5, 0.5);
+        }
+    }
+    period /= multiple;
+    m_period = period;
+    m_bpm = static_cast<float>(60.0 * m_frame_rate / period);
+}
+
+bool BeatTracker::update_phase() {
+    if (m_frames < WARMUP_SECONDS * m_frame_rate) {
+        // No tempo to go on yet, onsets are the beats
+        return m_onset;
+    }
+    m_phase += 1.0 / m_period;
+    if (m_onset) {
+        // The onset was a frame ago
+        double error = m_phase - 1.0 / m_period;
+        error -= std::round(error);
+        if (!m_locked || m_missed >= MAX_MISSED) {
+            m_phase = 1.0 / m_period;
+            m_locked = true;
+            m_missed = 0;
+        } else if (std::abs(error) < PHASE_WINDOW) {
+            m_phase -= PHASE_GAIN * error;
+            m_missed = 0;
+        } else {
+            m_missed++;
+        }
+    }
+    if (m_phase >= 1.0) {
+        m_phase -= std::floor(m_phase);
+        return true;
+    }
+    if (m_phase < 0) {
+        m_phase += 1.0;
+    }
+    return false;
+}
+
+}
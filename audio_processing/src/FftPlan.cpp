@@ -0,0 +1,199 @@
+#include <FftPlan.h>
+
+#include "spdlog/spdlog.h"
+#include "fftw3.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <utility>
+
+namespace audio_processing {
+
+static fftwf_r2r_kind to_fftw_kind(FftKind kind) {
+    switch (kind) {
+        case FftKind::HalfComplex: return FFTW_R2HC;
+        case FftKind::Dct2:
+        default: return FFTW_REDFT10;
+    }
+}
+
+static unsigned to_fftw_flags(FftEffort effort) {
+    switch (effort) {
+        case FftEffort::Estimate: return FFTW_ESTIMATE;
+        case FftEffort::Patient: return FFTW_PATIENT;
+        case FftEffort::Measure:
+        default: return FFTW_MEASURE;
+    }
+}
+
+FftPlanCache& FftPlanCache::instance() {
+    static FftPlanCache cache;
+    return cache;
+}
+
+FftPlanCache::~FftPlanCache() {
+    clear();
+}
+
+int FftPlanCache::alignment_of(const float* in, const float* out) {
+    if (fftwf_alignment_of(const_cast<float*>(in)) == 0 && fftwf_alignment_of(const_cast<float*>(out)) == 0) {
+        return 0;
+    }
+    return -1;
+}
+
+fftwf_plan FftPlanCache::get(size_t size, FftKind kind, int alignment, size_t howmany) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    howmany = std::max<size_t>(howmany, 1);
+    auto key = std::make_tuple(size, kind, alignment, howmany);
+    auto it = m_plans.find(key);
+    if (it != m_plans.end()) {
+        return it->second;
+    }
+
+    // MEASURE/PATIENT overwrite the arrays while planning, so plan on scratch buffers
+    const size_t stride = batch_stride(size);
+    float* in = fftwf_alloc_real(stride * howmany);
+    float* out = fftwf_alloc_real(stride * howmany);
+    unsigned flags = to_fftw_flags(m_effort);
+    if (alignment != 0) {
+        flags |= FFTW_UNALIGNED;
+    }
+    auto start = std::chrono::steady_clock::now();
+    fftwf_plan plan = nullptr;
+    if (howmany == 1) {
+        plan = fftwf_plan_r2r_1d(size, in, out, to_fftw_kind(kind), flags);
+    } else {
+        int n = static_cast<int>(size);
+        fftwf_r2r_kind fftw_kind = to_fftw_kind(kind);
+        plan = fftwf_plan_many_r2r(1, &n, static_cast<int>(howmany),
+            in, nullptr, 1, static_cast<int>(stride),
+            out, nullptr, 1, static_cast<int>(stride),
+            &fftw_kind, flags);
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    fftwf_free(in);
+    fftwf_free(out);
+    if (!plan) {
+        spdlog::error("Failed to create FFTW plan (size={}, kind={}, alignment={}, howmany={}).", size, static_cast<int>(kind), alignment, howmany);
+        return nullptr;
+    }
+    spdlog::info("Created FFTW plan (size={}, kind={}, alignment={}, howmany={}) in {} ms", size, static_cast<int>(kind), alignment, howmany, elapsed.count());
+    m_plans[key] = plan;
+    if (!m_wisdom_file.empty() && !fftwf_export_wisdom_to_filename(m_wisdom_file.c_str())) {
+        spdlog::warn("Unable to write FFTW wisdom to {}", m_wisdom_file);
+    }
+    return plan;
+}
+
+void FftPlanCache::set_effort(FftEffort effort) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_effort = effort;
+}
+
+int FftPlanCache::set_wisdom_file(const std::string& path) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_wisdom_file = path;
+    if (path.empty() || !std::filesystem::exists(path)) {
+        return 0;
+    }
+    if (!fftwf_import_wisdom_from_filename(path.c_str())) {
+        spdlog::warn("Unable to read FFTW wisdom from {}", path);
+        return -1;
+    }
+    spdlog::info("Loaded FFTW wisdom from {}", path);
+    return 0;
+}
+
+int FftPlanCache::save_wisdom() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_wisdom_file.empty()) {
+        return 0;
+    }
+    if (!fftwf_export_wisdom_to_filename(m_wisdom_file.c_str())) {
+        spdlog::warn("Unable to write FFTW wisdom to {}", m_wisdom_file);
+        return -1;
+    }
+    return 0;
+}
+
+void FftPlanCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& [key, plan] : m_plans) {
+        fftwf_destroy_plan(plan);
+    }
+    m_plans.clear();
+}
+
+size_t FftPlanCache::size() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_plans.size();
+}
+
+FftPlan::FftPlan(size_t size, FftKind kind, size_t howmany) {
+    reset(size, kind, howmany);
+}
+
+FftPlan::~FftPlan() {
+    release();
+}
+
+FftPlan::FftPlan(FftPlan&& other) noexcept {
+    *this = std::move(other);
+}
+
+FftPlan& FftPlan::operator=(FftPlan&& other) noexcept {
+    if (this != &other) {
+        release();
+        m_plan = std::exchange(other.m_plan, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+        m_howmany = std::exchange(other.m_howmany, 1);
+        m_stride = std::exchange(other.m_stride, 0);
+        m_kind = other.m_kind;
+        m_in = std::exchange(other.m_in, nullptr);
+        m_out = std::exchange(other.m_out, nullptr);
+    }
+    return *this;
+}
+
+int FftPlan::reset(size_t size, FftKind kind, size_t howmany) {
+    howmany = std::max<size_t>(howmany, 1);
+    if (valid() && size == m_size && kind == m_kind && howmany == m_howmany) {
+        return 0;
+    }
+    release();
+    if (size == 0) {
+        return 0;
+    }
+    // a single transform keeps its exact size, as it always has
+    const size_t stride = howmany > 1 ? FftPlanCache::batch_stride(size) : size;
+    m_in = fftwf_alloc_real(stride * howmany);
+    m_out = fftwf_alloc_real(stride * howmany);
+    std::fill(m_in, m_in + stride * howmany, 0.0f);
+    std::fill(m_out, m_out + stride * howmany, 0.0f);
+    m_plan = FftPlanCache::instance().get(size, kind, FftPlanCache::alignment_of(m_in, m_out), howmany);
+    m_size = size;
+    m_howmany = howmany;
+    m_stride = stride;
+    m_kind = kind;
+    return m_plan ? 0 : -1;
+}
+
+void FftPlan::execute() {
+    fftwf_execute_r2r(m_plan, m_in, m_out);
+}
+
+void FftPlan::release() {
+    // The plan itself belongs to FftPlanCache
+    m_plan = nullptr;
+    if (m_in) fftwf_free(m_in);
+    if (m_out) fftwf_free(m_out);
+    m_in = nullptr;
+    m_out = nullptr;
+    m_size = 0;
+    m_howmany = 1;
+    m_stride = 0;
+}
+
+}
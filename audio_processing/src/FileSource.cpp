@@ -0,0 +1,171 @@
+#include <FileSource.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static uint32_t read_le32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static uint16_t read_le16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+FileSource::FileSource(const std::string& path, const std::map<std::string, std::string>& params)
+    : m_path(path) {
+    auto get = [&params](const std::string& key) {
+        auto it = params.find(key);
+        return it == params.end() ? std::string() : it->second;
+    };
+    std::string suffix = m_path.size() < 4 ? std::string() : m_path.substr(m_path.size() - 4);
+    std::transform(suffix.begin(), suffix.end(), suffix.begin(), [](unsigned char c) { return std::tolower(c); });
+    m_raw = params.count("raw") > 0 || suffix != ".wav";
+    m_loop = params.count("loop") > 0 && get("loop") != "0";
+    m_realtime = get("pace") != "fast";
+    // whole numbers from 1 up, checked here and reported by open()
+    auto count = [&](const std::string& key, uint32_t& out, double max) {
+        if (params.count(key) == 0) {
+            return;
+        }
+        double value = 0;
+        if (parse_number(get(key), value) != 0 || value < 1 || value > max || value != std::floor(value)) {
+            m_param_error = key + "=" + get(key) + " is not a whole number from 1 to " + std::to_string(static_cast<uint64_t>(max));
+            return;
+        }
+        out = static_cast<uint32_t>(value);
+    };
+    count("rate", m_raw_rate, 1e6);
+    count("channels", m_raw_channels, 64);
+}
+
+FileSource::~FileSource() {
+    close();
+}
+
+int FileSource::open(AudioFormat& format) {
+    if (!m_param_error.empty()) {
+        spdlog::error("Audio file {}: {}", m_path, m_param_error);
+        return -1;
+    }
+    m_fd = ::open(m_path.c_str(), O_RDONLY);
+    if (m_fd < 0) {
+        spdlog::error("Unable to open audio file {}: {}", m_path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(m_fd, &st) < 0 || st.st_size == 0) {
+        spdlog::error("Unable to stat audio file {} (or it is empty)", m_path);
+        close();
+        return -1;
+    }
+    m_map_size = st.st_size;
+    void* map = mmap(nullptr, m_map_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if (map == MAP_FAILED) {
+        spdlog::error("Unable to mmap audio file {}: {}", m_path, strerror(errno));
+        m_map = nullptr;
+        close();
+        return -1;
+    }
+    m_map = static_cast<const uint8_t*>(map);
+    madvise(map, m_map_size, MADV_SEQUENTIAL);
+
+    if (m_raw) {
+        format.sample_rate = m_raw_rate;
+        format.num_channels = m_raw_channels;
+        m_samples = reinterpret_cast<const int16_t*>(m_map);
+        m_total_frames = m_map_size / (sizeof(int16_t) * format.num_channels);
+    } else if (parse_wav(format) != 0) {
+        close();
+        return -1;
+    }
+    m_num_channels = format.num_channels;
+    m_cursor = 0;
+    m_clock.reset(format.sample_rate, m_realtime);
+    spdlog::info("Audio file {} opened: rate={} Hz, channels={}, {} frames, {}",
+        m_path, format.sample_rate, format.num_channels, m_total_frames, m_realtime ? "realtime" : "as fast as possible");
+    return 0;
+}
+
+int FileSource::parse_wav(AudioFormat& format) {
+    if (m_map_size < 12 || std::memcmp(m_map, "RIFF", 4) != 0 || std::memcmp(m_map + 8, "WAVE", 4) != 0) {
+        spdlog::error("{} is not a RIFF/WAVE file", m_path);
+        return -1;
+    }
+    bool have_fmt = false;
+    size_t pos = 12;
+    while (pos + 8 <= m_map_size) {
+        const uint8_t* chunk = m_map + pos;
+        uint32_t chunk_size = read_le32(chunk + 4);
+        const uint8_t* body = chunk + 8;
+        size_t available = std::min<size_t>(chunk_size, m_map_size - pos - 8);
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && available >= 16) {
+            uint16_t audio_format = read_le16(body);
+            uint16_t bits = read_le16(body + 14);
+            // 1 = PCM, 0xFFFE = WAVE_FORMAT_EXTENSIBLE (assumed PCM)
+            if ((audio_format != 1 && audio_format != 0xFFFE) || bits != 16) {
+                spdlog::error("{}: only 16-bit PCM WAV is supported (format {}, {} bits)", m_path, audio_format, bits);
+                return -1;
+            }
+            format.num_channels = read_le16(body + 2);
+            format.sample_rate = read_le32(body + 4);
+            have_fmt = true;
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            if (!have_fmt || format.num_channels == 0) {
+                spdlog::error("{}: data chunk before fmt chunk", m_path);
+                return -1;
+            }
+            m_samples = reinterpret_cast<const int16_t*>(body);
+            m_total_frames = available / (sizeof(int16_t) * format.num_channels);
+            return 0;
+        }
+        // chunks are word aligned
+        pos += 8 + chunk_size + (chunk_size & 1);
+    }
+    spdlog::error("{}: no data chunk", m_path);
+    return -1;
+}
+
+int FileSource::read(int16_t* buffer, size_t frames, tp& timestamp, uint64_t& frame_num) {
+    if (m_cursor >= m_total_frames && (!m_loop || m_total_frames == 0)) {
+        return END_OF_STREAM;
+    }
+    // Looping fills the whole period across the wrap; only the end of a
+    // file that doesn't loop comes back short
+    size_t count = 0;
+    while (count < frames) {
+        if (m_cursor >= m_total_frames) {
+            if (!m_loop || m_total_frames == 0) {
+                break;
+            }
+            m_cursor = 0;
+        }
+        const size_t n = std::min(frames - count, m_total_frames - m_cursor);
+        std::memcpy(buffer + count * m_num_channels, m_samples + m_cursor * m_num_channels, n * m_num_channels * sizeof(int16_t));
+        m_cursor += n;
+        count += n;
+    }
+    frame_num = m_clock.position();
+    timestamp = m_clock.advance(count);
+    return count;
+}
+
+void FileSource::close() {
+    if (m_map) {
+        munmap(const_cast<uint8_t*>(m_map), m_map_size);
+        m_map = nullptr;
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_samples = nullptr;
+    m_total_frames = 0;
+}
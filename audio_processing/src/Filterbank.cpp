@@ -0,0 +1,99 @@
+#include <Filterbank.h>
+#include <SampleKernels.h>
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace audio_processing {
+
+static double to_scale(double hz, BandScale scale) {
+    switch (scale) {
+        case BandScale::Mel: return 2595.0 * std::log10(1.0 + hz / 700.0);
+        case BandScale::Log: return std::log2(hz);
+        default: return hz;
+    }
+}
+
+static double from_scale(double value, BandScale scale) {
+    switch (scale) {
+        case BandScale::Mel: return 700.0 * (std::pow(10.0, value / 2595.0) - 1.0);
+        case BandScale::Log: return std::exp2(value);
+        default: return value;
+    }
+}
+
+int Filterbank::build(size_t num_bins, double bin_hz, size_t num_bands, BandScale scale, double min_hz, double max_hz) {
+    if (num_bins == 0 || num_bands == 0 || bin_hz <= 0 || scale == BandScale::Resample) {
+        spdlog::error("Invalid filterbank ({} bins, {} Hz, {} bands, scale {})", num_bins, bin_hz, num_bands, static_cast<int>(scale));
+        return -1;
+    }
+    const double top_hz = (num_bins - 1) * bin_hz;
+    if (max_hz <= 0 || max_hz > top_hz) max_hz = top_hz;
+    if (scale == BandScale::Linear) min_hz = std::max(min_hz, 0.0);
+    // log2(0) is no good
+    if (scale == BandScale::Log) min_hz = std::max(min_hz, bin_hz);
+    if (min_hz >= max_hz) {
+        spdlog::error("Invalid filterbank range {} - {} Hz", min_hz, max_hz);
+        return -1;
+    }
+
+    // Band b peaks at edges[b + 1] and falls to zero at edges[b] and edges[b + 2]
+    std::vector<double> edges(num_bands + 2);
+    const double lo = to_scale(min_hz, scale);
+    const double hi = to_scale(max_hz, scale);
+    for (size_t i = 0; i < edges.size(); ++i) {
+        edges[i] = from_scale(lo + (hi - lo) * i / (num_bands + 1), scale);
+    }
+
+    m_num_bins = num_bins;
+    m_bin_hz = bin_hz;
+    m_scale = scale;
+    m_first_bins.assign(num_bands, 0);
+    m_offsets.assign(num_bands + 1, 0);
+    m_centers.assign(num_bands, 0);
+    std::vector<float> weights;
+    for (size_t b = 0; b < num_bands; ++b) {
+        const double left = edges[b];
+        const double center = edges[b + 1];
+        const double right = edges[b + 2];
+        m_centers[b] = center;
+        size_t first = static_cast<size_t>(std::ceil(left / bin_hz));
+        size_t last = std::min(num_bins - 1, static_cast<size_t>(std::floor(right / bin_hz)));
+        const size_t start = weights.size();
+        double total = 0;
+        for (size_t bin = first; bin <= last; ++bin) {
+            double hz = bin * bin_hz;
+            double w = hz <= center ? (hz - left) / (center - left) : (right - hz) / (right - center);
+            weights.push_back(static_cast<float>(std::max(w, 0.0)));
+            total += std::max(w, 0.0);
+        }
+        if (total <= 0) {
+            // narrower than a bin, use the closest one
+            weights.resize(start);
+            first = std::min(num_bins - 1, static_cast<size_t>(std::lround(center / bin_hz)));
+            weights.push_back(1.0f);
+            total = 1.0;
+        }
+        for (size_t i = start; i < weights.size(); ++i) {
+            weights[i] = static_cast<float>(weights[i] / total);
+        }
+        m_first_bins[b] = static_cast<uint32_t>(first);
+        m_offsets[b + 1] = static_cast<uint32_t>(weights.size());
+    }
+    m_weights.resize(weights.size());
+    std::copy(weights.begin(), weights.end(), m_weights.begin());
+    spdlog::debug("Built filterbank: {} bins, {} bands, {} weights", num_bins, num_bands, weights.size());
+    return 0;
+}
+
+void Filterbank::apply(const float* spectrum, float* out) const {
+    band_sums(spectrum, m_first_bins.data(), m_offsets.data(), m_weights.data(), m_first_bins.size(), out);
+}
+
+void Filterbank::apply_scalar(const float* spectrum, float* out) const {
+    band_sums_scalar(spectrum, m_first_bins.data(), m_offsets.data(), m_weights.data(), m_first_bins.size(), out);
+}
+
+}
@@ -0,0 +1,167 @@
+#include <RenderScheduler.h>
+#include <AudioProcess.h>
+#include <Tracer.h>
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const auto STATS_WINDOW = std::chrono::seconds(1);
+
+void RenderScheduler::set_target_fps(double fps) {
+    if (fps <= 0) {
+        spdlog::error("Invalid target FPS {}", fps);
+        return;
+    }
+    m_period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / fps));
+}
+
+void RenderScheduler::push(const AudioProcess& process) {
+    std::lock_guard<std::mutex> lock(m_frames_mutex);
+    auto& frame = m_frames[m_next];
+    frame.timestamp = process.m_cur_time;
+    frame.analysed = std::chrono::high_resolution_clock::now();
+    frame.frame_num = process.m_cur_frame;
+    frame.volume = process.m_volume;
+    frame.beat = process.m_beat_detected;
+    frame.bpm = process.m_bpm;
+    frame.beat_phase = process.m_beat_phase;
+    if (!process.m_fft.empty()) {
+        // reuses the slot's storage once it has grown
+        frame.fft.assign(process.m_fft.begin(), process.m_fft.end());
+    } else {
+        frame.fft.clear();
+    }
+    m_next = (m_next + 1) % m_frames.size();
+    m_count = std::min(m_count + 1, m_frames.size());
+}
+
+void RenderScheduler::push(const AnalysisFrame& frame) {
+    std::lock_guard<std::mutex> lock(m_frames_mutex);
+    auto& slot = m_frames[m_next];
+    slot.timestamp = frame.timestamp;
+    slot.analysed = frame.analysed == tp() ? std::chrono::high_resolution_clock::now() : frame.analysed;
+    slot.frame_num = frame.frame_num;
+    slot.volume = frame.volume;
+    slot.beat = frame.beat;
+    slot.bpm = frame.bpm;
+    slot.beat_phase = frame.beat_phase;
+    slot.fft.assign(frame.fft.begin(), frame.fft.end());
+    m_next = (m_next + 1) % m_frames.size();
+    m_count = std::min(m_count + 1, m_frames.size());
+}
+
+bool RenderScheduler::select(const tp& target, AnalysisFrame& out) const {
+    std::lock_guard<std::mutex> lock(m_frames_mutex);
+    const AnalysisFrame* best = nullptr;
+    auto best_distance = tp::duration::max();
+    for (size_t i = 0; i < m_count; ++i) {
+        const auto& frame = m_frames[i];
+        auto distance = frame.timestamp > target ? frame.timestamp - target : target - frame.timestamp;
+        if (distance < best_distance) {
+            best_distance = distance;
+            best = &frame;
+        }
+    }
+    if (!best) {
+        return false;
+    }
+    out.timestamp = best->timestamp;
+    out.analysed = best->analysed;
+    out.frame_num = best->frame_num;
+    out.volume = best->volume;
+    out.beat = best->beat;
+    out.bpm = best->bpm;
+    out.beat_phase = best->beat_phase;
+    out.fft.assign(best->fft.begin(), best->fft.end());
+    return true;
+}
+
+int RenderScheduler::start(const std::function<void(const AnalysisFrame&)>& render) {
+    if (m_thread.joinable()) {
+        return 0;
+    }
+    m_render = render;
+    {
+        std::lock_guard<std::mutex> lock(m_stats_mutex);
+        m_stats = Stats();
+        m_window_start = clock::now();
+        m_last_render = clock::time_point();
+        m_window_frames = 0;
+        m_window_sum = m_window_sum_sq = m_window_max_late = 0;
+    }
+    m_stop = false;
+    m_thread = std::thread(&RenderScheduler::run, this);
+    return 0;
+}
+
+void RenderScheduler::stop() {
+    m_stop = true;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    m_thread = std::thread();
+}
+
+void RenderScheduler::run() {
+    Tracer::set_thread_name("render");
+    AnalysisFrame frame;
+    auto deadline = clock::now();
+    while (!m_stop) {
+        const auto period = m_period.load();
+        deadline += period;
+        std::this_thread::sleep_until(deadline);
+        auto woke = clock::now();
+        if (woke - deadline >= period) {
+            // Fell behind, skip to the next deadline that is still ahead
+            auto missed = (woke - deadline) / period;
+            deadline += missed * period;
+            std::lock_guard<std::mutex> lock(m_stats_mutex);
+            m_stats.skipped += missed;
+        }
+
+        auto target = std::chrono::high_resolution_clock::now() + m_latency;
+        if (!select(target, frame)) {
+            continue;
+        }
+        if (target - frame.timestamp > m_stale_after) {
+            std::lock_guard<std::mutex> lock(m_stats_mutex);
+            m_stats.stale++;
+            continue;
+        }
+        m_render(frame);
+        record(deadline, woke);
+    }
+}
+
+void RenderScheduler::record(clock::time_point deadline, clock::time_point woke) {
+    std::lock_guard<std::mutex> lock(m_stats_mutex);
+    m_stats.rendered++;
+    if (m_last_render != clock::time_point()) {
+        double interval = std::chrono::duration<double, std::milli>(woke - m_last_render).count();
+        m_window_sum += interval;
+        m_window_sum_sq += interval * interval;
+        m_window_frames++;
+    }
+    m_last_render = woke;
+    m_window_max_late = std::max(m_window_max_late, std::chrono::duration<double, std::milli>(woke - deadline).count());
+
+    auto elapsed = woke - m_window_start;
+    if (elapsed >= STATS_WINDOW && m_window_frames > 0) {
+        double mean = m_window_sum / m_window_frames;
+        m_stats.fps = m_window_frames / std::chrono::duration<double>(elapsed).count();
+        m_stats.jitter_ms = std::sqrt(std::max(0.0, m_window_sum_sq / m_window_frames - mean * mean));
+        m_stats.max_late_ms = m_window_max_late;
+        m_window_start = woke;
+        m_window_frames = 0;
+        m_window_sum = m_window_sum_sq = m_window_max_late = 0;
+    }
+}
+
+RenderScheduler::Stats RenderScheduler::stats() const {
+    std::lock_guard<std::mutex> lock(m_stats_mutex);
+    Stats stats = m_stats;
+    stats.target_fps = 1.0 / std::chrono::duration<double>(m_period.load()).count();
+    return stats;
+}
@@ -0,0 +1,62 @@
+#include <Resampler.h>
+#include <SampleKernels.h>
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace audio_processing {
+
+int Resampler::reset(size_t input_size, size_t output_size, ResampleMode mode) {
+    if (input_size == 0 || output_size == 0 || input_size > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+        spdlog::error("Invalid resampler {} -> {}", input_size, output_size);
+        return -1;
+    }
+    m_input_size = input_size;
+    m_output_size = output_size;
+    m_mode = mode;
+    const double ratio = static_cast<double>(input_size) / static_cast<double>(output_size);
+    const bool box = mode == ResampleMode::Box && ratio > 1.0;
+    // an output spans `ratio` inputs, which can touch ceil(ratio) + 1 of them
+    m_taps = box ? static_cast<size_t>(std::ceil(ratio)) + 1 : 2;
+    m_indices.resize(m_taps * output_size);
+    m_weights.resize(m_taps * output_size);
+    std::fill(m_indices.begin(), m_indices.end(), 0);
+    std::fill(m_weights.begin(), m_weights.end(), 0.0f);
+    const int32_t last = static_cast<int32_t>(input_size - 1);
+
+    for (size_t i = 0; i < output_size; ++i) {
+        if (box) {
+            // weight every input by how much of [start, end) it covers
+            const double start = i * ratio;
+            const double end = start + ratio;
+            size_t k = 0;
+            for (size_t j = static_cast<size_t>(start); j < input_size && static_cast<double>(j) < end && k < m_taps; ++j, ++k) {
+                double overlap = std::min(end, j + 1.0) - std::max(start, static_cast<double>(j));
+                m_indices[k * output_size + i] = static_cast<int32_t>(j);
+                m_weights[k * output_size + i] = static_cast<float>(std::max(overlap, 0.0) / ratio);
+            }
+        } else {
+            const double pos = std::clamp((i + 0.5) * ratio - 0.5, 0.0, static_cast<double>(last));
+            const int32_t before = static_cast<int32_t>(pos);
+            const double frac = pos - before;
+            m_indices[i] = before;
+            m_indices[output_size + i] = std::min(before + 1, last);
+            m_weights[i] = static_cast<float>(1.0 - frac);
+            m_weights[output_size + i] = static_cast<float>(frac);
+        }
+    }
+    return 0;
+}
+
+void Resampler::process(const float* in, float* out) const {
+    gather_sums(in, m_indices.data(), m_weights.data(), m_taps, m_output_size, out);
+}
+
+void Resampler::process_scalar(const float* in, float* out) const {
+    gather_sums_scalar(in, m_indices.data(), m_weights.data(), m_taps, m_output_size, out);
+}
+
+}
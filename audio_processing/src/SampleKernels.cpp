@@ -0,0 +1,418 @@
+#include <SampleKernels.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PIOD_SIMD_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define PIOD_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace audio_processing {
+
+void WindowTable::reset(size_t size, WindowType type) {
+    m_table.resize(size);
+    m_type = type;
+    // periodic windows, the frame is one period of a longer signal
+    const double step = 2.0 * std::numbers::pi / static_cast<double>(size);
+    for (size_t i = 0; i < size; ++i) {
+        double x = step * static_cast<double>(i);
+        double w = 1.0;
+        switch (type) {
+            case WindowType::Hann: w = 0.5 - 0.5 * std::cos(x); break;
+            case WindowType::Hamming: w = 0.54 - 0.46 * std::cos(x); break;
+            case WindowType::Blackman: w = 0.42 - 0.5 * std::cos(x) + 0.08 * std::cos(2.0 * x); break;
+            case WindowType::Rectangular:
+            default: break;
+        }
+        m_table[i] = static_cast<float>(w);
+    }
+}
+
+// Frames [begin, frames), accumulating into per-channel sum_sq and peak
+static void scalar_range(const int16_t* in, size_t begin, size_t frames, size_t num_channels, const float* window,
+        float* const* out, double* sum_sq, float* peak) {
+    for (size_t i = begin; i < frames; ++i) {
+        const float w = window ? window[i] : 1.0f;
+        for (size_t c = 0; c < num_channels; ++c) {
+            float x = static_cast<float>(in[i * num_channels + c]);
+            sum_sq[c] += static_cast<double>(x) * x;
+            peak[c] = std::max(peak[c], std::abs(x));
+            out[c][i] = x * w;
+        }
+    }
+}
+
+// Overall levels, and per channel ones into channel_stats if given
+static SampleStats finish(const double* sum_sq, const float* peak, size_t num_channels, size_t frames, SampleStats* channel_stats) {
+    double total = 0;
+    SampleStats stats;
+    for (size_t c = 0; c < num_channels; ++c) {
+        total += sum_sq[c];
+        stats.peak = std::max(stats.peak, peak[c]);
+        if (channel_stats) {
+            channel_stats[c].rms = frames ? static_cast<float>(std::sqrt(sum_sq[c] / static_cast<double>(frames))) : 0.0f;
+            channel_stats[c].peak = peak[c];
+        }
+    }
+    const size_t samples = frames * num_channels;
+    stats.rms = samples ? static_cast<float>(std::sqrt(total / static_cast<double>(samples))) : 0.0f;
+    return stats;
+}
+
+SampleStats deinterleave_window_scalar(const int16_t* in, size_t frames, size_t num_channels, const float* window,
+        float* const* out, SampleStats* channel_stats) {
+    // the accumulators live on the stack for any realistic channel count
+    static const size_t STACK_CHANNELS = 16;
+    double stack_sum_sq[STACK_CHANNELS] = {};
+    float stack_peak[STACK_CHANNELS] = {};
+    std::vector<double> heap_sum_sq;
+    std::vector<float> heap_peak;
+    double* sum_sq = stack_sum_sq;
+    float* peak = stack_peak;
+    if (num_channels > STACK_CHANNELS) {
+        heap_sum_sq.assign(num_channels, 0.0);
+        heap_peak.assign(num_channels, 0.0f);
+        sum_sq = heap_sum_sq.data();
+        peak = heap_peak.data();
+    }
+    scalar_range(in, 0, frames, num_channels, window, out, sum_sq, peak);
+    return finish(sum_sq, peak, num_channels, frames, channel_stats);
+}
+
+void band_sums_scalar(const float* spectrum, const uint32_t* first_bins, const uint32_t* offsets,
+        const float* weights, size_t num_bands, float* out) {
+    for (size_t b = 0; b < num_bands; ++b) {
+        const float* x = spectrum + first_bins[b];
+        const float* w = weights + offsets[b];
+        const size_t n = offsets[b + 1] - offsets[b];
+        float sum = 0;
+        for (size_t i = 0; i < n; ++i) {
+            sum += w[i] * std::abs(x[i]);
+        }
+        out[b] = sum;
+    }
+}
+
+void gather_sums_scalar(const float* in, const int32_t* indices, const float* weights, size_t taps, size_t n, float* out) {
+    for (size_t i = 0; i < n; ++i) {
+        float sum = 0;
+        for (size_t k = 0; k < taps; ++k) {
+            sum += in[indices[k * n + i]] * weights[k * n + i];
+        }
+        out[i] = sum;
+    }
+}
+
+// The vector loops keep per-lane float sums and flush them to double every
+// block so long periods don't lose precision.
+static const size_t FLUSH_FRAMES = 1024;
+
+#if PIOD_SIMD_X86
+
+__attribute__((target("avx2")))
+static SampleStats avx2_kernel(const int16_t* in, size_t frames, size_t num_channels, const float* window,
+        float* const* out, SampleStats* channel_stats) {
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 ones = _mm256_set1_ps(1.0f);
+    __m256 peak_l8 = _mm256_setzero_ps();
+    __m256 peak_r8 = _mm256_setzero_ps();
+    double sum_sq[2] = {0, 0};
+    size_t i = 0;
+    while (i + 8 <= frames) {
+        __m256 sum_l8 = _mm256_setzero_ps();
+        __m256 sum_r8 = _mm256_setzero_ps();
+        const size_t block_end = std::min(frames, i + FLUSH_FRAMES);
+        for (; i + 8 <= block_end; i += 8) {
+            const __m256 w = window ? _mm256_loadu_ps(window + i) : ones;
+            if (num_channels == 1) {
+                __m256 x = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i))));
+                sum_l8 = _mm256_add_ps(sum_l8, _mm256_mul_ps(x, x));
+                peak_l8 = _mm256_max_ps(peak_l8, _mm256_andnot_ps(sign, x));
+                _mm256_storeu_ps(out[0] + i, _mm256_mul_ps(x, w));
+            } else {
+                // 8 stereo frames; each 32 bit lane holds L in the low half and R in the high half
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i * 2));
+                __m256 l = _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16));
+                __m256 r = _mm256_cvtepi32_ps(_mm256_srai_epi32(v, 16));
+                sum_l8 = _mm256_add_ps(sum_l8, _mm256_mul_ps(l, l));
+                sum_r8 = _mm256_add_ps(sum_r8, _mm256_mul_ps(r, r));
+                peak_l8 = _mm256_max_ps(peak_l8, _mm256_andnot_ps(sign, l));
+                peak_r8 = _mm256_max_ps(peak_r8, _mm256_andnot_ps(sign, r));
+                _mm256_storeu_ps(out[0] + i, _mm256_mul_ps(l, w));
+                _mm256_storeu_ps(out[1] + i, _mm256_mul_ps(r, w));
+            }
+        }
+        alignas(32) float lanes[8];
+        _mm256_store_ps(lanes, sum_l8);
+        for (float lane : lanes) sum_sq[0] += lane;
+        _mm256_store_ps(lanes, sum_r8);
+        for (float lane : lanes) sum_sq[1] += lane;
+    }
+    alignas(32) float lanes[8];
+    float peak[2];
+    _mm256_store_ps(lanes, peak_l8);
+    peak[0] = *std::max_element(lanes, lanes + 8);
+    _mm256_store_ps(lanes, peak_r8);
+    peak[1] = *std::max_element(lanes, lanes + 8);
+    scalar_range(in, i, frames, num_channels, window, out, sum_sq, peak);
+    return finish(sum_sq, peak, num_channels, frames, channel_stats);
+}
+
+// SSE2 is part of x86-64, so this is the baseline there
+static SampleStats sse2_kernel(const int16_t* in, size_t frames, size_t num_channels, const float* window,
+        float* const* out, SampleStats* channel_stats) {
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 ones = _mm_set1_ps(1.0f);
+    __m128 peak_l4 = _mm_setzero_ps();
+    __m128 peak_r4 = _mm_setzero_ps();
+    double sum_sq[2] = {0, 0};
+    size_t i = 0;
+    while (i + 4 <= frames) {
+        __m128 sum_l4 = _mm_setzero_ps();
+        __m128 sum_r4 = _mm_setzero_ps();
+        const size_t block_end = std::min(frames, i + FLUSH_FRAMES);
+        for (; i + 4 <= block_end; i += 4) {
+            const __m128 w = window ? _mm_loadu_ps(window + i) : ones;
+            if (num_channels == 1) {
+                __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i));
+                __m128 x = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+                sum_l4 = _mm_add_ps(sum_l4, _mm_mul_ps(x, x));
+                peak_l4 = _mm_max_ps(peak_l4, _mm_andnot_ps(sign, x));
+                _mm_storeu_ps(out[0] + i, _mm_mul_ps(x, w));
+            } else {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 2));
+                __m128 l = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(v, 16), 16));
+                __m128 r = _mm_cvtepi32_ps(_mm_srai_epi32(v, 16));
+                sum_l4 = _mm_add_ps(sum_l4, _mm_mul_ps(l, l));
+                sum_r4 = _mm_add_ps(sum_r4, _mm_mul_ps(r, r));
+                peak_l4 = _mm_max_ps(peak_l4, _mm_andnot_ps(sign, l));
+                peak_r4 = _mm_max_ps(peak_r4, _mm_andnot_ps(sign, r));
+                _mm_storeu_ps(out[0] + i, _mm_mul_ps(l, w));
+                _mm_storeu_ps(out[1] + i, _mm_mul_ps(r, w));
+            }
+        }
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, sum_l4);
+        for (float lane : lanes) sum_sq[0] += lane;
+        _mm_store_ps(lanes, sum_r4);
+        for (float lane : lanes) sum_sq[1] += lane;
+    }
+    alignas(16) float lanes[4];
+    float peak[2];
+    _mm_store_ps(lanes, peak_l4);
+    peak[0] = *std::max_element(lanes, lanes + 4);
+    _mm_store_ps(lanes, peak_r4);
+    peak[1] = *std::max_element(lanes, lanes + 4);
+    scalar_range(in, i, frames, num_channels, window, out, sum_sq, peak);
+    return finish(sum_sq, peak, num_channels, frames, channel_stats);
+}
+
+
+static void sse2_band_sums(const float* spectrum, const uint32_t* first_bins, const uint32_t* offsets,
+        const float* weights, size_t num_bands, float* out) {
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    for (size_t b = 0; b < num_bands; ++b) {
+        const float* x = spectrum + first_bins[b];
+        const float* w = weights + offsets[b];
+        const size_t n = offsets[b + 1] - offsets[b];
+        __m128 sum4 = _mm_setzero_ps();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            sum4 = _mm_add_ps(sum4, _mm_mul_ps(_mm_loadu_ps(w + i), _mm_andnot_ps(sign, _mm_loadu_ps(x + i))));
+        }
+        sum4 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+        float sum = _mm_cvtss_f32(_mm_add_ss(sum4, _mm_shuffle_ps(sum4, sum4, 1)));
+        for (; i < n; ++i) {
+            sum += w[i] * std::abs(x[i]);
+        }
+        out[b] = sum;
+    }
+}
+
+__attribute__((target("avx2")))
+static void avx2_band_sums(const float* spectrum, const uint32_t* first_bins, const uint32_t* offsets,
+        const float* weights, size_t num_bands, float* out) {
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    for (size_t b = 0; b < num_bands; ++b) {
+        const float* x = spectrum + first_bins[b];
+        const float* w = weights + offsets[b];
+        const size_t n = offsets[b + 1] - offsets[b];
+        __m256 sum8 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            sum8 = _mm256_add_ps(sum8, _mm256_mul_ps(_mm256_loadu_ps(w + i), _mm256_andnot_ps(sign, _mm256_loadu_ps(x + i))));
+        }
+        __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(sum8), _mm256_extractf128_ps(sum8, 1));
+        sum4 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+        float sum = _mm_cvtss_f32(_mm_add_ss(sum4, _mm_shuffle_ps(sum4, sum4, 1)));
+        for (; i < n; ++i) {
+            sum += w[i] * std::abs(x[i]);
+        }
+        out[b] = sum;
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void avx2_gather_sums(const float* in, const int32_t* indices, const float* weights, size_t taps, size_t n, float* out) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 sum = _mm256_setzero_ps();
+        for (size_t k = 0; k < taps; ++k) {
+            __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + k * n + i));
+            sum = _mm256_fmadd_ps(_mm256_i32gather_ps(in, idx, 4), _mm256_loadu_ps(weights + k * n + i), sum);
+        }
+        _mm256_storeu_ps(out + i, sum);
+    }
+    for (; i < n; ++i) {
+        float sum = 0;
+        for (size_t k = 0; k < taps; ++k) {
+            sum += in[indices[k * n + i]] * weights[k * n + i];
+        }
+        out[i] = sum;
+    }
+}
+
+#elif PIOD_SIMD_NEON
+
+static SampleStats neon_kernel(const int16_t* in, size_t frames, size_t num_channels, const float* window,
+        float* const* out, SampleStats* channel_stats) {
+    const float32x4_t ones = vdupq_n_f32(1.0f);
+    float32x4_t peak4[2] = {vdupq_n_f32(0.0f), vdupq_n_f32(0.0f)};
+    double sum_sq[2] = {0, 0};
+    size_t i = 0;
+    while (i + 8 <= frames) {
+        float32x4_t sum4[2] = {vdupq_n_f32(0.0f), vdupq_n_f32(0.0f)};
+        const size_t block_end = std::min(frames, i + FLUSH_FRAMES);
+        for (; i + 8 <= block_end; i += 8) {
+            const float32x4_t w_lo = window ? vld1q_f32(window + i) : ones;
+            const float32x4_t w_hi = window ? vld1q_f32(window + i + 4) : ones;
+            int16x8_t channels[2];
+            if (num_channels == 1) {
+                channels[0] = vld1q_s16(in + i);
+            } else {
+                int16x8x2_t lr = vld2q_s16(in + i * 2);
+                channels[0] = lr.val[0];
+                channels[1] = lr.val[1];
+            }
+            for (size_t c = 0; c < num_channels; ++c) {
+                float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(channels[c])));
+                float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(channels[c])));
+                sum4[c] = vmlaq_f32(vmlaq_f32(sum4[c], lo, lo), hi, hi);
+                peak4[c] = vmaxq_f32(peak4[c], vmaxq_f32(vabsq_f32(lo), vabsq_f32(hi)));
+                vst1q_f32(out[c] + i, vmulq_f32(lo, w_lo));
+                vst1q_f32(out[c] + i + 4, vmulq_f32(hi, w_hi));
+            }
+        }
+        sum_sq[0] += vaddvq_f32(sum4[0]);
+        sum_sq[1] += vaddvq_f32(sum4[1]);
+    }
+    float peak[2] = {vmaxvq_f32(peak4[0]), vmaxvq_f32(peak4[1])};
+    scalar_range(in, i, frames, num_channels, window, out, sum_sq, peak);
+    return finish(sum_sq, peak, num_channels, frames, channel_stats);
+}
+
+static void neon_band_sums(const float* spectrum, const uint32_t* first_bins, const uint32_t* offsets,
+        const float* weights, size_t num_bands, float* out) {
+    for (size_t b = 0; b < num_bands; ++b) {
+        const float* x = spectrum + first_bins[b];
+        const float* w = weights + offsets[b];
+        const size_t n = offsets[b + 1] - offsets[b];
+        float32x4_t sum4 = vdupq_n_f32(0.0f);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            sum4 = vmlaq_f32(sum4, vld1q_f32(w + i), vabsq_f32(vld1q_f32(x + i)));
+        }
+        float sum = vaddvq_f32(sum4);
+        for (; i < n; ++i) {
+            sum += w[i] * std::abs(x[i]);
+        }
+        out[b] = sum;
+    }
+}
+
+#endif
+
+using Kernel = SampleStats (*)(const int16_t*, size_t, size_t, const float*, float* const*, SampleStats*);
+using BandKernel = void (*)(const float*, const uint32_t*, const uint32_t*, const float*, size_t, float*);
+using GatherKernel = void (*)(const float*, const int32_t*, const float*, size_t, size_t, float*);
+
+struct Dispatch {
+    Kernel kernel;
+    BandKernel band_sums;
+    // no gather instructions before AVX2
+    GatherKernel gather_sums;
+    const char* name;
+};
+
+// Every set of kernels the CPU can run, widest first and scalar last
+static const std::vector<Dispatch>& available() {
+    static const std::vector<Dispatch> all = []() {
+        std::vector<Dispatch> all;
+#if PIOD_SIMD_X86
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            all.push_back({avx2_kernel, avx2_band_sums, avx2_gather_sums, "avx2"});
+        }
+        all.push_back({sse2_kernel, sse2_band_sums, gather_sums_scalar, "sse2"});
+#elif PIOD_SIMD_NEON
+        all.push_back({neon_kernel, neon_band_sums, gather_sums_scalar, "neon"});
+#endif
+        all.push_back({deinterleave_window_scalar, band_sums_scalar, gather_sums_scalar, "scalar"});
+        return all;
+    }();
+    return all;
+}
+
+static const Dispatch& dispatch() {
+    return available().front();
+}
+
+SampleStats deinterleave_window(const int16_t* in, size_t frames, size_t num_channels, const float* window,
+        float* const* out, SampleStats* channel_stats) {
+    // The vector paths cover mono and stereo, the usual capture layouts
+    if (num_channels == 1 || num_channels == 2) {
+        return dispatch().kernel(in, frames, num_channels, window, out, channel_stats);
+    }
+    return deinterleave_window_scalar(in, frames, num_channels, window, out, channel_stats);
+}
+
+void band_sums(const float* spectrum, const uint32_t* first_bins, const uint32_t* offsets,
+        const float* weights, size_t num_bands, float* out) {
+    dispatch().band_sums(spectrum, first_bins, offsets, weights, num_bands, out);
+}
+
+void gather_sums(const float* in, const int32_t* indices, const float* weights, size_t taps, size_t n, float* out) {
+    dispatch().gather_sums(in, indices, weights, taps, n, out);
+}
+
+const char* simd_name() {
+    return dispatch().name;
+}
+
+std::vector<const char*> simd_names() {
+    std::vector<const char*> names;
+    for (auto& d : available()) {
+        names.push_back(d.name);
+    }
+    return names;
+}
+
+SampleStats deinterleave_window_with(const char* simd, const int16_t* in, size_t frames, size_t num_channels,
+        const float* window, float* const* out, SampleStats* channel_stats) {
+    if (num_channels == 1 || num_channels == 2) {
+        for (auto& d : available()) {
+            if (std::strcmp(d.name, simd) == 0) {
+                return d.kernel(in, frames, num_channels, window, out, channel_stats);
+            }
+        }
+    }
+    return deinterleave_window_scalar(in, frames, num_channels, window, out, channel_stats);
+}
+
+}
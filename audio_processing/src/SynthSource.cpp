@@ -0,0 +1,106 @@
+#include <SynthSource.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <type_traits>
+
+SynthSource::SynthSource(const std::map<std::string, std::string>& params) {
+    // numbers from 0 up; a bad one is reported by open()
+    auto number = [this](const std::string& key, const std::string& text, auto& out) {
+        double value = 0;
+        if (parse_number(text, value) != 0 || value < 0) {
+            if (m_param_error.empty()) {
+                m_param_error = key + "=" + text + " is not a number from 0 up";
+            }
+            return;
+        }
+        out = static_cast<std::remove_reference_t<decltype(out)> >(value);
+    };
+    for (const auto& [key, value] : params) {
+        if (key == "sine") {
+            size_t pos = 0;
+            while (pos < value.size()) {
+                auto comma = value.find(',', pos);
+                float frequency = 0.0f;
+                number(key, value.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos), frequency);
+                m_frequencies.push_back(frequency);
+                if (comma == std::string::npos) break;
+                pos = comma + 1;
+            }
+        } else if (key == "noise") {
+            number(key, value, m_noise);
+        } else if (key == "click") {
+            number(key, value, m_click_bpm);
+        } else if (key == "amp") {
+            number(key, value, m_amplitude);
+        } else if (key == "pace") {
+            m_realtime = value != "fast";
+        } else if (key == "seconds") {
+            number(key, value, m_seconds);
+        } else {
+            spdlog::warn("Unknown synth parameter: {}", key);
+        }
+    }
+    if (m_frequencies.empty() && m_noise == 0.0f && m_click_bpm == 0.0f) {
+        m_frequencies.push_back(440.0f);
+    }
+}
+
+int SynthSource::open(AudioFormat& format) {
+    if (!m_param_error.empty()) {
+        spdlog::error("Synth source: {}", m_param_error);
+        return -1;
+    }
+    m_sample_rate = format.sample_rate;
+    m_num_channels = format.num_channels;
+    m_phases.assign(m_frequencies.size(), 0.0);
+    m_clock.reset(m_sample_rate, m_realtime);
+    spdlog::info("Synth source opened: rate={} Hz, channels={}, {} sines, noise {}, click {} BPM, {}",
+        m_sample_rate, m_num_channels, m_frequencies.size(), m_noise, m_click_bpm, m_realtime ? "realtime" : "as fast as possible");
+    return 0;
+}
+
+float SynthSource::next_noise() {
+    // xorshift64*, uniform in [-1, 1)
+    m_noise_state ^= m_noise_state >> 12;
+    m_noise_state ^= m_noise_state << 25;
+    m_noise_state ^= m_noise_state >> 27;
+    uint64_t r = m_noise_state * 0x2545F4914F6CDD1Dull;
+    return static_cast<float>(r >> 40) / static_cast<float>(1 << 23) - 1.0f;
+}
+
+int SynthSource::read(int16_t* buffer, size_t frames, tp& timestamp, uint64_t& frame_num) {
+    uint64_t position = m_clock.position();
+    if (m_seconds > 0 && position >= m_seconds * m_sample_rate) {
+        return END_OF_STREAM;
+    }
+    const float sine_gain = m_frequencies.empty() ? 0.0f : 1.0f / m_frequencies.size();
+    const uint64_t click_period = m_click_bpm > 0 ? static_cast<uint64_t>(m_sample_rate * 60.0f / m_click_bpm) : 0;
+    const uint64_t click_length = m_sample_rate / 200; // 5 ms
+    for (size_t i = 0; i < frames; ++i) {
+        float value = 0.0f;
+        for (size_t s = 0; s < m_frequencies.size(); ++s) {
+            value += sine_gain * static_cast<float>(std::sin(m_phases[s]));
+            m_phases[s] += 2.0 * std::numbers::pi * m_frequencies[s] / m_sample_rate;
+            if (m_phases[s] > 2.0 * std::numbers::pi) m_phases[s] -= 2.0 * std::numbers::pi;
+        }
+        if (m_noise > 0.0f) {
+            value += m_noise * next_noise();
+        }
+        if (click_period > 0) {
+            uint64_t in_click = (position + i) % click_period;
+            if (in_click < click_length) {
+                value += (1.0f - static_cast<float>(in_click) / click_length) * next_noise();
+            }
+        }
+        auto sample = static_cast<int16_t>(std::clamp(value * m_amplitude, -1.0f, 1.0f) * 32767.0f);
+        for (uint32_t c = 0; c < m_num_channels; ++c) {
+            buffer[i * m_num_channels + c] = sample;
+        }
+    }
+    frame_num = position;
+    timestamp = m_clock.advance(frames);
+    return frames;
+}
@@ -1,4 +1,6 @@
 #include <audio_processing.h>
+#include <FftPlan.h>
+#include <Resampler.h>
 
 #include <alsa/asoundlib.h>
 #include "spdlog/spdlog.h"
@@ -111,36 +113,28 @@ int audio_processing::fft(std::vector<float>& input, std::vector<float>& output)
     }
     output.resize(N);
 
-    // Create FFTW plan
-    fftwf_plan plan = fftwf_plan_r2r_1d(N, input.data(), output.data(), FFTW_REDFT10, FFTW_ESTIMATE);
+    // Plans are cached for the life of the process, planning costs more than the transform
+    fftwf_plan plan = FftPlanCache::instance().get(N, FftKind::Dct2, FftPlanCache::alignment_of(input.data(), output.data()));
     if (!plan) {
         spdlog::error("Failed to create FFTW plan.");
         return -1;
     }
 
     // Execute the FFT
-    fftwf_execute(plan);
-
-    // Destroy the plan
-    fftwf_destroy_plan(plan);
+    fftwf_execute_r2r(plan, input.data(), output.data());
 
     spdlog::debug("FFT computation completed.");
     return 0;
 }
 
 void audio_processing::resample(const std::vector<float>& input, std::vector<float>& output) {
-    auto ratio = static_cast<float>(input.size()) / static_cast<float>(output.size());
-    for (size_t i = 0; i < output.size(); ++i) {
-        // linearly interpolate
-        auto in_i = ratio * (ratio > 1.f ? i + 0.5f : i - 0.5f);
-        auto before_ratio = in_i - std::floor(in_i);
-        auto after_ratio = 1.0f - before_ratio;
-        if (ratio < 1) {
-            after_ratio = before_ratio;
-            before_ratio = 1.0f - after_ratio;
-        }
-        
-        output[i] = input[std::max(static_cast<size_t>(std::floor(in_i)), 0UL)] * before_ratio
-                  + input[std::min(static_cast<size_t>(std::ceil(in_i)), input.size() - 1)] * after_ratio;
+    if (input.empty() || output.empty()) {
+        return;
     }
-}
\ No newline at end of file
+    // One table per thread, rebuilt only when the sizes change
+    thread_local Resampler resampler;
+    if (resampler.input_size() != input.size() || resampler.output_size() != output.size()) {
+        resampler.reset(input.size(), output.size(), ResampleMode::Linear);
+    }
+    resampler.process(input.data(), output.data());
+}
@@ -0,0 +1,66 @@
+#include <Bench.h>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstdio>
+
+bool Bench::expect_at_most(const std::string& name, double value, double limit) {
+    m_checks.push_back(BenchCheck{name, value, limit, "<=", value <= limit});
+    if (!m_checks.back().passed) {
+        std::fprintf(stderr, "FAILED %s: %g, expected at most %g\n", name.c_str(), value, limit);
+    }
+    return m_checks.back().passed;
+}
+
+bool Bench::expect_at_least(const std::string& name, double value, double limit) {
+    m_checks.push_back(BenchCheck{name, value, limit, ">=", value >= limit});
+    if (!m_checks.back().passed) {
+        std::fprintf(stderr, "FAILED %s: %g, expected at least %g\n", name.c_str(), value, limit);
+    }
+    return m_checks.back().passed;
+}
+
+bool Bench::failed() const {
+    return std::any_of(m_checks.begin(), m_checks.end(), [](const BenchCheck& check) { return !check.passed; });
+}
+
+void Bench::print(std::ostream& out) const {
+    out << fmt::format("{:<40} {:>8} {:>12} {:>14} {:>12}\n", "name", "size", "iterations", "ns/iter", "ns/item");
+    for (const auto& result : m_results) {
+        out << fmt::format("{:<40} {:>8} {:>12} {:>14.1f} {:>12.3f}\n", result.name, result.size, result.iterations,
+            result.ns_per_iter, result.items ? result.ns_per_iter / result.items : 0.0);
+    }
+    if (m_checks.empty()) {
+        return;
+    }
+    out << fmt::format("\n{:<56} {:>14} {:>4} {:>14} {:>6}\n", "check", "value", "", "limit", "");
+    for (const auto& check : m_checks) {
+        out << fmt::format("{:<56} {:>14.4f} {:>4} {:>14.4f} {:>6}\n", check.name, check.value, check.comparison,
+            check.limit, check.passed ? "ok" : "FAILED");
+    }
+}
+
+void Bench::write_json(std::ostream& out) const {
+    out << "{\n";
+    out << fmt::format("  \"version\": \"{}\",\n", PIOD_VERSION);
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < m_results.size(); ++i) {
+        const auto& result = m_results[i];
+        // names are plain ascii identifiers, no escaping needed
+        out << fmt::format("    {{\"name\": \"{}\", \"size\": {}, \"items\": {}, \"iterations\": {}, \"ns_per_iter\": {:.3f}, \"ns_per_item\": {:.6f}}}{}\n",
+            result.name, result.size, result.items, result.iterations, result.ns_per_iter,
+            result.items ? result.ns_per_iter / result.items : 0.0,
+            i + 1 < m_results.size() ? "," : "");
+    }
+    out << "  ],\n";
+    out << "  \"checks\": [\n";
+    for (size_t i = 0; i < m_checks.size(); ++i) {
+        const auto& check = m_checks[i];
+        out << fmt::format("    {{\"name\": \"{}\", \"value\": {:.6f}, \"comparison\": \"{}\", \"limit\": {:.6f}, \"passed\": {}}}{}\n",
+            check.name, check.value, check.comparison, check.limit, check.passed ? "true" : "false",
+            i + 1 < m_checks.size() ? "," : "");
+    }
+    out << "  ]\n";
+    out << "}\n";
+}
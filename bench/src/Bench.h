@@ -0,0 +1,113 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct BenchResult {
+    std::string name;
+    size_t size = 0;
+    // samples, pixels, bytes... handled by one iteration
+    size_t items = 0;
+    size_t iterations = 0;
+    double ns_per_iter = 0;
+};
+
+// A pass/fail measurement (accuracy, a budget) rather than a timing
+struct BenchCheck {
+    std::string name;
+    double value = 0;
+    double limit = 0;
+    // "<=" or ">="
+    const char* comparison = "<=";
+    bool passed = false;
+};
+
+// Realistic capture period / FFT lengths and LED grid edge lengths
+inline constexpr size_t SAMPLE_SIZES[] = {256, 512, 1024, 2048, 4096, 8192};
+inline constexpr size_t GRID_SIZES[] = {16, 32, 64, 128};
+
+// Keeps the compiler from discarding a benchmarked result
+template <typename T>
+inline void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class Bench {
+public:
+    using clock = std::chrono::steady_clock;
+
+    void set_filter(const std::string& filter) { m_filter = filter; }
+    void set_min_time(std::chrono::milliseconds min_time) { m_min_time = min_time; }
+    bool enabled(const std::string& name) const { return m_filter.empty() || name.find(m_filter) != std::string::npos; }
+
+    // Calls fn repeatedly for at least the minimum time and records the mean cost
+    // of one call, which it returns in ns (0 when filtered out)
+    template <typename F>
+    double run(const std::string& name, size_t size, F&& fn) {
+        return run(name, size, size, std::forward<F>(fn));
+    }
+
+    template <typename F>
+    double run(const std::string& name, size_t size, size_t items, F&& fn) {
+        if (!enabled(name)) {
+            return 0;
+        }
+        fn();
+        size_t iterations = 0;
+        size_t batch = 1;
+        auto start = clock::now();
+        auto elapsed = clock::duration::zero();
+        while (elapsed < m_min_time) {
+            for (size_t i = 0; i < batch; ++i) {
+                fn();
+            }
+            iterations += batch;
+            elapsed = clock::now() - start;
+            if (batch < (1u << 16)) {
+                batch *= 2;
+            }
+        }
+        add_result(name, size, items, iterations, std::chrono::duration<double, std::nano>(elapsed).count() / iterations);
+        return m_results.back().ns_per_iter;
+    }
+
+    // For benchmarks that measure themselves (e.g. a whole running pipeline)
+    void add_result(const std::string& name, size_t size, size_t items, size_t iterations, double ns_per_iter) {
+        m_results.push_back(BenchResult{name, size, items, iterations, ns_per_iter});
+    }
+
+    // Records a check, reported with the results; any failure makes the run fail
+    bool expect_at_most(const std::string& name, double value, double limit);
+    bool expect_at_least(const std::string& name, double value, double limit);
+    bool failed() const;
+
+    std::chrono::milliseconds min_time() const { return m_min_time; }
+    const std::vector<BenchResult>& results() const { return m_results; }
+    const std::vector<BenchCheck>& checks() const { return m_checks; }
+    void print(std::ostream& out) const;
+    void write_json(std::ostream& out) const;
+
+private:
+    std::string m_filter;
+    std::chrono::milliseconds m_min_time{200};
+    std::vector<BenchResult> m_results;
+    std::vector<BenchCheck> m_checks;
+};
+
+void fft_benches(Bench& bench);
+void resample_benches(Bench& bench);
+void sample_benches(Bench& bench);
+void process_benches(Bench& bench);
+void beat_benches(Bench& bench);
+void pipeline_benches(Bench& bench);
+// file.wav@bpm[,file.wav@bpm...] for beat_benches
+void set_beat_wav_files(const std::string& list);
+void grid_benches(Bench& bench);
+void color_benches(Bench& bench);
+void usb_benches(Bench& bench);
+void metrics_benches(Bench& bench);
+void trace_benches(Bench& bench);
@@ -0,0 +1,183 @@
+#include <Bench.h>
+#include <AudioProcess.h>
+#include <BeatTracker.h>
+#include <FileSource.h>
+#include <SynthSource.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static std::vector<std::pair<std::string, double> > s_wav_files;
+
+// Beats are only scored once the tracker has had time to settle
+static const double SCORE_AFTER_SECONDS = 5.0;
+static const double BEAT_TOLERANCE_SECONDS = 0.07;
+// What the synth click tracks must reach for the run to pass
+static const double MIN_F_MEASURE = 0.8;
+static const double MAX_BPM_ERROR_PERCENT = 3.0;
+// Steady state tracker cost, as a share of one 1024 sample period
+static const double MAX_FRAME_BUDGET_PERCENT = 5.0;
+
+struct BeatScore {
+    double bpm = 0;
+    double f_measure = 0;
+    size_t beats = 0;
+    size_t frames = 0;
+    double ns_per_frame = 0;
+};
+
+void set_beat_wav_files(const std::string& list) {
+    // file.wav@bpm[,file.wav@bpm...]
+    size_t start = 0;
+    while (start < list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        std::string item = list.substr(start, end - start);
+        size_t at = item.rfind('@');
+        if (at == std::string::npos) {
+            s_wav_files.emplace_back(item, 0.0);
+        } else {
+            s_wav_files.emplace_back(item.substr(0, at), std::stod(item.substr(at + 1)));
+        }
+        start = end + 1;
+    }
+}
+
+// Runs a source through AudioProcess period by period and collects the beats it reports
+static BeatScore track_source(AudioSource& source, size_t period, double truth_bpm, double seconds) {
+    BeatScore score;
+    AudioFormat format{44100, 1, static_cast<uint32_t>(period)};
+    if (source.open(format) < 0) {
+        return score;
+    }
+    AudioProcess process;
+    process.set_num_channels(format.num_channels);
+    process.set_sample_rate(format.sample_rate);
+    process.set_samples_per_frame(static_cast<uint32_t>(period));
+    process.set_history_size(50);
+    std::vector<double> beats;
+    process.add_process_callback("bench", [&beats, &format, period](const AudioProcess* p) {
+        if (p->m_beat_detected) {
+            beats.push_back((p->m_cur_frame + period / 2.0) / format.sample_rate);
+        }
+    });
+
+    std::vector<int16_t> samples(period * format.num_channels);
+    AudioSource::tp timestamp;
+    uint64_t frame_num = 0;
+    double processing_ns = 0;
+    const size_t max_frames = static_cast<size_t>(seconds * format.sample_rate / period);
+    while (score.frames < max_frames && source.read(samples.data(), period, timestamp, frame_num) > 0) {
+        auto start = Bench::clock::now();
+        process.process(samples, timestamp, frame_num);
+        processing_ns += std::chrono::duration<double, std::nano>(Bench::clock::now() - start).count();
+        score.frames++;
+    }
+    source.close();
+    score.bpm = process.m_bpm;
+    score.ns_per_frame = score.frames ? processing_ns / score.frames : 0.0;
+
+    std::vector<double> scored;
+    for (double t : beats) {
+        if (t >= SCORE_AFTER_SECONDS) {
+            scored.push_back(t);
+        }
+    }
+    score.beats = scored.size();
+    if (truth_bpm <= 0) {
+        return score;
+    }
+    // Ground truth matches SynthSource: a click every whole number of samples per beat
+    const double beat_period = std::floor(format.sample_rate * 60.0 / truth_bpm) / format.sample_rate;
+    const double end = static_cast<double>(score.frames * period) / format.sample_rate;
+    std::vector<double> truth;
+    for (double t = std::ceil(SCORE_AFTER_SECONDS / beat_period) * beat_period; t < end; t += beat_period) {
+        truth.push_back(t);
+    }
+    size_t hits = 0;
+    size_t next = 0;
+    for (double t : truth) {
+        while (next < scored.size() && scored[next] < t - BEAT_TOLERANCE_SECONDS) {
+            next++;
+        }
+        if (next < scored.size() && scored[next] <= t + BEAT_TOLERANCE_SECONDS) {
+            hits++;
+            next++;
+        }
+    }
+    double precision = scored.empty() ? 0.0 : static_cast<double>(hits) / scored.size();
+    double recall = truth.empty() ? 0.0 : static_cast<double>(hits) / truth.size();
+    score.f_measure = precision + recall > 0 ? 2.0 * precision * recall / (precision + recall) : 0.0;
+    return score;
+}
+
+static double bpm_error_percent(double truth_bpm, const BeatScore& score) {
+    return truth_bpm > 0 ? 100.0 * std::abs(score.bpm - truth_bpm) / truth_bpm : 0.0;
+}
+
+static void report(const std::string& name, double truth_bpm, const BeatScore& score) {
+    const double error = bpm_error_percent(truth_bpm, score);
+    std::fprintf(stderr, "%-24s truth %6.1f BPM  tracked %6.1f BPM (%5.2f%%)  F %.3f  %zu beats  %.1f us/frame\n",
+        name.c_str(), truth_bpm, score.bpm, error, score.f_measure, score.beats, score.ns_per_frame / 1000.0);
+}
+
+void beat_benches(Bench& bench) {
+    // Cost of the tracker alone for one frame of bands, against a 1024 sample period (23.2 ms)
+    for (size_t bands : {64, 512}) {
+        if (!bench.enabled("beat/track_frame")) {
+            break;
+        }
+        audio_processing::BeatTracker tracker;
+        tracker.reset(44100.0 / 1024);
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> dist(0.0f, 1000.0f);
+        std::vector<std::vector<float> > frames(64, std::vector<float>(bands));
+        for (auto& frame : frames) {
+            std::generate(frame.begin(), frame.end(), [&]() { return dist(rng); });
+        }
+        size_t i = 0;
+        bench.run("beat/track_frame", bands, [&]() {
+            do_not_optimize(tracker.process(frames[i++ % frames.size()].data(), bands));
+        });
+        const double period_ns = 1e9 * 1024 / 44100.0;
+        bench.expect_at_most("beat/track_frame_budget_pct_" + std::to_string(bands),
+            100.0 * bench.results().back().ns_per_iter / period_ns, MAX_FRAME_BUDGET_PERCENT);
+    }
+
+    // Tempo and beat accuracy over click tracks with a tonal and noise bed
+    if (bench.enabled("beat/accuracy")) {
+        for (double bpm : {90.0, 120.0, 140.0}) {
+            SynthSource synth({{"sine", "55,440,2500"}, {"noise", "0.05"}, {"click", std::to_string(bpm)}, {"pace", "fast"}});
+            BeatScore score = track_source(synth, 1024, bpm, 30.0);
+            const std::string name = "synth_click_" + std::to_string(static_cast<int>(bpm));
+            report(name, bpm, score);
+            bench.add_result("beat/accuracy_synth", static_cast<size_t>(bpm), 1024, score.frames, score.ns_per_frame);
+            bench.expect_at_least("beat/f_measure_" + name, score.f_measure, MIN_F_MEASURE);
+            bench.expect_at_most("beat/bpm_error_pct_" + name, bpm_error_percent(bpm, score), MAX_BPM_ERROR_PERCENT);
+        }
+    }
+
+    // WAV files given with --beat-wav, scored on tempo only
+    for (const auto& [path, bpm] : s_wav_files) {
+        if (!bench.enabled("beat/wav")) {
+            break;
+        }
+        const std::string name = path.substr(path.find_last_of('/') + 1);
+        FileSource file(path, {{"pace", "fast"}});
+        BeatScore score = track_source(file, 1024, 0.0, 1e9);
+        if (score.frames == 0) {
+            std::fprintf(stderr, "Unable to read %s\n", path.c_str());
+            bench.expect_at_least("beat/wav_frames_" + name, 0, 1);
+            continue;
+        }
+        score.f_measure = 0;
+        report(path, bpm, score);
+        bench.add_result("beat/wav", static_cast<size_t>(bpm), 1024, score.frames, score.ns_per_frame);
+        bench.expect_at_most("beat/bpm_error_pct_" + name, bpm_error_percent(bpm, score), MAX_BPM_ERROR_PERCENT);
+    }
+}
@@ -0,0 +1,42 @@
+#include <Bench.h>
+#include <audio_processing.h>
+#include <FftPlan.h>
+
+#include "fftw3.h"
+
+#include <cmath>
+#include <vector>
+
+static void fill_signal(float* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = std::sin(i * 0.05f) * 1000.0f + std::sin(i * 0.31f) * 250.0f;
+    }
+}
+
+void fft_benches(Bench& bench) {
+    for (auto size : SAMPLE_SIZES) {
+        std::vector<float> input(size);
+        std::vector<float> output(size);
+        fill_signal(input.data(), size);
+
+        // What audio_processing::fft used to do every frame
+        bench.run("fft/plan_per_frame", size, [&]() {
+            fftwf_plan plan = fftwf_plan_r2r_1d(size, input.data(), output.data(), FFTW_REDFT10, FFTW_ESTIMATE);
+            fftwf_execute(plan);
+            fftwf_destroy_plan(plan);
+            do_not_optimize(output[0]);
+        });
+
+        bench.run("fft/audio_processing::fft", size, [&]() {
+            audio_processing::fft(input, output);
+            do_not_optimize(output[0]);
+        });
+
+        audio_processing::FftPlan plan(size);
+        fill_signal(plan.input(), size);
+        bench.run("fft/cached_plan", size, [&]() {
+            plan.execute();
+            do_not_optimize(plan.output()[0]);
+        });
+    }
+}
@@ -0,0 +1,197 @@
+#include <Bench.h>
+#include <GridData.h>
+#include <ColorLut.h>
+#include <Rgb.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Fills every pixel of a grid with the given layout through set()
+template <typename Layout>
+static void layout_bench(Bench& bench, const std::string& name, size_t size,
+        const std::vector<uint32_t>& table = {}) {
+    BasicGridData<Layout> grid(size, size);
+    if constexpr (std::is_same_v<Layout, layout::Lookup>) {
+        grid.layout().set_table(table);
+    }
+    bench.run("grid/layout_" + name, size, size * size, [&]() {
+        for (size_t y = 0; y < size; ++y) {
+            for (size_t x = 0; x < size; ++x) {
+                grid.set(x, y, x, y, x ^ y);
+            }
+        }
+        do_not_optimize(grid.vector()[1]);
+    });
+}
+
+void grid_benches(Bench& bench) {
+    for (auto size : GRID_SIZES) {
+        GridData grid(size, size);
+        bench.run("grid/set", size, size * size, [&]() {
+            for (size_t y = 0; y < size; ++y) {
+                for (size_t x = 0; x < size; ++x) {
+                    grid.set(x, y, x, y, x ^ y);
+                }
+            }
+            do_not_optimize(grid.vector()[1]);
+        });
+        bench.run("grid/get_raw", size, size * size, [&]() {
+            unsigned sum = 0;
+            for (size_t y = 0; y < size; ++y) {
+                for (size_t x = 0; x < size; ++x) {
+                    sum += *grid.get_raw(x, y);
+                }
+            }
+            do_not_optimize(sum);
+        });
+    }
+
+    // Writing a frame straight into wire order, per layout, against filling a
+    // row-major frame and remapping it to serpentine afterwards
+    for (auto size : GRID_SIZES) {
+        std::vector<uint32_t> table(size * size);
+        layout::Serpentine serpentine;
+        serpentine.resize(size, size);
+        for (size_t y = 0; y < size; ++y) {
+            for (size_t x = 0; x < size; ++x) {
+                table[y * size + x] = static_cast<uint32_t>(serpentine.index(x, y));
+            }
+        }
+        layout_bench<layout::RowMajor>(bench, "row_major", size);
+        layout_bench<layout::Serpentine>(bench, "serpentine", size);
+        layout_bench<layout::ColumnSerpentine>(bench, "column_serpentine", size);
+        layout_bench<layout::Tiled<8, 8, layout::Serpentine> >(bench, "tiled_8x8", size);
+        layout_bench<layout::Lookup>(bench, "lookup", size, table);
+
+        GridData grid(size, size);
+        std::vector<uint8_t> wire(grid.vector().size());
+        bench.run("grid/layout_remap_copy", size, size * size, [&]() {
+            for (size_t y = 0; y < size; ++y) {
+                for (size_t x = 0; x < size; ++x) {
+                    grid.set(x, y, x, y, x ^ y);
+                }
+            }
+            const auto& frame = grid.vector();
+            wire[0] = frame[0];
+            for (size_t i = 0; i < table.size(); ++i) {
+                std::memcpy(&wire[1 + table[i] * 3], &frame[1 + i * 3], 3);
+            }
+            do_not_optimize(wire[1]);
+        });
+    }
+
+    // One animation frame (step + rasterise) of N drifting, fading
+    // components; dead ones are respawned so N stays steady. items = components
+    for (size_t size : {16, 128}) {
+        for (size_t count : {1000, 10000}) {
+            GridData grid(size, size);
+            ComponentEngine& engine = grid.components();
+            engine.reserve(count);
+            std::mt19937 rng(1);
+            std::uniform_int_distribution<size_t> position(0, size - 1);
+            std::uniform_int_distribution<size_t> extent(1, 4);
+            std::uniform_real_distribution<float> velocity(-20.0f, 20.0f);
+            std::uniform_real_distribution<float> hue(0.0f, 360.0f);
+            auto spawn = [&]() {
+                GridComponent component;
+                component.top_left_high = {position(rng), position(rng), 0};
+                component.size = {extent(rng), extent(rng), 1};
+                component.position_velocity = {velocity(rng), velocity(rng), 0};
+                component.rgb_velocity = {-100.0f, -100.0f, -100.0f};
+                component.visible = true;
+                component.set_hsv(Point<float>{hue(rng), 100.0f, 100.0f});
+                engine.add(component);
+            };
+            bench.run("grid/components_" + std::to_string(count), size, count, [&]() {
+                while (engine.size() < count) {
+                    spawn();
+                }
+                grid.compile(1.0f / 60.0f);
+                do_not_optimize(grid.vector()[1]);
+            });
+        }
+    }
+}
+
+void color_benches(Bench& bench) {
+    for (auto size : GRID_SIZES) {
+        const size_t count = size * size;
+        std::vector<float> hues(count);
+        for (size_t i = 0; i < count; ++i) {
+            hues[i] = 360.0f * i / count;
+        }
+        std::vector<Rgb> out(count);
+        bench.run("color/HSVtoRGB", size, count, [&]() {
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = HSVtoRGB(hues[i], 100.0f, 75.0f);
+            }
+            do_not_optimize(out[0]);
+        });
+        bench.run("color/hsv_lut", size, count, [&]() {
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = color::hsv_to_rgb(hues[i], 100.0f, 75.0f);
+            }
+            do_not_optimize(out[0]);
+        });
+        // The whole grid a row at a time through the batch conversion
+        GridData grid(size, size);
+        const float saturation = 100.0f;
+        const float value = 75.0f;
+        bench.run("color/hsv_row", size, count, [&]() {
+            for (size_t y = 0; y < size; ++y) {
+                grid.set_hsv_row(y, std::span<const float>(hues).subspan(y * size, size), {&saturation, 1}, {&value, 1});
+            }
+            do_not_optimize(grid.vector()[1]);
+        });
+    }
+
+    // Largest and mean per channel difference between the LUT and HSVtoRGB
+    // over a sweep of hue, saturation and value
+    if (bench.enabled("color/hsv_accuracy")) {
+        std::vector<float> hues;
+        for (float hue = 0.0f; hue < 360.0f; hue += 0.05f) {
+            hues.push_back(hue);
+        }
+        std::vector<uint8_t> batch(hues.size() * 3);
+        int max_error = 0;
+        double total_error = 0;
+        size_t channels = 0;
+        size_t mismatches = 0;
+        auto start = Bench::clock::now();
+        for (float saturation = 0.0f; saturation <= 100.0f; saturation += 2.5f) {
+            for (float value = 0.0f; value <= 100.0f; value += 2.5f) {
+                color::hsv_to_rgb(hues, {&saturation, 1}, {&value, 1}, batch.data());
+                for (size_t i = 0; i < hues.size(); ++i) {
+                    const Rgb reference = HSVtoRGB(hues[i], saturation, value);
+                    const Rgb lut = color::hsv_to_rgb(hues[i], saturation, value);
+                    const uint8_t rgb[3] = {lut.r, lut.g, lut.b};
+                    const int diff[] = {lut.r - reference.r, lut.g - reference.g, lut.b - reference.b};
+                    for (size_t c = 0; c < 3; ++c) {
+                        if (batch[i * 3 + c] != rgb[c]) {
+                            if (mismatches++ == 0) {
+                                std::fprintf(stderr, "hsv batch differs from scalar at %.2f %.1f %.1f\n", hues[i], saturation, value);
+                            }
+                        }
+                        max_error = std::max(max_error, std::abs(diff[c]));
+                        total_error += std::abs(diff[c]);
+                        channels++;
+                    }
+                }
+            }
+        }
+        auto elapsed = std::chrono::duration<double, std::nano>(Bench::clock::now() - start).count();
+        std::fprintf(stderr, "hsv lut vs HSVtoRGB: max error %d, mean error %.3f over %zu channels\n",
+            max_error, total_error / channels, channels);
+        bench.add_result("color/hsv_accuracy", 0, channels, 1, elapsed);
+        // the LUT may be off by a couple of levels; the batch path must match it exactly
+        bench.expect_at_most("color/hsv_max_error", max_error, 2);
+        bench.expect_at_most("color/hsv_batch_mismatches", static_cast<double>(mismatches), 0);
+    }
+}
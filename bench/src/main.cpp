@@ -0,0 +1,60 @@
+#include <Bench.h>
+#include <ArgParse.h>
+#include <FftPlan.h>
+#include "spdlog/spdlog.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+int main(int argc, char* argv[]) {
+    spdlog::set_level(spdlog::level::warn);
+    Bench bench;
+    std::string json_file;
+    ArgParse parser;
+    parser.on("filter", [&bench](const std::string& value) {
+        bench.set_filter(value);
+    }, false, "Only run benchmarks whose name contains this string");
+    parser.on("min-time-ms", [&bench](const std::string& value) {
+        bench.set_min_time(std::chrono::milliseconds(std::stoi(value)));
+    }, false, "Minimum time spent in each benchmark (default 200)");
+    parser.on("json", [&json_file](const std::string& value) {
+        json_file = value;
+    }, false, "Also write the results as JSON to this file (- for stdout)");
+    parser.on("fft-wisdom", [](const std::string& value) {
+        audio_processing::FftPlanCache::instance().set_wisdom_file(value);
+    }, false, "FFTW wisdom file to load and update");
+    parser.on("beat-wav", [](const std::string& value) {
+        set_beat_wav_files(value);
+    }, false, "WAV files to score beat tracking on, as file.wav@bpm,...");
+    parser.parse(argc, argv);
+
+    fft_benches(bench);
+    resample_benches(bench);
+    sample_benches(bench);
+    process_benches(bench);
+    beat_benches(bench);
+    pipeline_benches(bench);
+    grid_benches(bench);
+    color_benches(bench);
+    usb_benches(bench);
+    metrics_benches(bench);
+    trace_benches(bench);
+
+    // a failed accuracy or budget check fails the run, after the results are written
+    const int rc = bench.failed() ? 1 : 0;
+    if (json_file == "-") {
+        bench.write_json(std::cout);
+        return rc;
+    }
+    bench.print(std::cout);
+    if (!json_file.empty()) {
+        std::ofstream out(json_file);
+        if (!out) {
+            std::cerr << "Unable to write " << json_file << std::endl;
+            return 1;
+        }
+        bench.write_json(out);
+    }
+    return rc;
+}
@@ -0,0 +1,68 @@
+#include <Bench.h>
+#include <Metrics.h>
+
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+void metrics_benches(Bench& bench) {
+    auto& metrics = Metrics::instance();
+
+    // The cost a stage pays per recorded event; a few atomic adds, so well
+    // under the 100 ns budget even on the Pi
+    auto& counter = metrics.counter("bench.counter");
+    if (double ns = bench.run("metrics/counter_add", 1, [&]() { counter.add(); })) {
+        bench.expect_at_most("metrics/counter_add_ns", ns, 100);
+    }
+
+    auto& histogram = metrics.histogram("bench.histogram");
+    uint64_t value = 1;
+    double ns = bench.run("metrics/histogram_record", 1, [&]() {
+        // spread over the buckets like real latencies
+        value = value * 6364136223846793005ull + 1442695040888963407ull;
+        histogram.record(value >> 40);
+    });
+    if (ns) {
+        bench.expect_at_most("metrics/histogram_record_ns", ns, 100);
+    }
+
+    // Two clock reads and a record, what Metrics::Timer adds around a stage
+    auto& timed = metrics.histogram("bench.timer");
+    if (double ns = bench.run("metrics/timer", 1, [&]() { Metrics::Timer timer(timed); })) {
+        bench.expect_at_most("metrics/timer_ns", ns, 500);
+    }
+
+    // The same histogram recorded from two more threads, each on its own shard
+    if (bench.enabled("metrics/histogram_record_contended")) {
+        auto& shared = metrics.histogram("bench.contended");
+        std::atomic<bool> stop{false};
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 2; ++i) {
+            threads.emplace_back([&shared, &stop, i]() {
+                uint64_t v = i;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    shared.record(v++ & 0xffff);
+                }
+            });
+        }
+        bench.run("metrics/histogram_record_contended", 1, [&]() {
+            shared.record(value++ & 0xffff);
+        });
+        stop = true;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    // Reading everything back, once per export
+    std::string out;
+    bench.run("metrics/write_json", 1, [&]() {
+        std::ostringstream stream;
+        metrics.write_json(stream);
+        out = stream.str();
+        do_not_optimize(out.size());
+    });
+}
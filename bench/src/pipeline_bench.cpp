@@ -0,0 +1,153 @@
+#include <Bench.h>
+#include <AudioPipeline.h>
+#include <SynthSource.h>
+#include <AudioDrawer.h>
+#include <MockUsbTransport.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Replays one synthesized period as fast as it is asked for, so the capture
+// threads cost next to nothing and the analysis is what gets measured
+class LoopSource : public AudioSource {
+public:
+    int open(AudioFormat& format) override {
+        SynthSource synth({{"sine", "55,440,2500"}, {"noise", "0.1"}, {"click", "120"}, {"pace", "fast"}});
+        if (synth.open(format) != 0) {
+            return -1;
+        }
+        m_num_channels = format.num_channels;
+        m_period.resize(static_cast<size_t>(format.frames_per_period) * format.num_channels);
+        AudioSource::tp timestamp;
+        uint64_t frame_num = 0;
+        synth.read(m_period.data(), format.frames_per_period, timestamp, frame_num);
+        m_position = 0;
+        return 0;
+    }
+
+    int read(int16_t* buffer, size_t frames, tp& timestamp, uint64_t& frame_num) override {
+        const size_t samples = std::min(frames * m_num_channels, m_period.size());
+        std::memcpy(buffer, m_period.data(), samples * sizeof(int16_t));
+        timestamp = std::chrono::high_resolution_clock::now();
+        frame_num = m_position;
+        m_position += frames;
+        // keep one core per source from spinning flat out once the ring is full
+        std::this_thread::yield();
+        return static_cast<int>(samples / m_num_channels);
+    }
+
+    void close() override {}
+    std::string name() const override { return "loop"; }
+
+private:
+    std::vector<int16_t> m_period;
+    uint32_t m_num_channels = 1;
+    uint64_t m_position = 0;
+};
+
+static const size_t PERIOD = 1024;
+
+static void configure(AudioProcess& process) {
+    process.set_num_channels(1);
+    process.set_samples_per_frame(PERIOD);
+    process.set_history_size(50);
+}
+
+void pipeline_benches(Bench& bench) {
+    const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<size_t> worker_counts;
+    for (size_t workers = 1; workers < cores; workers *= 2) {
+        worker_counts.push_back(workers);
+    }
+    worker_counts.push_back(cores);
+
+    // Periods analysed per second with N sources sharing a pool of W workers;
+    // size is the worker count, ns is per period across all sources
+    for (size_t sources : {1, 2, 4, 8}) {
+        const std::string name = "pipeline/sources_" + std::to_string(sources);
+        for (size_t workers : worker_counts) {
+            if (!bench.enabled(name)) {
+                break;
+            }
+            AudioPipeline pipeline(workers);
+            for (size_t i = 0; i < sources; ++i) {
+                configure(pipeline.add_source("loop" + std::to_string(i), std::make_unique<LoopSource>()));
+            }
+            auto start = Bench::clock::now();
+            if (pipeline.start() != 0) {
+                continue;
+            }
+            std::this_thread::sleep_for(bench.min_time());
+            pipeline.stop();
+            auto elapsed = std::chrono::duration<double, std::nano>(Bench::clock::now() - start).count();
+            size_t processed = 0;
+            for (const auto& stats : pipeline.stats()) {
+                processed += stats.processed;
+            }
+            bench.add_result(name, workers, PERIOD, processed, processed ? elapsed / processed : 0.0);
+        }
+    }
+
+    // The same sources each on their own processing thread, for comparison
+    for (size_t sources : {1, 2, 4, 8}) {
+        if (!bench.enabled("pipeline/thread_per_source")) {
+            break;
+        }
+        std::vector<std::unique_ptr<AudioProcess> > processes;
+        std::atomic<size_t> processed = 0;
+        for (size_t i = 0; i < sources; ++i) {
+            auto process = std::make_unique<AudioProcess>();
+            configure(*process);
+            process->set_source(std::make_unique<LoopSource>());
+            process->add_process_callback("bench", [&processed](const AudioProcess*) {
+                processed.fetch_add(1, std::memory_order_relaxed);
+            });
+            processes.push_back(std::move(process));
+        }
+        auto start = Bench::clock::now();
+        for (auto& process : processes) {
+            process->start();
+        }
+        std::this_thread::sleep_for(bench.min_time());
+        for (auto& process : processes) {
+            process->stop();
+        }
+        auto elapsed = std::chrono::duration<double, std::nano>(Bench::clock::now() - start).count();
+        size_t count = processed.load();
+        bench.add_result("pipeline/thread_per_source", sources, PERIOD, count, count ? elapsed / count : 0.0);
+    }
+
+    // Capture to USB completion through the whole app: a realtime synth source
+    // and a mock device taking 1 ms per transfer. One result per stage and
+    // quantile, ns is the latency and iterations the frames measured.
+    if (bench.enabled("pipeline/latency")) {
+        const double fps = 60.0;
+        AudioDrawer drawer;
+        drawer.set_source("synth:sine=440&click=120");
+        drawer.set_target_fps(fps);
+        auto transport = std::make_unique<MockUsbTransport>();
+        transport->set_latency(std::chrono::milliseconds(1));
+        if (drawer.set_transport(std::move(transport)) == 0) {
+            AudioDrawer::reset_latency();
+            drawer.start();
+            // enough periods for a p99 even with a short --min-time
+            std::this_thread::sleep_for(std::max<std::chrono::milliseconds>(bench.min_time(), std::chrono::seconds(2)));
+            drawer.stop();
+            for (const auto& stage : AudioDrawer::latency()) {
+                const auto& s = stage.snapshot;
+                const std::string name = std::string("pipeline/latency_") + stage.name;
+                bench.add_result(name + "_p50", 0, 1, s.count, static_cast<double>(s.quantile(0.5)));
+                bench.add_result(name + "_p99", 0, 1, s.count, static_cast<double>(s.quantile(0.99)));
+                bench.add_result(name + "_max", 0, 1, s.count, static_cast<double>(s.max));
+                if (std::string(stage.name) == "schedule") {
+                    // a new spectrum is drawn by the next render tick
+                    bench.expect_at_least(name + "_count", static_cast<double>(s.count), 1);
+                    bench.expect_at_most(name + "_p99_ns", static_cast<double>(s.quantile(0.99)), 1e9 / fps);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,137 @@
+#include <Bench.h>
+#include <AudioProcess.h>
+#include <SynthSource.h>
+#include <SpectrumHistory.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+static std::map<std::string, std::string> synth_params() {
+    return {{"sine", "55,440,2500"}, {"noise", "0.1"}, {"click", "120"}, {"pace", "fast"}};
+}
+
+void process_benches(Bench& bench) {
+    // Spectral history: writing a row, and a waterfall-style walk of every bin over time
+    for (size_t rows : {50, 200}) {
+        const size_t bins = 512;
+        SpectrumHistory history;
+        history.reset(rows, bins);
+        SpectrumHistory::tp timestamp;
+        float value = 0;
+        bench.run("history/push_512", rows, bins, [&]() {
+            float* row = history.push(timestamp, value);
+            std::fill(row, row + bins, value);
+            value += 1.0f;
+        });
+        bench.run("history/columns_512", rows, rows * bins, [&]() {
+            float sum = 0;
+            for (size_t bin = 0; bin < bins; ++bin) {
+                auto column = history.column(bin);
+                for (size_t age = 0; age < column.size(); ++age) {
+                    sum += column[age];
+                }
+            }
+            do_not_optimize(sum);
+        });
+        bench.run("history/rows_512", rows, rows * bins, [&]() {
+            float sum = 0;
+            for (size_t age = 0; age < history.size(); ++age) {
+                for (float v : history.row(age)) {
+                    sum += v;
+                }
+            }
+            do_not_optimize(sum);
+        });
+    }
+
+    for (auto size : SAMPLE_SIZES) {
+        SynthSource synth(synth_params());
+        AudioFormat format{44100, 1, static_cast<uint32_t>(size)};
+        synth.open(format);
+        std::vector<int16_t> samples(size);
+        AudioSource::tp timestamp;
+        uint64_t frame_num = 0;
+        synth.read(samples.data(), size, timestamp, frame_num);
+
+        AudioProcess process;
+        process.set_num_channels(1);
+        process.set_samples_per_frame(size);
+        process.set_history_size(50);
+        bench.run("process/period", size, [&]() {
+            process.process(samples, timestamp, frame_num);
+        });
+    }
+
+    // Stereo through one batched plan, as left/right and as mid/side
+    for (auto layout : {audio_processing::ChannelLayout::Separate, audio_processing::ChannelLayout::MidSide}) {
+        const std::string name = layout == audio_processing::ChannelLayout::MidSide ? "process/period_midside" : "process/period_stereo";
+        for (auto size : SAMPLE_SIZES) {
+            if (!bench.enabled(name)) {
+                break;
+            }
+            SynthSource synth(synth_params());
+            AudioFormat format{44100, 2, static_cast<uint32_t>(size)};
+            synth.open(format);
+            std::vector<int16_t> samples(size * 2);
+            AudioSource::tp timestamp;
+            uint64_t frame_num = 0;
+            synth.read(samples.data(), size, timestamp, frame_num);
+
+            AudioProcess process;
+            process.set_num_channels(2);
+            process.set_samples_per_frame(size);
+            process.set_channel_layout(layout);
+            process.set_history_size(50);
+            bench.run(name, size, [&]() {
+                process.process(samples, timestamp, frame_num);
+            });
+        }
+    }
+
+    // Sliding 2048 point STFT fed 1024 sample periods, one FFT per hop
+    for (size_t hop : {128, 256, 512, 1024}) {
+        if (!bench.enabled("process/stft_2048")) {
+            break;
+        }
+        const size_t period = 1024;
+        SynthSource synth(synth_params());
+        AudioFormat format{44100, 1, static_cast<uint32_t>(period)};
+        synth.open(format);
+        std::vector<int16_t> samples(period);
+        AudioSource::tp timestamp;
+        uint64_t frame_num = 0;
+        synth.read(samples.data(), period, timestamp, frame_num);
+
+        AudioProcess process;
+        process.set_num_channels(1);
+        process.set_history_size(50);
+        process.set_stft(2048, hop);
+        bench.run("process/stft_2048", hop, period, [&]() {
+            process.process(samples, timestamp, frame_num);
+        });
+    }
+
+    // Whole capture -> ring -> process pipeline fed by an unpaced synth source
+    for (auto size : SAMPLE_SIZES) {
+        if (!bench.enabled("process/pipeline_synth")) {
+            break;
+        }
+        AudioProcess process;
+        process.set_num_channels(1);
+        process.set_samples_per_frame(size);
+        process.set_history_size(50);
+        process.set_source(std::make_unique<SynthSource>(synth_params()));
+        std::atomic<size_t> processed = 0;
+        process.add_process_callback("bench", [&processed](const AudioProcess*) {
+            processed.fetch_add(1, std::memory_order_relaxed);
+        });
+        auto start = Bench::clock::now();
+        process.start();
+        std::this_thread::sleep_for(bench.min_time());
+        process.stop();
+        auto elapsed = std::chrono::duration<double, std::nano>(Bench::clock::now() - start).count();
+        size_t count = processed.load();
+        bench.add_result("process/pipeline_synth", size, size, count, count ? elapsed / count : 0.0);
+    }
+}
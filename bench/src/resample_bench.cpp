@@ -0,0 +1,81 @@
+#include <Bench.h>
+#include <audio_processing.h>
+#include <Filterbank.h>
+#include <Resampler.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+void resample_benches(Bench& bench) {
+    for (auto size : SAMPLE_SIZES) {
+        std::vector<float> input(size);
+        for (size_t i = 0; i < size; ++i) {
+            input[i] = std::abs(std::sin(i * 0.01f)) * 100.0f;
+        }
+        // AudioProcess squeezes every spectrum into 512 bins
+        std::vector<float> output(512);
+        bench.run("resample/to_512", size, [&]() {
+            audio_processing::resample(input, output);
+            do_not_optimize(output[0]);
+        });
+        // Prebuilt tables, what AudioProcess does
+        audio_processing::Resampler linear(size, output.size(), audio_processing::ResampleMode::Linear);
+        bench.run("resample/linear_to_512", size, [&]() {
+            linear.process(input.data(), output.data());
+            do_not_optimize(output[0]);
+        });
+        bench.run("resample/linear_to_512_scalar", size, [&]() {
+            linear.process_scalar(input.data(), output.data());
+            do_not_optimize(output[0]);
+        });
+        audio_processing::Resampler box(size, output.size(), audio_processing::ResampleMode::Box);
+        bench.run("resample/box_to_512", size, [&]() {
+            box.process(input.data(), output.data());
+            do_not_optimize(output[0]);
+        });
+        bench.run("resample/box_to_512_scalar", size, [&]() {
+            box.process_scalar(input.data(), output.data());
+            do_not_optimize(output[0]);
+        });
+    }
+
+    // Band reduction of a 2048 bin spectrum, resample vs precomputed filterbanks
+    const size_t bins = 2048;
+    const double bin_hz = 44100.0 / (2 * bins);
+    std::vector<float> spectrum(bins);
+    for (size_t i = 0; i < bins; ++i) {
+        spectrum[i] = std::sin(i * 0.37f) * 1000.0f / (1 + i * 0.01f);
+    }
+    const std::pair<const char*, audio_processing::BandScale> scales[] = {
+        {"linear", audio_processing::BandScale::Linear},
+        {"log", audio_processing::BandScale::Log},
+        {"mel", audio_processing::BandScale::Mel},
+    };
+    for (size_t bands : {16, 32, 64, 128, 256}) {
+        std::vector<float> output(bands);
+        bench.run("bands/resample", bands, bins, [&]() {
+            audio_processing::resample(spectrum, output);
+            do_not_optimize(output[0]);
+        });
+        for (const auto& [name, scale] : scales) {
+            audio_processing::Filterbank filterbank;
+            filterbank.build(bins, bin_hz, bands, scale);
+            bench.run(std::string("bands/filterbank_") + name, bands, bins, [&]() {
+                filterbank.apply(spectrum.data(), output.data());
+                do_not_optimize(output[0]);
+            });
+        }
+        audio_processing::Filterbank mel;
+        mel.build(bins, bin_hz, bands, audio_processing::BandScale::Mel);
+        bench.run("bands/filterbank_mel_scalar", bands, bins, [&]() {
+            mel.apply_scalar(spectrum.data(), output.data());
+            do_not_optimize(output[0]);
+        });
+        bench.run("bands/filterbank_build_mel", bands, bins, [&]() {
+            audio_processing::Filterbank filterbank;
+            filterbank.build(bins, bin_hz, bands, audio_processing::BandScale::Mel);
+            do_not_optimize(filterbank.num_weights());
+        });
+    }
+}
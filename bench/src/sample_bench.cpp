@@ -0,0 +1,92 @@
+#include <Bench.h>
+#include <SampleKernels.h>
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace audio_processing;
+
+void sample_benches(Bench& bench) {
+    spdlog::info("Sample kernels use {}", simd_name());
+    std::mt19937 rng(1);
+    // Every kernel the CPU runs against scalar, over lengths that leave a tail
+    // after the vector loop and input, window and output that aren't aligned.
+    // Samples and window products are exact, so only the RMS may round differently.
+    if (bench.enabled("sample/simd_matches_scalar")) {
+        const size_t lengths[] = {1, 3, 7, 9, 15, 17, 31, 33, 1023, 1025, 2051};
+        std::vector<int16_t> input(2 * 2051 + 1);
+        for (auto& sample : input) {
+            sample = static_cast<int16_t>(rng());
+        }
+        input[5] = -32768;
+        WindowTable window(2051 + 1, WindowType::Hann);
+        for (const char* simd : simd_names()) {
+            if (std::string(simd) == "scalar") {
+                continue;
+            }
+            size_t mismatches = 0;
+            for (size_t channels : {1, 2}) {
+                for (size_t frames : lengths) {
+                    for (const float* w : {window.data() + 1, static_cast<const float*>(nullptr)}) {
+                        // one past the start: unaligned for every vector width
+                        std::vector<std::vector<float> > expected(channels, std::vector<float>(frames + 1));
+                        std::vector<std::vector<float> > actual(channels, std::vector<float>(frames + 1));
+                        std::vector<float*> expected_out;
+                        std::vector<float*> actual_out;
+                        for (size_t c = 0; c < channels; ++c) {
+                            expected_out.push_back(expected[c].data() + 1);
+                            actual_out.push_back(actual[c].data() + 1);
+                        }
+                        SampleStats expected_channels[2];
+                        SampleStats actual_channels[2];
+                        auto expected_stats = deinterleave_window_scalar(input.data() + 1, frames, channels, w,
+                            expected_out.data(), expected_channels);
+                        auto actual_stats = deinterleave_window_with(simd, input.data() + 1, frames, channels, w,
+                            actual_out.data(), actual_channels);
+                        auto same = [](const SampleStats& a, const SampleStats& b) {
+                            return a.peak == b.peak && std::abs(a.rms - b.rms) <= 1e-5f * std::max(b.rms, 1.0f);
+                        };
+                        bool ok = expected == actual && same(actual_stats, expected_stats);
+                        for (size_t c = 0; c < channels; ++c) {
+                            ok = ok && same(actual_channels[c], expected_channels[c]);
+                        }
+                        if (!ok && mismatches++ == 0) {
+                            std::fprintf(stderr, "%s deinterleave differs from scalar: %zu channels, %zu frames%s\n",
+                                simd, channels, frames, w ? "" : ", no window");
+                        }
+                    }
+                }
+            }
+            bench.expect_at_most("sample/simd_matches_scalar_" + std::string(simd), static_cast<double>(mismatches), 0);
+        }
+    }
+    for (size_t channels : {1, 2}) {
+        const std::string suffix = channels == 1 ? "mono" : "stereo";
+        for (auto size : SAMPLE_SIZES) {
+            std::vector<int16_t> input(size * channels);
+            for (auto& sample : input) {
+                sample = static_cast<int16_t>(rng());
+            }
+            WindowTable window(size, WindowType::Hann);
+            std::vector<std::vector<float> > buffers(channels, std::vector<float>(size));
+            std::vector<float*> out;
+            for (auto& buffer : buffers) {
+                out.push_back(buffer.data());
+            }
+            bench.run("sample/scalar_" + suffix, size, size * channels, [&]() {
+                auto stats = deinterleave_window_scalar(input.data(), size, channels, window.data(), out.data());
+                do_not_optimize(stats);
+            });
+            bench.run("sample/simd_" + suffix, size, size * channels, [&]() {
+                auto stats = deinterleave_window(input.data(), size, channels, window.data(), out.data());
+                do_not_optimize(stats);
+            });
+        }
+    }
+}
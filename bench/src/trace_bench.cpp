@@ -0,0 +1,33 @@
+#include <Bench.h>
+#include <Tracer.h>
+
+#include <sstream>
+#include <string>
+
+void trace_benches(Bench& bench) {
+    auto& tracer = Tracer::instance();
+    const bool was_enabled = Tracer::enabled();
+
+    // What every instrumented stage pays with tracing off, and on. Off it is
+    // one relaxed load and a branch, so anything near 10 ns is a regression
+    Tracer::set_enabled(false);
+    if (double ns = bench.run("trace/span_disabled", 1, [&]() { Tracer::Span span("bench"); })) {
+        bench.expect_at_most("trace/span_disabled_ns", ns, 10);
+    }
+    Tracer::set_enabled(true);
+    Tracer::set_frame(0);
+    bench.run("trace/span_enabled", 1, [&]() {
+        Tracer::Span span("bench");
+    });
+    Tracer::set_frame(Tracer::NO_FRAME);
+
+    // A full ring of this thread written out
+    std::string out;
+    bench.run("trace/write_chrome_json", Tracer::CAPACITY, [&]() {
+        std::ostringstream stream;
+        tracer.write_chrome_json(stream);
+        out = stream.str();
+        do_not_optimize(out.size());
+    });
+    Tracer::set_enabled(was_enabled);
+}
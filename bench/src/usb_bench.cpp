@@ -0,0 +1,469 @@
+#include <Bench.h>
+#include <FrameDecoder.h>
+#include <FrameEncoder.h>
+#include <GridData.h>
+#include <MockUsbTransport.h>
+#include <OutputStage.h>
+#include <Usb.h>
+#include <UsbOutput.h>
+#include <UsbOutputGroup.h>
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Fills a frame with a gradient so every table entry gets used
+static void fill_frame(std::vector<uint8_t>& frame, size_t size) {
+    for (size_t i = 1; i < frame.size(); ++i) {
+        frame[i] = static_cast<uint8_t>((i * 255) / (size * size * 3));
+    }
+}
+
+void usb_benches(Bench& bench) {
+    // The fused output stage writing the payload, as a plain copy (default
+    // config) and with gamma, white balance, dithering and a power cap on
+    for (auto size : GRID_SIZES) {
+        GridData grid(size, size);
+        fill_frame(grid.vector(), size);
+        std::vector<uint8_t> payload(grid.vector().size());
+        OutputStage stage;
+        bench.run("usb/output_stage_copy", size, payload.size(), [&]() {
+            stage.process(grid.vector(), payload.data());
+            do_not_optimize(payload[1]);
+        });
+        OutputStage::Config config;
+        config.gamma = 2.2f;
+        config.brightness = 0.8f;
+        config.balance = {1.0f, 0.9f, 0.8f};
+        config.dither = true;
+        config.max_milliamps = size * size * 15.0f;
+        stage.configure(config);
+        bench.run("usb/output_stage_full", size, payload.size(), [&]() {
+            stage.process(grid.vector(), payload.data());
+            do_not_optimize(payload[1]);
+        });
+
+        // The same work as one pass per step over the frame
+        std::vector<uint16_t> gamma(256);
+        for (size_t v = 0; v < 256; ++v) {
+            gamma[v] = static_cast<uint16_t>(std::lround(std::pow(v / 255.0f, 2.2f) * 65280.0f));
+        }
+        std::vector<uint16_t> levels(payload.size());
+        std::vector<uint8_t> residual(payload.size(), 128);
+        bench.run("usb/output_separate_passes", size, payload.size(), [&]() {
+            const auto& frame = grid.vector();
+            for (size_t i = 1; i < frame.size(); ++i) {
+                levels[i] = gamma[frame[i]];
+            }
+            for (size_t i = 1; i < frame.size(); ++i) {
+                static const float balance[] = {1.0f, 0.9f, 0.8f};
+                levels[i] = static_cast<uint16_t>(levels[i] * balance[(i - 1) % 3] * 0.8f);
+            }
+            for (size_t i = 1; i < frame.size(); ++i) {
+                const uint32_t value = levels[i] + residual[i];
+                payload[i] = static_cast<uint8_t>(value >> 8);
+                residual[i] = static_cast<uint8_t>(value);
+            }
+            uint64_t sum = 0;
+            for (size_t i = 1; i < frame.size(); ++i) {
+                sum += payload[i];
+            }
+            if (sum * 20 / 255 > size * size * 15) {
+                for (size_t i = 1; i < frame.size(); ++i) {
+                    payload[i] = static_cast<uint8_t>(payload[i] * 3 / 4);
+                }
+            }
+            do_not_optimize(payload[1]);
+        });
+    }
+
+    for (auto size : GRID_SIZES) {
+        GridData grid(size, size);
+        std::vector<uint8_t> payload;
+        const size_t bytes = grid.vector().size();
+        bench.run("usb/pack_frame", size, bytes, [&]() {
+            Usb::pack(grid.vector(), payload);
+            do_not_optimize(payload[0]);
+        });
+    }
+
+    // v2 encoding with ~3% of the pixels changing every frame; bytes/frame is in the log
+    for (auto size : GRID_SIZES) {
+        if (!bench.enabled("usb/delta_encode")) {
+            break;
+        }
+        GridData grid(size, size);
+        auto& frame = grid.vector();
+        FrameEncoder encoder;
+        std::vector<uint8_t> out;
+        std::mt19937 rng(1);
+        const size_t changes = std::max<size_t>(1, size * size * 3 / 100);
+        bench.run("usb/delta_encode", size, frame.size(), [&]() {
+            for (size_t i = 0; i < changes; ++i) {
+                frame[1 + rng() % (frame.size() - 1)] = static_cast<uint8_t>(rng());
+            }
+            encoder.encode(frame, out);
+            do_not_optimize(out[0]);
+        });
+        auto& stats = encoder.stats();
+        // a v2 keyframe: every pixel, in spans of at most 65535
+        const size_t pixels = size * size;
+        const size_t keyframe_bytes = frame_format::V2_HEADER_SIZE
+            + (pixels + 0xFFFE) / 0xFFFF * frame_format::SPAN_HEADER_SIZE + pixels * frame_format::BYTES_PER_PIXEL;
+        // keyframes every 120 frames included, ~3% changing should cost well under a quarter of one
+        bench.expect_at_most("usb/delta_encode_bytes_per_frame_" + std::to_string(size),
+            stats.frames ? static_cast<double>(stats.bytes) / stats.frames : 0.0, keyframe_bytes / 4.0);
+    }
+
+    // Encoder output through the reference decoder the firmware uses: keyframes,
+    // sparse and dense deltas, the fallbacks for more than 65535 changed pixels
+    // and more than 65536 pixels, and a missed frame
+    if (bench.enabled("usb/frame_roundtrip")) {
+        std::mt19937 rng(1);
+        size_t failures = 0;
+        auto expect = [&failures](bool ok, const char* what) {
+            if (!ok) {
+                std::fprintf(stderr, "usb/frame_roundtrip: %s\n", what);
+                failures++;
+            }
+        };
+        auto change = [&rng](std::vector<uint8_t>& frame, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                frame[1 + rng() % (frame.size() - 1)] = static_cast<uint8_t>(rng());
+            }
+        };
+        auto same = [](const std::vector<uint8_t>& frame, const std::vector<uint8_t>& pixels) {
+            return std::equal(pixels.begin(), pixels.end(), frame.begin() + 1);
+        };
+        {
+            GridData grid(16, 16);
+            auto& frame = grid.vector();
+            std::vector<uint8_t> pixels(frame.size() - 1);
+            FrameDecoder decoder(pixels.data(), 16 * 16);
+            FrameEncoder encoder;
+            std::vector<uint8_t> out;
+            change(frame, 100);
+            expect(encoder.encode(frame, out) && (out[1] & frame_format::FLAG_KEYFRAME), "first frame is not a keyframe");
+            expect(decoder.decode(out.data(), out.size()) == FrameDecoder::OK && same(frame, pixels), "keyframe");
+            change(frame, 3);
+            expect(encoder.encode(frame, out) && !(out[1] & frame_format::FLAG_KEYFRAME), "sparse change is not a delta");
+            expect(decoder.decode(out.data(), out.size()) == FrameDecoder::OK && same(frame, pixels), "sparse delta");
+            change(frame, frame.size() / 3);
+            expect(encoder.encode(frame, out), "dense change not encoded");
+            expect(decoder.decode(out.data(), out.size()) == FrameDecoder::OK && same(frame, pixels), "dense delta");
+            // the next frame is lost on the way
+            change(frame, 3);
+            encoder.encode(frame, out);
+            change(frame, 3);
+            expect(encoder.encode(frame, out) && !(out[1] & frame_format::FLAG_KEYFRAME), "delta after a lost frame");
+            expect(decoder.decode(out.data(), out.size()) == FrameDecoder::NEED_KEYFRAME, "missed sequence not noticed");
+            encoder.request_keyframe();
+            change(frame, 3);
+            expect(encoder.encode(frame, out) && (out[1] & frame_format::FLAG_KEYFRAME), "requested keyframe");
+            expect(decoder.decode(out.data(), out.size()) == FrameDecoder::OK && same(frame, pixels), "resync");
+        }
+        {
+            // 65536 pixels, all of them changing: more than a span holds
+            GridData grid(256, 256);
+            auto& frame = grid.vector();
+            std::vector<uint8_t> pixels(frame.size() - 1);
+            FrameDecoder decoder(pixels.data(), 256 * 256);
+            FrameEncoder encoder;
+            std::vector<uint8_t> out;
+            encoder.encode(frame, out);
+            expect(decoder.decode(out.data(), out.size()) == FrameDecoder::OK && same(frame, pixels), "large keyframe");
+            for (size_t i = 1; i < frame.size(); i += frame_format::BYTES_PER_PIXEL) {
+                frame[i] ^= 0xFF;
+            }
+            expect(encoder.encode(frame, out) && (out[1] & frame_format::FLAG_KEYFRAME), "every pixel changed is not a keyframe");
+            expect(decoder.decode(out.data(), out.size()) == FrameDecoder::OK && same(frame, pixels), "every pixel changed");
+        }
+        {
+            // offsets no longer fit in 16 bits: whole v1 frames
+            GridData grid(300, 300);
+            auto& frame = grid.vector();
+            std::vector<uint8_t> pixels(frame.size() - 1);
+            FrameDecoder decoder(pixels.data(), 300 * 300);
+            FrameEncoder encoder;
+            std::vector<uint8_t> out;
+            change(frame, 1000);
+            expect(encoder.encode(frame, out) && out[0] == frame_format::V1_HEADER, "large grid is not v1");
+            expect(decoder.decode(out.data(), out.size()) == FrameDecoder::OK && same(frame, pixels), "v1 fallback");
+        }
+        bench.expect_at_most("usb/frame_roundtrip_failures", static_cast<double>(failures), 0);
+    }
+
+    // Cost of handing a frame to the async output on the draw thread, with a
+    // device that takes 2 ms per transfer
+    for (auto size : GRID_SIZES) {
+        if (!bench.enabled("usb/output_send_mock")) {
+            break;
+        }
+        GridData grid(size, size);
+        auto mock = std::make_unique<MockUsbTransport>();
+        mock->set_latency(std::chrono::milliseconds(2));
+        UsbOutput output(std::move(mock), 2);
+        output.start();
+        while (!output.connected()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        bench.run("usb/output_send_mock", size, grid.vector().size(), [&]() {
+            output.send(grid.vector());
+        });
+        output.stop();
+    }
+
+    // The grid cut into 2x2 tiles for four controllers behind mock transports
+    // that complete right away; ns is cutting and submitting one frame
+    for (auto size : GRID_SIZES) {
+        if (!bench.enabled("usb/group_send_mock")) {
+            break;
+        }
+        GridData grid(size, size);
+        UsbOutputGroup group;
+        const size_t half = size / 2;
+        for (size_t i = 0; i < 4; ++i) {
+            group.add_panel({"mock" + std::to_string(i), (i % 2) * half, (i / 2) * half, half, half,
+                UsbOutputGroup::Panel::Wiring::RowMajor, {}}, std::make_unique<MockUsbTransport>());
+        }
+        group.start();
+        auto connected = [&group]() {
+            auto stats = group.stats();
+            return std::all_of(stats.begin(), stats.end(), [](const auto& panel) { return panel.output.connected; });
+        };
+        while (!connected()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        bench.run("usb/group_send_mock", size, grid.vector().size(), [&]() {
+            group.send(grid);
+        });
+        spdlog::info("usb/group_send_mock {}x{}: {} frames held back by a busy panel", size, size, group.skipped());
+        group.stop();
+    }
+
+    // Tiles packed straight into each panel's wiring, from a row-major and a
+    // serpentine grid: every panel must get its pixels in its own wire order
+    if (bench.enabled("usb/group_wiring")) {
+        auto check_wiring = [&bench](auto& grid, const std::string& name) {
+            const size_t tile = 4;
+            const UsbOutputGroup::Panel::Wiring wirings[] = {UsbOutputGroup::Panel::Wiring::RowMajor,
+                UsbOutputGroup::Panel::Wiring::Serpentine, UsbOutputGroup::Panel::Wiring::ColumnSerpentine};
+            for (size_t y = 0; y < grid.height(); ++y) {
+                for (size_t x = 0; x < grid.width(); ++x) {
+                    grid.set(x, y, static_cast<uint8_t>(x), static_cast<uint8_t>(y), static_cast<uint8_t>(x * 16 + y));
+                }
+            }
+            UsbOutputGroup group;
+            std::vector<MockUsbTransport*> mocks;
+            std::vector<UsbOutputGroup::Panel> panels;
+            for (size_t i = 0; i < 3; ++i) {
+                auto mock = std::make_unique<MockUsbTransport>();
+                mocks.push_back(mock.get());
+                // the last one hangs off the bottom of the grid
+                panels.push_back({"mock" + std::to_string(i), i * tile, i == 2 ? size_t(2) : size_t(0), tile, tile, wirings[i], {}});
+                group.add_panel(panels.back(), std::move(mock));
+            }
+            group.start();
+            bool sent = false;
+            for (auto until = Bench::clock::now() + std::chrono::seconds(1); !sent && Bench::clock::now() < until;) {
+                sent = group.send(grid);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            group.stop();
+            size_t wrong = sent ? 0 : 1;
+            for (size_t i = 0; i < panels.size(); ++i) {
+                const auto& panel = panels[i];
+                layout::Serpentine serpentine;
+                layout::ColumnSerpentine columns;
+                serpentine.resize(tile, tile);
+                columns.resize(tile, tile);
+                const std::vector<uint8_t> frame = mocks[i]->last_frame();
+                // numbered frames: the pixels are the last tile * tile * 3 bytes
+                if (frame.size() < tile * tile * 3) {
+                    wrong++;
+                    continue;
+                }
+                const uint8_t* pixels = frame.data() + frame.size() - tile * tile * 3;
+                for (size_t row = 0; row < tile; ++row) {
+                    for (size_t col = 0; col < tile; ++col) {
+                        const size_t index = panel.wiring == UsbOutputGroup::Panel::Wiring::Serpentine ? serpentine.index(col, row)
+                            : panel.wiring == UsbOutputGroup::Panel::Wiring::ColumnSerpentine ? columns.index(col, row)
+                            : row * tile + col;
+                        const size_t x = panel.x + col;
+                        const size_t y = panel.y + row;
+                        const Rgb expected = y < grid.height() ? grid.get(x, y) : Rgb{0, 0, 0};
+                        const uint8_t* got = pixels + index * 3;
+                        if (got[0] != expected.r || got[1] != expected.g || got[2] != expected.b) {
+                            wrong++;
+                        }
+                    }
+                }
+            }
+            bench.expect_at_most("usb/group_wiring_" + name + "_wrong_pixels", static_cast<double>(wrong), 0);
+        };
+        GridData rows(12, 4);
+        check_wiring(rows, "rows");
+        BasicGridData<layout::Serpentine> serpentine(12, 4);
+        check_wiring(serpentine, "serpentine");
+    }
+
+    // A full white frame over four panels with a power cap: the panels
+    // together must stay within the one budget
+    if (bench.enabled("usb/group_power_cap")) {
+        const size_t size = GRID_SIZES[1];
+        const size_t half = size / 2;
+        GridData grid(size, size);
+        std::fill(grid.vector().begin() + GridData::HEADER_SIZE, grid.vector().end(), 255);
+        UsbOutputGroup group;
+        for (size_t i = 0; i < 4; ++i) {
+            group.add_panel({"mock" + std::to_string(i), (i % 2) * half, (i / 2) * half, half, half,
+                UsbOutputGroup::Panel::Wiring::RowMajor, {}}, std::make_unique<MockUsbTransport>());
+        }
+        OutputStage::Config config;
+        // well under the 60 mA per LED full white wants
+        config.max_milliamps = size * size * 10.0f;
+        group.set_output_stage(config);
+        group.start();
+        // the cap settles from the previous frame's draw, give it a few
+        size_t sent = 0;
+        for (auto until = Bench::clock::now() + std::chrono::seconds(1); sent < 20 && Bench::clock::now() < until;) {
+            sent += group.send(grid) ? 1 : 0;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        group.stop();
+        float total = 0.0f;
+        for (const auto& panel : group.stats()) {
+            total += panel.output.milliamps;
+        }
+        bench.expect_at_least("usb/group_power_cap_frames", static_cast<double>(sent), 20);
+        bench.expect_at_most("usb/group_power_cap_milliamps", total, config.max_milliamps);
+    }
+
+    // Transfers failing while frames keep coming every millisecond: each failure
+    // is counted and makes the next frame a keyframe, and frames keep reaching
+    // the device, through the reconnect an Error triggers
+    if (bench.enabled("usb/transfer_failures_mock")) {
+        const std::string name = "usb/transfer_failures_mock";
+        const size_t size = GRID_SIZES[0];
+        GridData grid(size, size);
+        auto owned = std::make_unique<MockUsbTransport>();
+        MockUsbTransport* mock = owned.get();
+        mock->set_latency(std::chrono::milliseconds(1));
+        UsbOutput output(std::move(owned), 2);
+        // no periodic keyframes, so any are down to the failures
+        output.set_wire_format(UsbOutput::WireFormat::Delta, 1000000);
+        output.start();
+        while (!output.connected()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        using clock = std::chrono::steady_clock;
+        auto render = [&]() {
+            grid.set(0, 0, static_cast<uint8_t>(grid.get_raw(0, 0)[0] + 1), 0, 0);
+            output.send(grid.vector());
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        };
+        for (auto until = clock::now() + std::chrono::milliseconds(20); clock::now() < until;) {
+            render();
+        }
+        const auto before = output.stats();
+        mock->fail_next(3, UsbStatus::TimedOut);
+        const auto give_up = clock::now() + std::chrono::seconds(2);
+        while (output.stats().failed < before.failed + 3 && clock::now() < give_up) {
+            render();
+        }
+        const uint64_t received = mock->frames_received();
+        for (auto until = clock::now() + std::chrono::milliseconds(20); clock::now() < until;) {
+            render();
+        }
+        const auto timed_out = output.stats();
+        bench.expect_at_least(name + "_timeouts_counted", static_cast<double>(timed_out.failed - before.failed), 3);
+        bench.expect_at_least(name + "_keyframes_after_timeouts", static_cast<double>(timed_out.keyframes - before.keyframes), 1);
+        bench.expect_at_least(name + "_frames_after_timeouts", static_cast<double>(mock->frames_received() - received), 1);
+
+        mock->set_failure_rate(0.2);
+        const uint64_t received_failing = mock->frames_received();
+        for (auto until = clock::now() + std::chrono::milliseconds(200); clock::now() < until;) {
+            render();
+        }
+        mock->set_failure_rate(0);
+        const auto failing = output.stats();
+        const uint64_t received_after = mock->frames_received();
+        for (auto until = clock::now() + std::chrono::milliseconds(50); clock::now() < until;) {
+            render();
+        }
+        const auto after = output.stats();
+        output.stop();
+        bench.expect_at_least(name + "_errors_counted", static_cast<double>(failing.failed - timed_out.failed), 1);
+        bench.expect_at_least(name + "_keyframes_after_errors", static_cast<double>(failing.keyframes - timed_out.keyframes), 1);
+        bench.expect_at_least(name + "_frames_while_failing", static_cast<double>(received_after - received_failing), 10);
+        bench.expect_at_least(name + "_frames_after_errors", static_cast<double>(mock->frames_received() - received_after), 10);
+        spdlog::info("{}: {} failed, {} keyframes, {} reconnects", name, after.failed, after.keyframes, after.reconnects);
+    }
+
+    // Unplug and replug a mock device while frames keep coming every
+    // millisecond; ns is from the replug to the first frame the device gets,
+    // with hotplug and with the polling/backoff it falls back to
+    for (bool hotplug : {true, false}) {
+        const std::string name = hotplug ? "usb/reconnect_hotplug_mock" : "usb/reconnect_poll_mock";
+        if (!bench.enabled(name)) {
+            continue;
+        }
+        const size_t size = GRID_SIZES[0];
+        GridData grid(size, size);
+        auto owned = std::make_unique<MockUsbTransport>();
+        MockUsbTransport* mock = owned.get();
+        mock->set_latency(std::chrono::milliseconds(1));
+        mock->set_hotplug(hotplug);
+        UsbOutput output(std::move(owned), 2);
+        output.start();
+        while (!output.connected()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        using clock = std::chrono::steady_clock;
+        // one rendered frame, returns how long send() held the draw thread
+        auto render = [&]() {
+            grid.set(0, 0, static_cast<uint8_t>(grid.get_raw(0, 0)[0] + 1), 0, 0);
+            auto start = clock::now();
+            output.send(grid.vector());
+            auto spent = clock::now() - start;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            return spent;
+        };
+        clock::duration slowest{};
+        for (auto until = clock::now() + std::chrono::milliseconds(20); clock::now() < until;) {
+            slowest = std::max(slowest, render());
+        }
+        const uint64_t dropped_before = output.stats().dropped;
+        mock->set_present(false);
+        for (auto until = clock::now() + std::chrono::milliseconds(600); clock::now() < until;) {
+            slowest = std::max(slowest, render());
+        }
+        const uint64_t received = mock->frames_received();
+        const auto replugged = clock::now();
+        mock->set_present(true);
+        const auto give_up = replugged + std::chrono::seconds(5);
+        while (mock->frames_received() == received && clock::now() < give_up) {
+            slowest = std::max(slowest, render());
+        }
+        const auto latency = clock::now() - replugged;
+        const auto stats = output.stats();
+        output.stop();
+        // frames sent while unplugged are dropped, and the output recovers by itself
+        bench.expect_at_least(name + "_dropped_while_unplugged", static_cast<double>(stats.dropped - dropped_before), 1);
+        bench.expect_at_least(name + "_reconnects", static_cast<double>(stats.reconnects), 1);
+        if (!bench.expect_at_least(name + "_frames_after_replug", static_cast<double>(mock->frames_received() - received), 1)) {
+            continue;
+        }
+        bench.add_result(name, size, 1, 1, std::chrono::duration<double, std::nano>(latency).count());
+        spdlog::info("{}: {} frames dropped while unplugged, {} reconnects, slowest send {:.3f} ms", name,
+            stats.dropped - dropped_before, stats.reconnects, std::chrono::duration<double, std::milli>(slowest).count());
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+// Fixed-size heap array aligned to a cache line (or SIMD register) boundary.
+// resize() discards the contents; it is meant to be called outside the hot path.
+template <typename T, size_t Alignment = 64>
+class AlignedBuffer {
+public:
+    AlignedBuffer() = default;
+    explicit AlignedBuffer(size_t size) { resize(size); }
+    ~AlignedBuffer() { release(); }
+    AlignedBuffer(AlignedBuffer&& other) noexcept
+        : m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)) {}
+    AlignedBuffer& operator=(AlignedBuffer&& other) noexcept {
+        if (this != &other) {
+            release();
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+        }
+        return *this;
+    }
+
+    void resize(size_t size) {
+        if (size == m_size) {
+            return;
+        }
+        release();
+        if (size > 0) {
+            m_data = static_cast<T*>(::operator new[](size * sizeof(T), std::align_val_t(Alignment)));
+            for (size_t i = 0; i < size; ++i) {
+                new (m_data + i) T();
+            }
+        }
+        m_size = size;
+    }
+
+    T* data() { return m_data; }
+    const T* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    T& operator[](size_t i) { return m_data[i]; }
+    const T& operator[](size_t i) const { return m_data[i]; }
+    T* begin() { return m_data; }
+    T* end() { return m_data + m_size; }
+    const T* begin() const { return m_data; }
+    const T* end() const { return m_data + m_size; }
+
+private:
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+    void release() {
+        if (m_data) {
+            for (size_t i = 0; i < m_size; ++i) {
+                m_data[i].~T();
+            }
+            ::operator delete[](m_data, std::align_val_t(Alignment));
+        }
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+private:
+    T* m_data = nullptr;
+    size_t m_size = 0;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Rgb.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// HSV to RGB through a hue wheel generated at compile time, in fixed point.
+// Takes the same units as HSVtoRGB (hue in degrees, saturation and value in
+// percent) and stays within a couple of steps of it, without fmod or branches.
+namespace color {
+
+// 256 steps per 60 degree sector
+inline constexpr size_t HUE_STEPS = 1536;
+
+constexpr std::array<Rgb, HUE_STEPS> make_hue_wheel() {
+    std::array<Rgb, HUE_STEPS> wheel{};
+    for (size_t i = 0; i < HUE_STEPS; ++i) {
+        const uint8_t rise = static_cast<uint8_t>(((i % 256) * 255 + 128) / 256);
+        const uint8_t fall = 255 - rise;
+        switch (i / 256) {
+            case 0: wheel[i] = {255, rise, 0}; break;
+            case 1: wheel[i] = {fall, 255, 0}; break;
+            case 2: wheel[i] = {0, 255, rise}; break;
+            case 3: wheel[i] = {0, fall, 255}; break;
+            case 4: wheel[i] = {rise, 0, 255}; break;
+            default: wheel[i] = {255, 0, fall}; break;
+        }
+    }
+    return wheel;
+}
+
+// Fully saturated, full value colour of every hue step
+inline constexpr std::array<Rgb, HUE_STEPS> HUE_WHEEL = make_hue_wheel();
+
+// Hue in degrees (any range, wrapped) to a wheel index
+inline uint32_t hue_index(float hue) {
+    float steps = hue * (HUE_STEPS / 360.0f) + 0.5f;
+    int32_t index = static_cast<int32_t>(steps);
+    index -= steps < static_cast<float>(index);
+    if (static_cast<uint32_t>(index) < HUE_STEPS) {
+        return static_cast<uint32_t>(index);
+    }
+    index %= static_cast<int32_t>(HUE_STEPS);
+    return static_cast<uint32_t>(index < 0 ? index + static_cast<int32_t>(HUE_STEPS) : index);
+}
+
+// Percent to 0..256 (8 fractional bits, so 100% is exactly 1.0)
+inline uint32_t percent_to_q8(float percent) {
+    float scaled = percent * 2.56f + 0.5f;
+    return scaled <= 0.0f ? 0 : scaled >= 256.0f ? 256 : static_cast<uint32_t>(scaled);
+}
+
+// value * (1 - saturation * (1 - wheel)) on 0..255, with saturation and
+// value from percent_to_q8
+inline uint8_t shade(uint32_t wheel, uint32_t saturation, uint32_t value) {
+    return static_cast<uint8_t>((value * (65280 - saturation * (255 - wheel)) + 32768) >> 16);
+}
+
+inline Rgb hsv_to_rgb(float hue, float saturation, float value) {
+    const Rgb& full = HUE_WHEEL[hue_index(hue)];
+    const uint32_t s = percent_to_q8(saturation);
+    const uint32_t v = percent_to_q8(value);
+    return Rgb{shade(full.r, s, v), shade(full.g, s, v), shade(full.b, s, v)};
+}
+
+// Converts a run of pixels into packed RGB bytes (3 per pixel). Saturation
+// and value hold either one entry per pixel or a single entry for all of
+// them; the run ends with the shortest per-pixel span.
+void hsv_to_rgb(std::span<const float> hue, std::span<const float> saturation, std::span<const float> value,
+    uint8_t* rgb);
+
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <GridComponent.h>
+#include <Rgb.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+// Animates GridComponents and draws them into a BasicGridData. Components are kept
+// as a structure of arrays (one array per field) so step() streams through
+// them, and dead ones are compacted out in the same pass, keeping their draw
+// order and the arrays' capacity. The grid is split into 8x8 tiles; only the
+// tiles a component left, entered or changed colour in are cleared and drawn
+// again. Overlapping components add up, saturating at 255.
+class ComponentEngine {
+public:
+    static constexpr size_t TILE = 8;
+
+    void reset(size_t width, size_t height);
+    void reserve(size_t count);
+    void add(const GridComponent& component);
+    void clear();
+
+    // Moves and fades every component by dt seconds and drops the dead ones
+    void step(float dt);
+    // Redraws the tiles that changed since the last call into a BasicGridData
+    template <typename Grid>
+    void rasterise(Grid& grid);
+
+    size_t size() const { return m_x.size(); }
+    // Tiles redrawn by the last rasterise()
+    size_t drawn_tiles() const { return m_drawn_tiles; }
+    size_t num_tiles() const { return m_dirty.size(); }
+
+private:
+    struct Rect {
+        int32_t x0 = 0;
+        int32_t y0 = 0;
+        int32_t x1 = 0;
+        int32_t y1 = 0;
+    };
+
+    static constexpr uint8_t VISIBLE = 1;
+    static constexpr uint8_t KILL_WHEN_DEAD = 2;
+
+    static int32_t floor_to_int(float value) {
+        int32_t i = static_cast<int32_t>(value);
+        return i - (value < static_cast<float>(i));
+    }
+    static uint8_t quantize(float value) { return static_cast<uint8_t>(value); }
+    static uint8_t add_saturate(uint8_t a, uint8_t b) {
+        unsigned sum = static_cast<unsigned>(a) + b;
+        return static_cast<uint8_t>(sum > 255 ? 255 : sum);
+    }
+
+    Rect rect(size_t i) const {
+        Rect r;
+        r.x0 = floor_to_int(m_x[i]);
+        r.y0 = floor_to_int(m_y[i]);
+        r.x1 = r.x0 + m_w[i];
+        r.y1 = r.y0 + m_h[i];
+        return r;
+    }
+    void mark(const Rect& rect);
+    void move(size_t from, size_t to);
+
+private:
+    size_t m_width = 0;
+    size_t m_height = 0;
+    size_t m_tiles_x = 0;
+    size_t m_tiles_y = 0;
+    std::vector<uint8_t> m_dirty;
+    size_t m_drawn_tiles = 0;
+
+    // one entry per component
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<uint16_t> m_w;
+    std::vector<uint16_t> m_h;
+    std::vector<float> m_vx;
+    std::vector<float> m_vy;
+    std::vector<float> m_r;
+    std::vector<float> m_g;
+    std::vector<float> m_b;
+    std::vector<float> m_vr;
+    std::vector<float> m_vg;
+    std::vector<float> m_vb;
+    // bit 0 visible, bit 1 kill_when_dead
+    std::vector<uint8_t> m_flags;
+    // empty unless the component colours its pixels itself
+    std::vector<std::function<Rgb (const Point<size_t>&)> > m_getters;
+};
+
+template <typename Grid>
+void ComponentEngine::rasterise(Grid& grid) {
+    constexpr bool CONTIGUOUS = Grid::layout_type::ROW_CONTIGUOUS;
+    if (grid.width() != m_width || grid.height() != m_height) {
+        reset(grid.width(), grid.height());
+    }
+    m_drawn_tiles = 0;
+    for (size_t t = 0; t < m_dirty.size(); ++t) {
+        if (!m_dirty[t]) {
+            continue;
+        }
+        m_drawn_tiles++;
+        const size_t x0 = (t % m_tiles_x) * TILE;
+        const size_t y0 = (t / m_tiles_x) * TILE;
+        const size_t x1 = std::min(x0 + TILE, m_width);
+        const size_t y1 = std::min(y0 + TILE, m_height);
+        for (size_t y = y0; y < y1; ++y) {
+            if constexpr (CONTIGUOUS) {
+                std::memset(grid.get_raw(x0, y), 0, (x1 - x0) * 3);
+            } else {
+                for (size_t x = x0; x < x1; ++x) {
+                    grid.set(x, y, 0, 0, 0);
+                }
+            }
+        }
+    }
+    if (m_drawn_tiles == 0) {
+        return;
+    }
+
+    const int32_t width = static_cast<int32_t>(m_width);
+    const int32_t height = static_cast<int32_t>(m_height);
+    for (size_t i = 0; i < size(); ++i) {
+        if (!(m_flags[i] & VISIBLE)) {
+            continue;
+        }
+        const Rect r = rect(i);
+        const int32_t cx0 = std::max(r.x0, 0);
+        const int32_t cy0 = std::max(r.y0, 0);
+        const int32_t cx1 = std::min(r.x1, width);
+        const int32_t cy1 = std::min(r.y1, height);
+        if (cx0 >= cx1 || cy0 >= cy1) {
+            continue;
+        }
+        const Rgb color{quantize(m_r[i]), quantize(m_g[i]), quantize(m_b[i])};
+        const auto& getter = m_getters[i];
+        for (size_t ty = cy0 / TILE; ty <= static_cast<size_t>(cy1 - 1) / TILE; ++ty) {
+            for (size_t tx = cx0 / TILE; tx <= static_cast<size_t>(cx1 - 1) / TILE; ++tx) {
+                if (!m_dirty[ty * m_tiles_x + tx]) {
+                    continue;
+                }
+                // the part of the component inside this tile
+                const size_t x0 = std::max<size_t>(cx0, tx * TILE);
+                const size_t x1 = std::min<size_t>(cx1, (tx + 1) * TILE);
+                const size_t y0 = std::max<size_t>(cy0, ty * TILE);
+                const size_t y1 = std::min<size_t>(cy1, (ty + 1) * TILE);
+                for (size_t y = y0; y < y1; ++y) {
+                    for (size_t x = x0; x < x1; ++x) {
+                        uint8_t* pixel = grid.get_raw(x, y);
+                        Rgb c = getter ? getter(Point<size_t>{x - r.x0, y - r.y0, 0}) : color;
+                        pixel[0] = add_saturate(pixel[0], c.r);
+                        pixel[1] = add_saturate(pixel[1], c.g);
+                        pixel[2] = add_saturate(pixel[2], c.b);
+                    }
+                }
+            }
+        }
+    }
+    std::fill(m_dirty.begin(), m_dirty.end(), 0);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+// Wire format shared with the LED controller firmware. Kept free of the C++
+// standard library so the firmware can include this file as is.
+//
+// v1, header 42:  [42] [r g b] * width * height
+//     The whole frame, pixels in the GridData wire order.
+//
+// v2, header 43:  [43] [flags] [seq lo] [seq hi] [spans lo] [spans hi]
+//                 then for every span
+//                 [offset lo] [offset hi] [count lo] [count hi] [r g b] * count
+//     offset and count are in pixels. flags bit 0 marks a keyframe; a keyframe
+//     carries every pixel and resets the receiver. Any other frame only carries
+//     the pixels that changed since frame seq - 1 and must be dropped (until the
+//     next keyframe) if that frame was missed. Trailing padding is ignored.
+//
+// v3, header 44:  [44] [frame lo] [frame hi] [r g b] * width * height
+//     A whole frame like v1, numbered. Controllers sharing one grid get their
+//     own part of the same frame under the same number, so they can latch it
+//     together.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace frame_format {
+    const uint8_t V1_HEADER = 42;
+    const uint8_t V2_HEADER = 43;
+    const uint8_t V3_HEADER = 44;
+    const size_t V3_HEADER_SIZE = 3;
+    const uint8_t FLAG_KEYFRAME = 1;
+    const size_t V2_HEADER_SIZE = 6;
+    const size_t SPAN_HEADER_SIZE = 4;
+    const size_t BYTES_PER_PIXEL = 3;
+}
+
+// Reference decoder: applies v1 and v2 frames to a caller-owned pixel buffer.
+class FrameDecoder {
+public:
+    enum Result {
+        OK = 0,
+        // delta for a frame we don't have, waiting for a keyframe
+        NEED_KEYFRAME = 1,
+        BAD_FRAME = -1,
+    };
+
+    FrameDecoder(uint8_t* pixels, size_t num_pixels) : m_pixels(pixels), m_num_pixels(num_pixels) {}
+
+    int decode(const uint8_t* data, size_t size) {
+        using namespace frame_format;
+        if (size < 1) {
+            return BAD_FRAME;
+        }
+        if (data[0] == V1_HEADER) {
+            size_t bytes = size - 1 < m_num_pixels * BYTES_PER_PIXEL ? size - 1 : m_num_pixels * BYTES_PER_PIXEL;
+            memcpy(m_pixels, data + 1, bytes);
+            m_synced = false;
+            return OK;
+        }
+        if (data[0] == V3_HEADER) {
+            if (size < V3_HEADER_SIZE) {
+                return BAD_FRAME;
+            }
+            size_t bytes = size - V3_HEADER_SIZE < m_num_pixels * BYTES_PER_PIXEL
+                ? size - V3_HEADER_SIZE : m_num_pixels * BYTES_PER_PIXEL;
+            memcpy(m_pixels, data + V3_HEADER_SIZE, bytes);
+            m_frame_number = data[1] | (data[2] << 8);
+            m_synced = false;
+            return OK;
+        }
+        if (data[0] != V2_HEADER || size < V2_HEADER_SIZE) {
+            return BAD_FRAME;
+        }
+        bool keyframe = data[1] & FLAG_KEYFRAME;
+        uint16_t sequence = data[2] | (data[3] << 8);
+        uint16_t spans = data[4] | (data[5] << 8);
+        if (!keyframe && (!m_synced || sequence != static_cast<uint16_t>(m_sequence + 1))) {
+            m_synced = false;
+            return NEED_KEYFRAME;
+        }
+        // validate before touching the pixels so a bad frame leaves them intact
+        size_t pos = V2_HEADER_SIZE;
+        for (uint16_t i = 0; i < spans; ++i) {
+            if (pos + SPAN_HEADER_SIZE > size) {
+                return BAD_FRAME;
+            }
+            size_t offset = data[pos] | (data[pos + 1] << 8);
+            size_t count = data[pos + 2] | (data[pos + 3] << 8);
+            pos += SPAN_HEADER_SIZE + count * BYTES_PER_PIXEL;
+            if (pos > size || offset + count > m_num_pixels) {
+                return BAD_FRAME;
+            }
+        }
+        pos = V2_HEADER_SIZE;
+        for (uint16_t i = 0; i < spans; ++i) {
+            size_t offset = data[pos] | (data[pos + 1] << 8);
+            size_t count = data[pos + 2] | (data[pos + 3] << 8);
+            memcpy(m_pixels + offset * BYTES_PER_PIXEL, data + pos + SPAN_HEADER_SIZE, count * BYTES_PER_PIXEL);
+            pos += SPAN_HEADER_SIZE + count * BYTES_PER_PIXEL;
+        }
+        m_sequence = sequence;
+        m_synced = true;
+        return OK;
+    }
+
+    uint16_t sequence() const { return m_sequence; }
+    bool synced() const { return m_synced; }
+    // of the last v3 frame
+    uint16_t frame_number() const { return m_frame_number; }
+
+private:
+    uint8_t* m_pixels;
+    size_t m_num_pixels;
+    uint16_t m_sequence = 0;
+    uint16_t m_frame_number = 0;
+    bool m_synced = false;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <FrameDecoder.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Turns whole v1 frames (header byte + rgb, as in GridData::vector()) into v2
+// frames that only carry the spans of pixels that changed since the previous
+// encoded frame. Sends a keyframe every keyframe_interval frames, when asked
+// to (e.g. after a failed transfer or a reconnect), and whenever the delta
+// would not be smaller.
+class FrameEncoder {
+public:
+    struct Stats {
+        uint64_t frames = 0;
+        uint64_t keyframes = 0;
+        uint64_t unchanged = 0;
+        uint64_t bytes = 0;
+        // what the same frames would have cost as v1
+        uint64_t raw_bytes = 0;
+        size_t last_bytes = 0;
+    };
+
+    void set_keyframe_interval(size_t frames) { m_keyframe_interval = frames; }
+    void request_keyframe() { m_force_keyframe = true; }
+    // Returns false when nothing changed and there is nothing to send
+    bool encode(const std::vector<uint8_t>& frame, std::vector<uint8_t>& out);
+    const Stats& stats() const { return m_stats; }
+
+private:
+    void write_header(std::vector<uint8_t>& out, bool keyframe, uint16_t spans);
+    void write_span(std::vector<uint8_t>& out, const uint8_t* pixels, size_t offset, size_t count);
+    void encode_keyframe(const uint8_t* pixels, size_t num_pixels, std::vector<uint8_t>& out);
+
+private:
+    std::vector<uint8_t> m_reference;
+    uint16_t m_sequence = 0;
+    size_t m_keyframe_interval = 120;
+    size_t m_since_keyframe = 0;
+    bool m_force_keyframe = true;
+    Stats m_stats;
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <ColorLut.h>
 #include <Rgb.h>
 #include <Point.h>
 
@@ -18,5 +19,12 @@ public:
     bool kill_when_dead = true;
     bool visible = false;
     Rgb center_color = {0, 0, 0};
-    std::function<Rgb (const Point&)> color_getter = [=]{return center_color;};
-};
\ No newline at end of file
+    // unset means every pixel is center_color
+    std::function<Rgb (const Point<size_t>&)> color_getter;
+};
+
+// hsv is hue in degrees, saturation and value in percent
+template<typename T>
+void GridComponent::set_hsv(const Point<T>& hsv) {
+    center_color = color::hsv_to_rgb(static_cast<float>(hsv.x), static_cast<float>(hsv.y), static_cast<float>(hsv.z));
+}
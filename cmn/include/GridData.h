@@ -1,35 +1,117 @@
 #pragma once
 
+#include <span>
 #include <vector>
 #include <cstddef>
 #include <cstdint>
-#include <GridComponent.h>
+#include <algorithm>
+#include <ColorLut.h>
+#include <ComponentEngine.h>
+#include <GridLayout.h>
 
-class GridData {
+// RGB pixels of an LED matrix behind a header byte, stored in the wire order
+// of Layout (see GridLayout.h) so vector() can be sent as it is
+template <typename Layout>
+class BasicGridData {
 public:
-    GridData() = default;
-    GridData(size_t width, size_t height) : m_width(width), m_height(height) {
+    using layout_type = Layout;
+    static constexpr size_t HEADER_SIZE = 1;
+
+    BasicGridData() = default;
+    BasicGridData(size_t width, size_t height) : m_width(width), m_height(height) {
         resize(width, height);
     }
 
     void resize(size_t width, size_t height);
-    
+
     Rgb get(size_t x, size_t y) const;
-    uint8_t* get_raw(size_t x, size_t y);
+    uint8_t* get_raw(size_t x, size_t y) { return &m_data[offset(x, y)]; }
     void set(size_t x, size_t y, uint8_t r, uint8_t g, uint8_t b);
     void set(size_t x, size_t y, const Rgb& b);
+    // Fills row y from x = 0 with HSV colours (see color::hsv_to_rgb), up to the grid width
+    void set_hsv_row(size_t y, std::span<const float> hue, std::span<const float> saturation,
+        std::span<const float> value);
 
     size_t width() const { return m_width; }
     size_t height() const { return m_height; }
+    // For layouts set up at run time (layout::Lookup)
+    Layout& layout() { return m_layout; }
 
     std::vector<uint8_t>& vector();
+
+    ComponentEngine& components() { return m_components; }
+    // Advances the components by dt seconds and draws the tiles they changed
+    void compile(float dt);
+
 private:
-    void compile();
+    size_t offset(size_t x, size_t y) const { return HEADER_SIZE + m_layout.index(x, y) * 3; }
 
 private:
     size_t m_width = 0;
     size_t m_height = 0;
+    Layout m_layout;
     std::vector<uint8_t> m_data;
-    std::vector<GridComponent> m_components;
+    // one row of set_hsv_row() output when rows aren't contiguous
+    std::vector<uint8_t> m_row;
+    ComponentEngine m_components;
     uint8_t const HEADER_BYTE = 42;
-};
\ No newline at end of file
+};
+
+using GridData = BasicGridData<layout::RowMajor>;
+
+template <typename Layout>
+void BasicGridData<Layout>::resize(size_t width, size_t height) {
+    m_width = width;
+    m_height = height;
+    m_layout.resize(width, height);
+    m_data.resize(m_layout.size() * 3 + HEADER_SIZE, 0);
+    m_data[0] = HEADER_BYTE;
+    m_components.reset(width, height);
+}
+
+template <typename Layout>
+Rgb BasicGridData<Layout>::get(size_t x, size_t y) const {
+    auto data = &m_data[offset(x, y)];
+    return {*data, *(data + 1), *(data + 2)};
+}
+
+template <typename Layout>
+void BasicGridData<Layout>::set(size_t x, size_t y, uint8_t r, uint8_t g, uint8_t b) {
+    auto data = &m_data[offset(x, y)];
+    *data = r;
+    *(data + 1) = g;
+    *(data + 2) = b;
+}
+
+template <typename Layout>
+void BasicGridData<Layout>::set(size_t x, size_t y, const Rgb& rgb) {
+    set(x, y, rgb.r, rgb.g, rgb.b);
+}
+
+template <typename Layout>
+void BasicGridData<Layout>::set_hsv_row(size_t y, std::span<const float> hue, std::span<const float> saturation,
+        std::span<const float> value) {
+    hue = hue.first(std::min(hue.size(), m_width));
+    if constexpr (Layout::ROW_CONTIGUOUS) {
+        color::hsv_to_rgb(hue, saturation, value, get_raw(0, y));
+    } else {
+        m_row.resize(hue.size() * 3);
+        color::hsv_to_rgb(hue, saturation, value, m_row.data());
+        for (size_t x = 0; x < hue.size(); ++x) {
+            set(x, y, m_row[x * 3], m_row[x * 3 + 1], m_row[x * 3 + 2]);
+        }
+    }
+}
+
+template <typename Layout>
+std::vector<uint8_t>& BasicGridData<Layout>::vector() {
+    return m_data;
+}
+
+template <typename Layout>
+void BasicGridData<Layout>::compile(float dt) {
+    m_components.step(dt);
+    m_components.rasterise(*this);
+}
+
+extern template class BasicGridData<layout::RowMajor>;
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Where pixel (x, y) sits in the wire order of an LED matrix. BasicGridData
+// takes one of these as a template parameter and stores pixels straight in
+// wire order, so a frame goes to USB as is. Every layout has:
+//   resize(width, height)  set up for a grid of that size
+//   size()                 pixels the wire order holds (>= width * height)
+//   index(x, y)            position of the pixel in wire order
+//   ROW_CONTIGUOUS         whether a row is index(0, y) .. index(width - 1, y)
+namespace layout {
+
+// Rows left to right, top to bottom
+class RowMajor {
+public:
+    static constexpr bool ROW_CONTIGUOUS = true;
+
+    void resize(size_t width, size_t height) { m_width = width; m_height = height; }
+    size_t size() const { return m_width * m_height; }
+    size_t index(size_t x, size_t y) const { return y * m_width + x; }
+
+private:
+    size_t m_width = 0;
+    size_t m_height = 0;
+};
+
+// Rows top to bottom, every other one wired right to left
+class Serpentine {
+public:
+    static constexpr bool ROW_CONTIGUOUS = false;
+
+    void resize(size_t width, size_t height) { m_width = width; m_height = height; }
+    size_t size() const { return m_width * m_height; }
+    size_t index(size_t x, size_t y) const {
+        return y * m_width + ((y & 1) ? m_width - 1 - x : x);
+    }
+
+private:
+    size_t m_width = 0;
+    size_t m_height = 0;
+};
+
+// Columns left to right, every other one wired bottom to top
+class ColumnSerpentine {
+public:
+    static constexpr bool ROW_CONTIGUOUS = false;
+
+    void resize(size_t width, size_t height) { m_width = width; m_height = height; }
+    size_t size() const { return m_width * m_height; }
+    size_t index(size_t x, size_t y) const {
+        return x * m_height + ((x & 1) ? m_height - 1 - y : y);
+    }
+
+private:
+    size_t m_width = 0;
+    size_t m_height = 0;
+};
+
+// PANEL_WIDTH x PANEL_HEIGHT panels chained one after the other: Panels
+// orders the panels across the grid and Panel the pixels inside each one.
+// A grid that isn't a whole number of panels is padded up to one.
+template <size_t PANEL_WIDTH, size_t PANEL_HEIGHT, typename Panel = RowMajor, typename Panels = RowMajor>
+class Tiled {
+public:
+    static constexpr bool ROW_CONTIGUOUS = false;
+    static constexpr size_t PANEL_PIXELS = PANEL_WIDTH * PANEL_HEIGHT;
+
+    void resize(size_t width, size_t height) {
+        m_panels_x = (width + PANEL_WIDTH - 1) / PANEL_WIDTH;
+        m_panels_y = (height + PANEL_HEIGHT - 1) / PANEL_HEIGHT;
+        m_panel.resize(PANEL_WIDTH, PANEL_HEIGHT);
+        m_panels.resize(m_panels_x, m_panels_y);
+    }
+    size_t size() const { return m_panels_x * m_panels_y * PANEL_PIXELS; }
+    size_t index(size_t x, size_t y) const {
+        return m_panels.index(x / PANEL_WIDTH, y / PANEL_HEIGHT) * PANEL_PIXELS
+            + m_panel.index(x % PANEL_WIDTH, y % PANEL_HEIGHT);
+    }
+
+private:
+    size_t m_panels_x = 0;
+    size_t m_panels_y = 0;
+    Panel m_panel;
+    Panels m_panels;
+};
+
+// Any wiring, from a table of wire positions in row-major (x, y) order.
+// Until set_table() succeeds, and after a resize to another size, it is row-major.
+class Lookup {
+public:
+    static constexpr bool ROW_CONTIGUOUS = false;
+
+    void resize(size_t width, size_t height);
+    size_t size() const { return m_width * m_height; }
+    size_t index(size_t x, size_t y) const { return m_table[y * m_width + x]; }
+
+    // Needs width * height entries, each wire position used once
+    int set_table(const std::vector<uint32_t>& table);
+
+private:
+    size_t m_width = 0;
+    size_t m_height = 0;
+    std::vector<uint32_t> m_table;
+};
+
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Process wide counters, gauges and latency histograms. Looking a metric up
+// by name takes a lock, so callers do it once and keep the reference;
+// recording is a few relaxed atomic adds and never locks. A histogram has one
+// shard per thread (up to SHARDS, then threads share), merged when read.
+class Metrics {
+public:
+    class Counter {
+    public:
+        void add(uint64_t n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+        uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t> m_value{0};
+    };
+
+    class Gauge {
+    public:
+        void set(double value) { m_value.store(value, std::memory_order_relaxed); }
+        double value() const { return m_value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<double> m_value{0.0};
+    };
+
+    // HDR style: exact below 16, then 16 linear buckets per power of two (at
+    // most 6.25% off), up to 2^36 (about 69 s in ns); larger values land in the last
+    class Histogram {
+    public:
+        static constexpr size_t SUB_BITS = 4;
+        static constexpr size_t SUB = size_t(1) << SUB_BITS;
+        static constexpr size_t MAX_EXPONENT = 36;
+        static constexpr size_t BUCKETS = SUB + (MAX_EXPONENT - SUB_BITS) * SUB;
+        static constexpr size_t SHARDS = 8;
+
+        struct Snapshot {
+            uint64_t count = 0;
+            uint64_t sum = 0;
+            uint64_t max = 0;
+            std::vector<uint64_t> buckets;
+
+            double mean() const { return count ? static_cast<double>(sum) / count : 0.0; }
+            // Highest value of the bucket the q quantile (0..1) falls in
+            uint64_t quantile(double q) const;
+        };
+
+        void record(uint64_t value) {
+            Shard& shard = m_shards[shard_index()];
+            shard.buckets[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+            shard.sum.fetch_add(value, std::memory_order_relaxed);
+            uint64_t max = shard.max.load(std::memory_order_relaxed);
+            while (value > max && !shard.max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+            }
+        }
+        Snapshot snapshot() const;
+        // Not atomic with respect to concurrent record()s, for between runs
+        void reset();
+
+        static size_t bucket(uint64_t value) {
+            if (value < SUB) {
+                return value;
+            }
+            const size_t exponent = 63 - __builtin_clzll(value);
+            if (exponent >= MAX_EXPONENT) {
+                return BUCKETS - 1;
+            }
+            return SUB + (exponent - SUB_BITS) * SUB + ((value >> (exponent - SUB_BITS)) - SUB);
+        }
+        // Smallest and largest value that land in a bucket
+        static uint64_t bucket_low(size_t index);
+        static uint64_t bucket_high(size_t index);
+
+    private:
+        struct alignas(64) Shard {
+            std::atomic<uint64_t> sum{0};
+            std::atomic<uint64_t> max{0};
+            std::array<std::atomic<uint64_t>, BUCKETS> buckets{};
+        };
+
+        static size_t shard_index() {
+            static thread_local const size_t index = s_next_shard.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+            return index;
+        }
+
+        static inline std::atomic<size_t> s_next_shard{0};
+        std::array<Shard, SHARDS> m_shards;
+    };
+
+    // Records the time from construction to destruction, in ns
+    class Timer {
+    public:
+        explicit Timer(Histogram& histogram) : m_histogram(histogram), m_start(now_ns()) {}
+        ~Timer() { m_histogram.record(now_ns() - m_start); }
+
+    private:
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+        Histogram& m_histogram;
+        uint64_t m_start;
+    };
+
+    static Metrics& instance();
+    ~Metrics();
+
+    static uint64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Created on first use, the same object every time after
+    Counter& counter(const std::string& name);
+    Gauge& gauge(const std::string& name);
+    Histogram& histogram(const std::string& name);
+
+    // One metric per line: "name value", histograms with count, mean, quantiles and max
+    void write_text(std::ostream& out) const;
+    void write_json(std::ostream& out) const;
+    // Rewrites path every interval from a background thread, as JSON if it
+    // ends in .json and as text otherwise. Readers never see a partial file.
+    int start_export(const std::string& path, std::chrono::milliseconds interval = std::chrono::seconds(1));
+    void stop_export();
+
+private:
+    Metrics() = default;
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    int write_file(const std::string& path, bool json) const;
+
+private:
+    mutable std::mutex m_mutex;
+    std::map<std::string, std::unique_ptr<Counter> > m_counters;
+    std::map<std::string, std::unique_ptr<Gauge> > m_gauges;
+    std::map<std::string, std::unique_ptr<Histogram> > m_histograms;
+
+    std::thread m_export_thread;
+    std::mutex m_export_mutex;
+    std::condition_variable m_export_cv;
+    bool m_export_stop = false;
+};
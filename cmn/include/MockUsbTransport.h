@@ -0,0 +1,66 @@
+#pragma once
+
+#include <UsbTransport.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <vector>
+
+// In-process stand-in for a USB device. Transfers complete after a configurable
+// latency from handle_events(); failures and unplugging can be injected.
+class MockUsbTransport : public UsbTransport {
+public:
+    MockUsbTransport() = default;
+
+    int open() override;
+    int close() override;
+    bool is_open() override;
+    int submit(UsbTransfer& transfer) override;
+    void release(UsbTransfer&) override {}
+    int handle_events(int timeout_ms) override;
+    // Like hotplug: returns as soon as the device is present
+    bool wait_for_device(int timeout_ms) override;
+
+    void set_latency(std::chrono::microseconds latency);
+    // Fraction (0-1) of transfers that complete with UsbStatus::Error
+    void set_failure_rate(double rate);
+    // The next `count` transfers complete with `status`
+    void fail_next(size_t count, UsbStatus status = UsbStatus::Error);
+    // Unplugged: open() fails and everything in flight completes with NoDevice;
+    // plugging back in wakes wait_for_device()
+    void set_present(bool present);
+    // Without hotplug wait_for_device() always says to try, like a Usb without it
+    void set_hotplug(bool hotplug);
+
+    uint64_t frames_received() const;
+    uint64_t bytes_received() const;
+    uint64_t opens() const;
+    std::vector<uint8_t> last_frame() const;
+
+private:
+    struct InFlight {
+        UsbTransfer* transfer;
+        std::chrono::steady_clock::time_point due;
+        UsbStatus status;
+    };
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<InFlight> m_queue;
+    std::chrono::microseconds m_latency{0};
+    double m_failure_rate = 0.0;
+    size_t m_fail_next = 0;
+    UsbStatus m_fail_status = UsbStatus::Error;
+    bool m_present = true;
+    bool m_hotplug = true;
+    bool m_open = false;
+    uint64_t m_frames = 0;
+    uint64_t m_bytes = 0;
+    uint64_t m_opens = 0;
+    std::vector<uint8_t> m_last_frame;
+    std::mt19937 m_rng{42};
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Everything between a GridData frame and the wire, in one pass that reads
+// the frame once and writes the payload once: per channel gamma and white
+// balance through 8 -> 16 bit tables, global brightness, optional temporal
+// dithering back down to 8 bits, and the frame's current draw for a power cap.
+// The header byte is copied as is. The default config is an exact copy.
+//
+// The power cap scales brightness down from the draw measured on the
+// previous frame. A frame that still comes out over budget (a sudden flash)
+// is scaled down again in place, the only time the payload is touched twice.
+class OutputStage {
+public:
+    struct Config {
+        float gamma = 1.0f;
+        // 0..1
+        float brightness = 1.0f;
+        // white balance, 0..1 per r, g, b
+        std::array<float, 3> balance{1.0f, 1.0f, 1.0f};
+        // carries what 8 bits can't show over to the next frames, per channel
+        bool dither = false;
+        // 0 disables the cap
+        float max_milliamps = 0.0f;
+        // one channel of one LED at full
+        float milliamps_per_channel = 20.0f;
+        // one LED fully off
+        float idle_milliamps = 1.0f;
+    };
+
+    struct Stats {
+        uint64_t frames = 0;
+        // frames the cap had to rescale after the pass
+        uint64_t limited = 0;
+        // draw of the last frame as sent
+        float milliamps = 0.0f;
+        // brightness after the cap, 0..1
+        float scale = 1.0f;
+    };
+
+    OutputStage() { configure(Config{}); }
+
+    void configure(const Config& config);
+    const Config& config() const { return m_config; }
+    // Writes frame.size() bytes to out
+    void process(const std::vector<uint8_t>& frame, uint8_t* out);
+    const Stats& stats() const { return m_stats; }
+
+private:
+    float milliamps(size_t pixels, uint64_t channel_sum) const;
+
+private:
+    Config m_config;
+    // 8.8 fixed point output level per input value, r, g, b one after the other
+    std::array<uint16_t, 3 * 256> m_lut{};
+    // brightness times the cap, 0..65536
+    uint32_t m_scale = 65536;
+    // nothing to do but copy
+    bool m_identity = true;
+    // what dithering carried over, one per frame byte
+    std::vector<uint8_t> m_residual;
+    Stats m_stats;
+};
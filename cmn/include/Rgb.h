@@ -1,16 +1,17 @@
 #pragma once
 #include <cstdint>
+#include <cmath>
 
 struct Rgb {
     uint8_t r = 0;
     uint8_t g = 0;
     uint8_t b = 0;
 };
-Rgb HSVtoRGB(float H, float S,float V){
+inline Rgb HSVtoRGB(float H, float S,float V){
     float s = S/100;
     float v = V/100;
     float C = s*v;
-    float X = C*(1-abs(fmod(H/60.0, 2)-1));
+    float X = C*(1-std::abs(std::fmod(H/60.0f, 2.0f)-1));
     float m = v-C;
     float r,g,b;
     if(H >= 0 && H < 60){
@@ -31,5 +32,5 @@ Rgb HSVtoRGB(float H, float S,float V){
     else{
         r = C,g = 0,b = X;
     }
-    return Rgb{(r+m)*255, (g+m)*255, (b+m)*255};
+    return Rgb{static_cast<uint8_t>((r+m)*255), static_cast<uint8_t>((g+m)*255), static_cast<uint8_t>((b+m)*255)};
 }
\ No newline at end of file
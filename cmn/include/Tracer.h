@@ -0,0 +1,107 @@
+#pragma once
+
+#include <Metrics.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Spans of work per thread, kept in a ring per thread that only its thread
+// writes, and written out as Chrome trace event JSON (chrome://tracing,
+// Perfetto). A span is tagged with the audio frame its thread is working on,
+// see set_frame(). Off by default; a disabled Span is one relaxed load.
+class Tracer {
+public:
+    static constexpr uint64_t NO_FRAME = std::numeric_limits<uint64_t>::max();
+    // events kept per thread, older ones are overwritten
+    static constexpr size_t CAPACITY = size_t(1) << 15;
+
+    // Records from construction to destruction. name must outlive the tracer
+    // (a string literal); the frame is the thread's when the span ends.
+    class Span {
+    public:
+        explicit Span(const char* name) {
+            if (enabled()) {
+                m_name = name;
+                m_start = Metrics::now_ns();
+            }
+        }
+        ~Span() {
+            if (m_name) {
+                instance().record(m_name, m_start, Metrics::now_ns(), t_frame);
+            }
+        }
+
+    private:
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+        const char* m_name = nullptr;
+        uint64_t m_start = 0;
+    };
+
+    static Tracer& instance();
+    ~Tracer();
+
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void set_enabled(bool enabled) { s_enabled.store(enabled, std::memory_order_relaxed); }
+    // Audio frame number the calling thread's spans are tagged with
+    static void set_frame(uint64_t frame) { t_frame = frame; }
+    static uint64_t frame() { return t_frame; }
+    // Shown as the thread's name in the trace; name must outlive the tracer
+    static void set_thread_name(const char* name);
+
+    // A span measured elsewhere, start and end from Metrics::now_ns()
+    void record(const char* name, uint64_t start_ns, uint64_t end_ns, uint64_t frame = NO_FRAME);
+
+    void write_chrome_json(std::ostream& out) const;
+    int dump(const std::string& path) const;
+    // Enables tracing and dumps to path on SIGUSR1, SIGUSR2 toggles tracing
+    int watch(const std::string& path);
+    // Stops watching and writes the final dump
+    void unwatch();
+
+private:
+    struct Event {
+        const char* name;
+        uint64_t start_ns;
+        uint64_t end_ns;
+        uint64_t frame;
+    };
+
+    struct Buffer {
+        std::vector<Event> events;
+        // events ever written; only the owning thread stores it
+        std::atomic<uint64_t> head{0};
+        std::atomic<const char*> name{nullptr};
+        uint32_t tid = 0;
+    };
+
+    Tracer() = default;
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    Buffer& buffer();
+
+private:
+    static inline std::atomic<bool> s_enabled{false};
+    static inline thread_local uint64_t t_frame = NO_FRAME;
+    static inline thread_local Buffer* t_buffer = nullptr;
+    static inline thread_local const char* t_name = nullptr;
+
+    const uint64_t m_epoch_ns = Metrics::now_ns();
+    mutable std::mutex m_mutex;
+    // kept after their thread exits so its spans still get dumped
+    std::vector<std::unique_ptr<Buffer> > m_buffers;
+
+    std::string m_path;
+    std::thread m_watch_thread;
+    std::atomic<bool> m_watch_stop{false};
+};
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <UsbTransport.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -7,10 +12,12 @@
 struct libusb_context;
 struct libusb_device;
 struct libusb_device_handle;
-class Usb {
+class Usb : public UsbTransport {
 public:
     Usb() = default;
     Usb(uint64_t m_vendor_id, uint64_t m_product_id);
+    // Only opens the device with this serial number (any if empty)
+    Usb(uint64_t m_vendor_id, uint64_t m_product_id, const std::string& serial);
     virtual ~Usb();
     Usb(Usb&& other) noexcept;
 
@@ -18,21 +25,57 @@ public:
     Usb& operator=(Usb&& other) noexcept;
 
 public:
-    int open();
-    int write_and_reopen(std::vector<uint8_t>& data, int timeout_ms = 1000, bool is_retry = false);
-    bool is_open();
-    int close();
+    // CANT SEND DATA SMALLER THAN 7 BYTES
+    static constexpr size_t MIN_TRANSFER_SIZE = 8;
+    // Copies a frame into a transfer buffer, zero padded up to MIN_TRANSFER_SIZE
+    static void pack(const std::vector<uint8_t>& frame, std::vector<uint8_t>& out);
+    // Serial numbers of every connected device matching vendor_id/product_id
+    static int list_serials(std::vector<std::string>& serials, uint64_t vendor_id = 0x16c0,
+        uint64_t product_id = 0x0483);
+    // Serial number of the open device
+    const std::string& serial() const { return m_opened_serial; }
+
+    int open() override;
+    // Blocking write. After a failure the device is closed, and the next call
+    // opens it again once it's back; it never re-enumerates right after an error.
+    int write_and_reopen(std::vector<uint8_t>& data, int timeout_ms = 1000);
+    bool is_open() override;
+    int close() override;
+    // With hotplug and the device gone (unplugged, or not found by open()),
+    // pumps libusb events until a matching device arrives (also trying every
+    // few seconds in case an arrival was missed); otherwise says to try
+    bool wait_for_device(int timeout_ms) override;
+    // Called from libusb's hotplug callback, only records what happened
+    void on_hotplug(libusb_device* device, bool arrived);
+
+    // Asynchronous bulk transfers (libusb_submit_transfer), completed from handle_events()
+    int submit(UsbTransfer& transfer) override;
+    void release(UsbTransfer& transfer) override;
+    int handle_events(int timeout_ms) override;
 
 private:
     Usb(const Usb& other) = delete;
     Usb& operator=(const Usb& other) = delete;
 
+    void register_hotplug();
+    void deregister_hotplug();
 
 private:
     uint64_t m_vendor_id = 0x16c0;
     uint64_t m_product_id = 0x0483;
+    std::string m_serial;
+    std::string m_opened_serial;
+    // shared by every Usb, never torn down
     libusb_context* m_ctx = nullptr;
-    libusb_device** m_list = nullptr;
+    // the open device, referenced so hotplug can tell it left
+    std::atomic<libusb_device*> m_device{nullptr};
     libusb_device_handle* m_dev_handle = nullptr;
+    int m_hotplug_handle = 0;
+    bool m_hotplug = false;
+    // set by the hotplug callback, true at first so the first open() is tried
+    std::atomic<bool> m_arrived{true};
+    // the device was unplugged or open() didn't find it, cleared by a successful open()
+    std::atomic<bool> m_left{false};
+    std::chrono::steady_clock::time_point m_last_attempt{};
     unsigned char m_out_endpoint_address = 0;
 };
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <FrameEncoder.h>
+#include <OutputStage.h>
+#include <UsbTransport.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Non-blocking frame output. send() copies the frame into one of N transfer
+// buffers and submits it; completions, errors and reconnects are handled on a
+// dedicated event thread so a USB hiccup never stalls the caller. When every
+// buffer is in flight the newest frame waits in a single pending slot (older
+// pending frames are dropped). While disconnected frames are dropped and counted.
+// With WireFormat::Delta frames are encoded right before they are submitted, so
+// each delta is relative to the previously submitted frame; any failed transfer
+// or reconnect forces a keyframe. Every frame goes through the OutputStage
+// (gamma, brightness, dithering, power cap) on its way into the transfer buffer.
+class UsbOutput {
+public:
+    enum class WireFormat {
+        Raw,    // v1, the whole frame every time
+        Delta,  // v2, see FrameDecoder.h
+        Numbered,  // v3, the whole frame with the number given to send()
+    };
+
+    struct Stats {
+        uint64_t submitted = 0;
+        uint64_t completed = 0;
+        uint64_t failed = 0;
+        uint64_t dropped = 0;
+        uint64_t reconnects = 0;
+        size_t in_flight = 0;
+        bool connected = false;
+        // bytes handed to the transport and what v1 would have needed for the same frames
+        uint64_t bytes_sent = 0;
+        uint64_t raw_bytes = 0;
+        uint64_t keyframes = 0;
+        // frames not sent because nothing changed
+        uint64_t unchanged = 0;
+        // see OutputStage::Stats
+        float milliamps = 0.0f;
+        float output_scale = 1.0f;
+        uint64_t power_limited = 0;
+    };
+
+    UsbOutput(std::unique_ptr<UsbTransport> transport, size_t max_in_flight = 2);
+    virtual ~UsbOutput();
+
+    int start();
+    void stop();
+    // frame is v1 (header byte + rgb); frame_number is only sent with WireFormat::Numbered.
+    // origin_ns is when the audio it shows was captured (Metrics::now_ns()),
+    // for the latency.usb_ns and latency.total_ns histograms; 0 if unknown.
+    bool send(const std::vector<uint8_t>& frame, uint16_t frame_number = 0, uint64_t origin_ns = 0);
+    // Connected, with a transfer buffer free so send() goes out right away
+    bool ready() const;
+    bool connected() const { return m_connected.load(); }
+    Stats stats() const;
+    UsbTransport& transport() { return *m_transport; }
+    // Only while stopped, e.g. a MockUsbTransport instead of the device
+    int set_transport(std::unique_ptr<UsbTransport> transport);
+    void set_timeout(int timeout_ms) { m_timeout_ms = timeout_ms; }
+    void set_wire_format(WireFormat format, size_t keyframe_interval = 120);
+    void set_output_stage(const OutputStage::Config& config);
+
+private:
+    UsbOutput(const UsbOutput&) = delete;
+    UsbOutput& operator=(const UsbOutput&) = delete;
+
+    void event_thread();
+    void reconnect();
+    void drain();
+    void on_complete(size_t slot, UsbTransfer& transfer);
+    bool encode_locked(const std::vector<uint8_t>& frame, uint16_t frame_number, size_t slot);
+    bool submit_locked(size_t slot);
+
+private:
+    struct Slot {
+        UsbTransfer transfer;
+        bool busy = false;
+    };
+
+    std::unique_ptr<UsbTransport> m_transport;
+    std::vector<std::unique_ptr<Slot> > m_slots;
+    std::vector<uint8_t> m_pending;
+    uint16_t m_pending_number = 0;
+    uint64_t m_pending_trace_frame = 0;
+    uint64_t m_pending_origin_ns = 0;
+    bool m_has_pending = false;
+    WireFormat m_wire_format = WireFormat::Raw;
+    OutputStage m_stage;
+    // the frame after the output stage, for the delta encoder
+    std::vector<uint8_t> m_staged;
+    FrameEncoder m_encoder;
+    std::vector<uint8_t> m_encoded;
+    uint64_t m_bytes_sent = 0;
+    uint64_t m_raw_bytes = 0;
+    size_t m_in_flight = 0;
+    int m_timeout_ms = 1000;
+    std::chrono::milliseconds m_reconnect_delay{250};
+    bool m_was_connected = false;
+    mutable std::mutex m_mutex;
+    std::thread m_thread;
+    std::atomic_bool m_stop = true;
+    std::atomic_bool m_connected = false;
+    std::atomic<uint64_t> m_submitted = 0;
+    std::atomic<uint64_t> m_completed = 0;
+    std::atomic<uint64_t> m_failed = 0;
+    std::atomic<uint64_t> m_dropped = 0;
+    std::atomic<uint64_t> m_reconnects = 0;
+};
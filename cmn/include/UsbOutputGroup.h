@@ -0,0 +1,144 @@
+#pragma once
+
+#include <GridData.h>
+#include <GridLayout.h>
+#include <UsbOutput.h>
+#include <FrameDecoder.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One grid driven by several controllers, each showing a rectangular tile of
+// it. Every panel has its own UsbOutput (own transfers and event thread), so
+// the tiles of a frame are written in parallel. Tiles go out as numbered v3
+// frames, and a frame is only sent when every connected panel can take it
+// right away, so all controllers get the same frame numbers and can latch
+// them together; a panel that is behind holds the whole group back.
+class UsbOutputGroup {
+public:
+    struct Panel {
+        // the controller's USB serial number
+        std::string serial;
+        size_t x = 0;
+        size_t y = 0;
+        size_t width = 0;
+        size_t height = 0;
+        // How the controller's LEDs are chained, see GridLayout.h
+        enum class Wiring { RowMajor, Serpentine, ColumnSerpentine };
+        Wiring wiring = Wiring::RowMajor;
+        // Any other wiring: the wire position of each tile pixel in row-major
+        // order, as for layout::Lookup; overrides wiring when not empty
+        std::vector<uint32_t> table;
+    };
+
+    struct PanelStats {
+        Panel panel;
+        UsbOutput::Stats output;
+    };
+
+    explicit UsbOutputGroup(size_t max_in_flight = 2) : m_max_in_flight(max_in_flight) {}
+    virtual ~UsbOutputGroup();
+
+    // "serial@x,y,wxh[:wiring];serial@x,y,wxh..." with wiring rows (default),
+    // serpentine or columns (column serpentine)
+    static int parse_panels(const std::string& spec, std::vector<Panel>& panels);
+
+    // A panel written through the given transport (a Usb, or a mock)
+    int add_panel(const Panel& panel, std::unique_ptr<UsbTransport> transport);
+    // Every connected device matching vendor_id/product_id, each mapped to the
+    // panel with its serial number; devices without a panel are left alone
+    int add_devices(const std::vector<Panel>& panels, uint64_t vendor_id = 0x16c0, uint64_t product_id = 0x0483);
+    size_t num_panels() const { return m_panels.size(); }
+    // Smallest grid covering every panel
+    size_t width() const;
+    size_t height() const;
+
+    int start();
+    void stop();
+    // max_milliamps is the budget of the whole group, split across the panels by pixel count
+    void set_output_stage(const OutputStage::Config& config);
+    // Cuts the grid into tiles and sends them all, or none if some connected
+    // panel is still busy; returns whether the frame went out. origin_ns as
+    // for UsbOutput::send(). Each tile is packed straight into its panel's
+    // wire order from any grid layout, whole rows at a time when both are
+    // row-major.
+    template <typename Layout>
+    bool send(BasicGridData<Layout>& grid, uint64_t origin_ns = 0);
+
+    uint16_t frame_number() const { return m_frame_number; }
+    // frames held back because a panel was busy
+    uint64_t skipped() const { return m_skipped; }
+    std::vector<PanelStats> stats() const;
+
+private:
+    UsbOutputGroup(const UsbOutputGroup&) = delete;
+    UsbOutputGroup& operator=(const UsbOutputGroup&) = delete;
+
+    // Wire position of each tile pixel for panel.wiring, row-major order
+    static std::vector<uint32_t> wiring_table(const Panel& panel);
+    // Every connected panel can take a frame, and there is at least one
+    bool can_send();
+    // Sends every panel's tile under the next frame number
+    void send_tiles(uint64_t origin_ns);
+
+    struct Entry {
+        Panel panel;
+        std::unique_ptr<UsbOutput> output;
+        // the panel's wiring, as a table of wire positions
+        layout::Lookup layout;
+        bool row_major = true;
+        // v1 frame of the tile, in the panel's wire order
+        std::vector<uint8_t> frame;
+    };
+
+private:
+    size_t m_max_in_flight;
+    std::vector<Entry> m_panels;
+    OutputStage::Config m_stage;
+    uint16_t m_frame_number = 0;
+    uint64_t m_skipped = 0;
+    bool m_running = false;
+};
+
+template <typename Layout>
+bool UsbOutputGroup::send(BasicGridData<Layout>& grid, uint64_t origin_ns) {
+    if (!can_send()) {
+        return false;
+    }
+    const size_t bpp = frame_format::BYTES_PER_PIXEL;
+    for (auto& entry : m_panels) {
+        const Panel& panel = entry.panel;
+        uint8_t* tile = entry.frame.data() + 1;
+        const size_t visible = panel.x < grid.width() ? std::min(panel.width, grid.width() - panel.x) : 0;
+        for (size_t row = 0; row < panel.height; ++row) {
+            const size_t y = panel.y + row;
+            const size_t shown = y < grid.height() ? visible : 0;
+            if (Layout::ROW_CONTIGUOUS && entry.row_major) {
+                uint8_t* out = tile + row * panel.width * bpp;
+                if (shown > 0) {
+                    std::memcpy(out, grid.get_raw(panel.x, y), shown * bpp);
+                }
+                std::memset(out + shown * bpp, 0, (panel.width - shown) * bpp);
+                continue;
+            }
+            for (size_t col = 0; col < panel.width; ++col) {
+                uint8_t* out = tile + entry.layout.index(col, row) * bpp;
+                if (col < shown) {
+                    const uint8_t* in = grid.get_raw(panel.x + col, y);
+                    out[0] = in[0];
+                    out[1] = in[1];
+                    out[2] = in[2];
+                } else {
+                    out[0] = out[1] = out[2] = 0;
+                }
+            }
+        }
+    }
+    send_tiles(origin_ns);
+    return true;
+}
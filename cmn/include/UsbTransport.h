@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+enum class UsbStatus {
+    Completed,
+    Error,
+    TimedOut,
+    Cancelled,
+    NoDevice,
+};
+
+// One bulk OUT transfer. Owned by the caller and reused; the transport keeps
+// whatever native state it needs in `native` until release() is called.
+struct UsbTransfer {
+    std::vector<uint8_t> buffer;
+    size_t length = 0;
+    int timeout_ms = 1000;
+    UsbStatus status = UsbStatus::Completed;
+    size_t actual_length = 0;
+    // Called from handle_events() once the transfer is done
+    std::function<void(UsbTransfer&)> on_complete;
+    void* native = nullptr;
+    // Metrics::now_ns() when it was last submitted
+    uint64_t submitted_ns = 0;
+    // audio frame it carries, for Tracer (Tracer::NO_FRAME if none)
+    uint64_t trace_frame = std::numeric_limits<uint64_t>::max();
+    // Metrics::now_ns() time the audio it shows was captured at, 0 if unknown
+    uint64_t origin_ns = 0;
+};
+
+// Something frames can be written to: the real libusb device or a mock.
+class UsbTransport {
+public:
+    virtual ~UsbTransport() = default;
+    virtual int open() = 0;
+    virtual int close() = 0;
+    virtual bool is_open() = 0;
+    // Queues the transfer and returns immediately, < 0 if it could not be queued
+    virtual int submit(UsbTransfer& transfer) = 0;
+    // Frees native state attached to a transfer that is no longer in flight
+    virtual void release(UsbTransfer& transfer) = 0;
+    // Runs completion callbacks, waiting at most timeout_ms for one to happen
+    virtual int handle_events(int timeout_ms) = 0;
+    // While closed: waits at most timeout_ms for a device open() can succeed
+    // on and returns whether to try. Transports that can't tell say yes right
+    // away and open() gets polled.
+    virtual bool wait_for_device(int /*timeout_ms*/) { return true; }
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each with its own task queue. Tasks submitted
+// from outside the pool are spread round robin; tasks submitted from a worker
+// go on its own queue. A worker takes from the front of its queue and, when
+// that is empty, steals from the back of the others before going to sleep.
+class WorkerPool {
+public:
+    using Task = std::function<void()>;
+
+    struct Stats {
+        uint64_t executed = 0;
+        uint64_t stolen = 0;
+    };
+
+    // 0 threads means one per core
+    explicit WorkerPool(size_t num_threads = 0);
+    ~WorkerPool();
+
+    void submit(Task task);
+    size_t size() const { return m_workers.size(); }
+    // Index of the calling worker, or -1 outside the pool
+    int current_worker() const;
+    std::vector<Stats> stats() const;
+
+private:
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    struct Worker {
+        std::thread thread;
+        mutable std::mutex mutex;
+        std::deque<Task> tasks;
+        std::atomic<uint64_t> executed{0};
+        std::atomic<uint64_t> stolen{0};
+    };
+
+    void run(size_t index);
+    bool take(size_t index, Task& task);
+
+private:
+    std::vector<std::unique_ptr<Worker> > m_workers;
+    std::atomic<size_t> m_next{0};
+    std::atomic<size_t> m_pending{0};
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_sleep;
+    bool m_stop = false;
+};
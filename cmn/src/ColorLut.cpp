@@ -0,0 +1,50 @@
+#include <ColorLut.h>
+
+#include <algorithm>
+
+namespace color {
+
+// Pixels per block: the hue index and saturation/value passes run over plain
+// arrays the compiler can vectorize, leaving the wheel lookup on its own
+static const size_t BLOCK = 64;
+
+void hsv_to_rgb(std::span<const float> hue, std::span<const float> saturation, std::span<const float> value,
+        uint8_t* rgb) {
+    const bool each_s = saturation.size() > 1;
+    const bool each_v = value.size() > 1;
+    const uint32_t one_s = saturation.empty() ? 0 : percent_to_q8(saturation[0]);
+    const uint32_t one_v = value.empty() ? 0 : percent_to_q8(value[0]);
+    size_t total = hue.size();
+    if (each_s) {
+        total = std::min(total, saturation.size());
+    }
+    if (each_v) {
+        total = std::min(total, value.size());
+    }
+
+    uint32_t index[BLOCK];
+    // value and value * saturation, so each channel is one multiply and a shift
+    uint32_t base[BLOCK];
+    uint32_t slope[BLOCK];
+    for (size_t start = 0; start < total; start += BLOCK) {
+        const size_t count = std::min(BLOCK, total - start);
+        for (size_t i = 0; i < count; ++i) {
+            index[i] = hue_index(hue[start + i]);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            const uint32_t s = each_s ? percent_to_q8(saturation[start + i]) : one_s;
+            const uint32_t v = each_v ? percent_to_q8(value[start + i]) : one_v;
+            base[i] = v * 65280 + 32768;
+            slope[i] = v * s;
+        }
+        uint8_t* out = rgb + start * 3;
+        for (size_t i = 0; i < count; ++i) {
+            const Rgb& full = HUE_WHEEL[index[i]];
+            out[i * 3] = static_cast<uint8_t>((base[i] - slope[i] * (255u - full.r)) >> 16);
+            out[i * 3 + 1] = static_cast<uint8_t>((base[i] - slope[i] * (255u - full.g)) >> 16);
+            out[i * 3 + 2] = static_cast<uint8_t>((base[i] - slope[i] * (255u - full.b)) >> 16);
+        }
+    }
+}
+
+}
@@ -0,0 +1,165 @@
+#include <ComponentEngine.h>
+
+#include <algorithm>
+
+void ComponentEngine::reset(size_t width, size_t height) {
+    m_width = width;
+    m_height = height;
+    m_tiles_x = (width + TILE - 1) / TILE;
+    m_tiles_y = (height + TILE - 1) / TILE;
+    // a new grid has to be drawn whole once
+    m_dirty.assign(m_tiles_x * m_tiles_y, 1);
+}
+
+void ComponentEngine::reserve(size_t count) {
+    m_x.reserve(count);
+    m_y.reserve(count);
+    m_w.reserve(count);
+    m_h.reserve(count);
+    m_vx.reserve(count);
+    m_vy.reserve(count);
+    m_r.reserve(count);
+    m_g.reserve(count);
+    m_b.reserve(count);
+    m_vr.reserve(count);
+    m_vg.reserve(count);
+    m_vb.reserve(count);
+    m_flags.reserve(count);
+    m_getters.reserve(count);
+}
+
+void ComponentEngine::add(const GridComponent& component) {
+    m_x.push_back(static_cast<float>(component.top_left_high.x));
+    m_y.push_back(static_cast<float>(component.top_left_high.y));
+    m_w.push_back(static_cast<uint16_t>(std::min<size_t>(component.size.x, UINT16_MAX)));
+    m_h.push_back(static_cast<uint16_t>(std::min<size_t>(component.size.y, UINT16_MAX)));
+    m_vx.push_back(component.position_velocity.x);
+    m_vy.push_back(component.position_velocity.y);
+    m_r.push_back(component.center_color.r);
+    m_g.push_back(component.center_color.g);
+    m_b.push_back(component.center_color.b);
+    m_vr.push_back(component.rgb_velocity.x);
+    m_vg.push_back(component.rgb_velocity.y);
+    m_vb.push_back(component.rgb_velocity.z);
+    m_flags.push_back((component.visible ? VISIBLE : 0) | (component.kill_when_dead ? KILL_WHEN_DEAD : 0));
+    m_getters.push_back(component.color_getter);
+    if (component.visible) {
+        mark(rect(size() - 1));
+    }
+}
+
+void ComponentEngine::clear() {
+    for (size_t i = 0; i < size(); ++i) {
+        if (m_flags[i] & VISIBLE) {
+            mark(rect(i));
+        }
+    }
+    m_x.clear();
+    m_y.clear();
+    m_w.clear();
+    m_h.clear();
+    m_vx.clear();
+    m_vy.clear();
+    m_r.clear();
+    m_g.clear();
+    m_b.clear();
+    m_vr.clear();
+    m_vg.clear();
+    m_vb.clear();
+    m_flags.clear();
+    m_getters.clear();
+}
+
+void ComponentEngine::mark(const Rect& r) {
+    const int32_t x0 = std::max(r.x0, 0);
+    const int32_t y0 = std::max(r.y0, 0);
+    const int32_t x1 = std::min(r.x1, static_cast<int32_t>(m_width));
+    const int32_t y1 = std::min(r.y1, static_cast<int32_t>(m_height));
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+    for (size_t ty = y0 / TILE; ty <= (y1 - 1) / TILE; ++ty) {
+        for (size_t tx = x0 / TILE; tx <= (x1 - 1) / TILE; ++tx) {
+            m_dirty[ty * m_tiles_x + tx] = 1;
+        }
+    }
+}
+
+void ComponentEngine::move(size_t from, size_t to) {
+    m_x[to] = m_x[from];
+    m_y[to] = m_y[from];
+    m_w[to] = m_w[from];
+    m_h[to] = m_h[from];
+    m_vx[to] = m_vx[from];
+    m_vy[to] = m_vy[from];
+    m_r[to] = m_r[from];
+    m_g[to] = m_g[from];
+    m_b[to] = m_b[from];
+    m_vr[to] = m_vr[from];
+    m_vg[to] = m_vg[from];
+    m_vb[to] = m_vb[from];
+    m_flags[to] = m_flags[from];
+    m_getters[to] = std::move(m_getters[from]);
+}
+
+void ComponentEngine::step(float dt) {
+    const size_t count = size();
+    const int32_t width = static_cast<int32_t>(m_width);
+    const int32_t height = static_cast<int32_t>(m_height);
+    size_t alive = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const Rect before = rect(i);
+        const uint8_t r0 = quantize(m_r[i]);
+        const uint8_t g0 = quantize(m_g[i]);
+        const uint8_t b0 = quantize(m_b[i]);
+
+        m_x[i] += m_vx[i] * dt;
+        m_y[i] += m_vy[i] * dt;
+        m_r[i] = std::clamp(m_r[i] + m_vr[i] * dt, 0.0f, 255.0f);
+        m_g[i] = std::clamp(m_g[i] + m_vg[i] * dt, 0.0f, 255.0f);
+        m_b[i] = std::clamp(m_b[i] + m_vb[i] * dt, 0.0f, 255.0f);
+        const Rect after = rect(i);
+
+        // faded out for good, or off the grid and moving away from it
+        const bool faded = m_r[i] <= 0.0f && m_g[i] <= 0.0f && m_b[i] <= 0.0f && !m_getters[i]
+            && m_vr[i] <= 0.0f && m_vg[i] <= 0.0f && m_vb[i] <= 0.0f;
+        const bool gone = (after.x1 <= 0 && m_vx[i] <= 0.0f) || (after.x0 >= width && m_vx[i] >= 0.0f)
+            || (after.y1 <= 0 && m_vy[i] <= 0.0f) || (after.y0 >= height && m_vy[i] >= 0.0f);
+        const bool dead = (faded || gone) && (m_flags[i] & KILL_WHEN_DEAD);
+
+        if (m_flags[i] & VISIBLE) {
+            if (dead) {
+                mark(before);
+            } else if (m_getters[i] || before.x0 != after.x0 || before.y0 != after.y0
+                    || r0 != quantize(m_r[i]) || g0 != quantize(m_g[i]) || b0 != quantize(m_b[i])) {
+                mark(before);
+                mark(after);
+            }
+        }
+        if (dead) {
+            continue;
+        }
+        if (alive != i) {
+            move(i, alive);
+        }
+        alive++;
+    }
+    if (alive == count) {
+        return;
+    }
+    // shrinking keeps the capacity
+    m_x.resize(alive);
+    m_y.resize(alive);
+    m_w.resize(alive);
+    m_h.resize(alive);
+    m_vx.resize(alive);
+    m_vy.resize(alive);
+    m_r.resize(alive);
+    m_g.resize(alive);
+    m_b.resize(alive);
+    m_vr.resize(alive);
+    m_vg.resize(alive);
+    m_vb.resize(alive);
+    m_flags.resize(alive);
+    m_getters.resize(alive);
+}
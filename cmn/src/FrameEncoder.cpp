@@ -0,0 +1,119 @@
+#include <FrameEncoder.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace frame_format;
+
+// Unchanged pixels cheaper to resend than to start a new span for
+static const size_t MERGE_GAP = SPAN_HEADER_SIZE / BYTES_PER_PIXEL;
+static const size_t MAX_SPAN = 0xFFFF;
+
+void FrameEncoder::write_header(std::vector<uint8_t>& out, bool keyframe, uint16_t spans) {
+    out[0] = V2_HEADER;
+    out[1] = keyframe ? FLAG_KEYFRAME : 0;
+    out[2] = m_sequence & 0xFF;
+    out[3] = m_sequence >> 8;
+    out[4] = spans & 0xFF;
+    out[5] = spans >> 8;
+}
+
+void FrameEncoder::write_span(std::vector<uint8_t>& out, const uint8_t* pixels, size_t offset, size_t count) {
+    size_t pos = out.size();
+    out.resize(pos + SPAN_HEADER_SIZE + count * BYTES_PER_PIXEL);
+    out[pos] = offset & 0xFF;
+    out[pos + 1] = (offset >> 8) & 0xFF;
+    out[pos + 2] = count & 0xFF;
+    out[pos + 3] = (count >> 8) & 0xFF;
+    std::memcpy(&out[pos + SPAN_HEADER_SIZE], pixels + offset * BYTES_PER_PIXEL, count * BYTES_PER_PIXEL);
+}
+
+void FrameEncoder::encode_keyframe(const uint8_t* pixels, size_t num_pixels, std::vector<uint8_t>& out) {
+    out.resize(V2_HEADER_SIZE);
+    uint16_t spans = 0;
+    for (size_t offset = 0; offset < num_pixels; offset += MAX_SPAN) {
+        write_span(out, pixels, offset, std::min(MAX_SPAN, num_pixels - offset));
+        spans++;
+    }
+    write_header(out, true, spans);
+    m_since_keyframe = 0;
+    m_force_keyframe = false;
+    m_stats.keyframes++;
+}
+
+bool FrameEncoder::encode(const std::vector<uint8_t>& frame, std::vector<uint8_t>& out) {
+    const size_t num_pixels = frame.empty() ? 0 : (frame.size() - 1) / BYTES_PER_PIXEL;
+    const uint8_t* pixels = frame.data() + 1;
+    if (num_pixels > MAX_SPAN + 1) {
+        // offsets don't fit in 16 bits, v1 it is
+        out = frame;
+        m_force_keyframe = true;
+        m_stats.frames++;
+        m_stats.bytes += out.size();
+        m_stats.raw_bytes += frame.size();
+        m_stats.last_bytes = out.size();
+        return true;
+    }
+    const size_t frame_bytes = num_pixels * BYTES_PER_PIXEL;
+    if (m_reference.size() != frame_bytes) {
+        m_reference.assign(frame_bytes, 0);
+        m_force_keyframe = true;
+    }
+
+    m_sequence++;
+    if (m_force_keyframe || ++m_since_keyframe >= m_keyframe_interval) {
+        encode_keyframe(pixels, num_pixels, out);
+    } else {
+        out.resize(V2_HEADER_SIZE);
+        const uint8_t* ref = m_reference.data();
+        size_t spans = 0;
+        size_t i = 0;
+        while (i < num_pixels) {
+            // skip unchanged pixels eight at a time
+            while (i + 8 <= num_pixels && std::memcmp(pixels + i * BYTES_PER_PIXEL, ref + i * BYTES_PER_PIXEL, 8 * BYTES_PER_PIXEL) == 0) {
+                i += 8;
+            }
+            while (i < num_pixels && std::memcmp(pixels + i * BYTES_PER_PIXEL, ref + i * BYTES_PER_PIXEL, BYTES_PER_PIXEL) == 0) {
+                i++;
+            }
+            if (i >= num_pixels) {
+                break;
+            }
+            size_t start = i;
+            size_t end = i + 1;
+            size_t gap = 0;
+            for (i = end; i < num_pixels && end - start < MAX_SPAN; ++i) {
+                if (std::memcmp(pixels + i * BYTES_PER_PIXEL, ref + i * BYTES_PER_PIXEL, BYTES_PER_PIXEL) != 0) {
+                    end = i + 1;
+                    gap = 0;
+                } else if (++gap > MERGE_GAP) {
+                    break;
+                }
+            }
+            write_span(out, pixels, start, end - start);
+            spans++;
+            i = end;
+            if (out.size() >= V2_HEADER_SIZE + SPAN_HEADER_SIZE + frame_bytes || spans == MAX_SPAN) {
+                break;
+            }
+        }
+        if (spans == 0) {
+            // nothing to send, the receiver still expects m_sequence next
+            m_sequence--;
+            m_since_keyframe--;
+            m_stats.unchanged++;
+            return false;
+        }
+        if (out.size() >= V2_HEADER_SIZE + SPAN_HEADER_SIZE + frame_bytes || spans == MAX_SPAN) {
+            encode_keyframe(pixels, num_pixels, out);
+        } else {
+            write_header(out, false, spans);
+        }
+    }
+    std::memcpy(m_reference.data(), pixels, frame_bytes);
+    m_stats.frames++;
+    m_stats.bytes += out.size();
+    m_stats.raw_bytes += frame.size();
+    m_stats.last_bytes = out.size();
+    return true;
+}
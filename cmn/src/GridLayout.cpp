@@ -0,0 +1,37 @@
+#include <GridLayout.h>
+
+#include <spdlog/spdlog.h>
+
+namespace layout {
+
+void Lookup::resize(size_t width, size_t height) {
+    if (width == m_width && height == m_height && m_table.size() == width * height) {
+        return;
+    }
+    m_width = width;
+    m_height = height;
+    m_table.resize(width * height);
+    for (size_t i = 0; i < m_table.size(); ++i) {
+        m_table[i] = static_cast<uint32_t>(i);
+    }
+}
+
+int Lookup::set_table(const std::vector<uint32_t>& table) {
+    if (table.size() != m_width * m_height) {
+        spdlog::error("Layout table has {} entries, the grid {}x{} needs {}", table.size(), m_width, m_height,
+            m_width * m_height);
+        return -1;
+    }
+    std::vector<bool> used(table.size(), false);
+    for (uint32_t position : table) {
+        if (position >= table.size() || used[position]) {
+            spdlog::error("Layout table position {} is out of range or used twice", position);
+            return -1;
+        }
+        used[position] = true;
+    }
+    m_table = table;
+    return 0;
+}
+
+}
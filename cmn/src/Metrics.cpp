@@ -0,0 +1,205 @@
+#include <Metrics.h>
+
+#include "spdlog/spdlog.h"
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+
+// Quantiles written for every histogram
+static const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+static const char* QUANTILE_NAMES[] = {"p50", "p90", "p99", "p999"};
+
+uint64_t Metrics::Histogram::bucket_low(size_t index) {
+    if (index < SUB) {
+        return index;
+    }
+    const size_t exponent = (index - SUB) / SUB + SUB_BITS;
+    const uint64_t mantissa = (index - SUB) % SUB + SUB;
+    return mantissa << (exponent - SUB_BITS);
+}
+
+uint64_t Metrics::Histogram::bucket_high(size_t index) {
+    if (index + 1 >= BUCKETS) {
+        return std::numeric_limits<uint64_t>::max();
+    }
+    return bucket_low(index + 1) - 1;
+}
+
+Metrics::Histogram::Snapshot Metrics::Histogram::snapshot() const {
+    Snapshot snapshot;
+    snapshot.buckets.assign(BUCKETS, 0);
+    for (const auto& shard : m_shards) {
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            const uint64_t n = shard.buckets[i].load(std::memory_order_relaxed);
+            snapshot.buckets[i] += n;
+            snapshot.count += n;
+        }
+        snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+        snapshot.max = std::max(snapshot.max, shard.max.load(std::memory_order_relaxed));
+    }
+    return snapshot;
+}
+
+void Metrics::Histogram::reset() {
+    for (auto& shard : m_shards) {
+        for (auto& bucket : shard.buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        shard.sum.store(0, std::memory_order_relaxed);
+        shard.max.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t Metrics::Histogram::Snapshot::quantile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * count)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min(bucket_high(i), max);
+        }
+    }
+    return max;
+}
+
+Metrics& Metrics::instance() {
+    static Metrics metrics;
+    return metrics;
+}
+
+Metrics::~Metrics() {
+    stop_export();
+}
+
+template <typename T>
+static T& find_or_add(std::map<std::string, std::unique_ptr<T> >& metrics, const std::string& name) {
+    auto& metric = metrics[name];
+    if (!metric) {
+        metric = std::make_unique<T>();
+    }
+    return *metric;
+}
+
+Metrics::Counter& Metrics::counter(const std::string& name) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return find_or_add(m_counters, name);
+}
+
+Metrics::Gauge& Metrics::gauge(const std::string& name) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return find_or_add(m_gauges, name);
+}
+
+Metrics::Histogram& Metrics::histogram(const std::string& name) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return find_or_add(m_histograms, name);
+}
+
+void Metrics::write_text(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& [name, counter] : m_counters) {
+        out << fmt::format("{} {}\n", name, counter->value());
+    }
+    for (const auto& [name, gauge] : m_gauges) {
+        out << fmt::format("{} {:.3f}\n", name, gauge->value());
+    }
+    for (const auto& [name, histogram] : m_histograms) {
+        const auto snapshot = histogram->snapshot();
+        out << fmt::format("{} count={} mean={:.1f}", name, snapshot.count, snapshot.mean());
+        for (size_t i = 0; i < std::size(QUANTILES); ++i) {
+            out << fmt::format(" {}={}", QUANTILE_NAMES[i], snapshot.quantile(QUANTILES[i]));
+        }
+        out << fmt::format(" max={}\n", snapshot.max);
+    }
+}
+
+void Metrics::write_json(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // names are plain ascii identifiers, no escaping needed
+    out << "{\n  \"counters\": {";
+    const char* separator = "\n";
+    for (const auto& [name, counter] : m_counters) {
+        out << fmt::format("{}    \"{}\": {}", separator, name, counter->value());
+        separator = ",\n";
+    }
+    out << "\n  },\n  \"gauges\": {";
+    separator = "\n";
+    for (const auto& [name, gauge] : m_gauges) {
+        const double value = gauge->value();
+        out << fmt::format("{}    \"{}\": {:.3f}", separator, name, std::isfinite(value) ? value : 0.0);
+        separator = ",\n";
+    }
+    out << "\n  },\n  \"histograms\": {";
+    separator = "\n";
+    for (const auto& [name, histogram] : m_histograms) {
+        const auto snapshot = histogram->snapshot();
+        out << fmt::format("{}    \"{}\": {{\"count\": {}, \"mean\": {:.1f}", separator, name, snapshot.count, snapshot.mean());
+        for (size_t i = 0; i < std::size(QUANTILES); ++i) {
+            out << fmt::format(", \"{}\": {}", QUANTILE_NAMES[i], snapshot.quantile(QUANTILES[i]));
+        }
+        out << fmt::format(", \"max\": {}}}", snapshot.max);
+        separator = ",\n";
+    }
+    out << "\n  }\n}\n";
+}
+
+int Metrics::write_file(const std::string& path, bool json) const {
+    // written next to it and renamed over it, so readers see the old or the new file
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out) {
+            return -1;
+        }
+        if (json) {
+            write_json(out);
+        } else {
+            write_text(out);
+        }
+        if (!out) {
+            return -1;
+        }
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0 ? 0 : -1;
+}
+
+int Metrics::start_export(const std::string& path, std::chrono::milliseconds interval) {
+    stop_export();
+    const bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    if (write_file(path, json) != 0) {
+        spdlog::error("Unable to write metrics to {}", path);
+        return -1;
+    }
+    m_export_stop = false;
+    m_export_thread = std::thread([this, path, interval, json]() {
+        std::unique_lock<std::mutex> lock(m_export_mutex);
+        while (!m_export_cv.wait_for(lock, interval, [this]() { return m_export_stop; })) {
+            if (write_file(path, json) != 0) {
+                spdlog::warn("Unable to write metrics to {}", path);
+            }
+        }
+        // the final numbers
+        write_file(path, json);
+    });
+    spdlog::info("Writing metrics to {} every {} ms", path, interval.count());
+    return 0;
+}
+
+void Metrics::stop_export() {
+    if (!m_export_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_export_mutex);
+        m_export_stop = true;
+    }
+    m_export_cv.notify_all();
+    m_export_thread.join();
+}
@@ -0,0 +1,140 @@
+#include <MockUsbTransport.h>
+
+int MockUsbTransport::open() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_present) {
+        return -1;
+    }
+    m_open = true;
+    m_opens++;
+    return 0;
+}
+
+int MockUsbTransport::close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_open = false;
+    return 0;
+}
+
+bool MockUsbTransport::is_open() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_open;
+}
+
+int MockUsbTransport::submit(UsbTransfer& transfer) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_open || !m_present) {
+        return -1;
+    }
+    auto status = UsbStatus::Completed;
+    if (m_fail_next > 0) {
+        m_fail_next--;
+        status = m_fail_status;
+    } else if (m_failure_rate > 0 && std::uniform_real_distribution<double>(0, 1)(m_rng) < m_failure_rate) {
+        status = UsbStatus::Error;
+    }
+    m_queue.push_back({&transfer, std::chrono::steady_clock::now() + m_latency, status});
+    m_cv.notify_all();
+    return 0;
+}
+
+int MockUsbTransport::handle_events(int timeout_ms) {
+    std::vector<InFlight> done;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while (true) {
+            auto now = std::chrono::steady_clock::now();
+            if (!m_queue.empty() && (m_queue.front().due <= now || !m_present)) {
+                break;
+            }
+            if (now >= deadline) {
+                return 0;
+            }
+            auto wake = m_queue.empty() ? deadline : std::min(deadline, m_queue.front().due);
+            m_cv.wait_until(lock, wake);
+        }
+        auto now = std::chrono::steady_clock::now();
+        while (!m_queue.empty() && (m_queue.front().due <= now || !m_present)) {
+            auto entry = m_queue.front();
+            m_queue.pop_front();
+            if (!m_present) {
+                entry.status = UsbStatus::NoDevice;
+            }
+            if (entry.status == UsbStatus::Completed) {
+                m_frames++;
+                m_bytes += entry.transfer->length;
+                m_last_frame.assign(entry.transfer->buffer.begin(), entry.transfer->buffer.begin() + entry.transfer->length);
+            }
+            done.push_back(entry);
+        }
+    }
+    // Completion callbacks run without the lock, like libusb's
+    for (auto& entry : done) {
+        entry.transfer->status = entry.status;
+        entry.transfer->actual_length = entry.status == UsbStatus::Completed ? entry.transfer->length : 0;
+        if (entry.transfer->on_complete) {
+            entry.transfer->on_complete(*entry.transfer);
+        }
+    }
+    return 0;
+}
+
+bool MockUsbTransport::wait_for_device(int timeout_ms) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_hotplug) {
+        return true;
+    }
+    m_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]() { return m_present; });
+    return m_present;
+}
+
+void MockUsbTransport::set_hotplug(bool hotplug) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_hotplug = hotplug;
+}
+
+void MockUsbTransport::set_latency(std::chrono::microseconds latency) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_latency = latency;
+}
+
+void MockUsbTransport::set_failure_rate(double rate) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_failure_rate = rate;
+}
+
+void MockUsbTransport::fail_next(size_t count, UsbStatus status) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_fail_next = count;
+    m_fail_status = status;
+}
+
+void MockUsbTransport::set_present(bool present) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_present = present;
+    if (!present) {
+        m_open = false;
+    }
+    m_cv.notify_all();
+}
+
+uint64_t MockUsbTransport::frames_received() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_frames;
+}
+
+uint64_t MockUsbTransport::bytes_received() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bytes;
+}
+
+uint64_t MockUsbTransport::opens() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_opens;
+}
+
+std::vector<uint8_t> MockUsbTransport::last_frame() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_last_frame;
+}
@@ -0,0 +1,119 @@
+#include <OutputStage.h>
+
+#include <algorithm>
+#include <cmath>
+
+// Pixels per block: the table lookups fill a block of levels, then the
+// scale/dither/sum pass runs over it as plain arithmetic the compiler can vectorize
+static const size_t BLOCK = 64;
+
+static uint32_t to_q16(float value) {
+    return static_cast<uint32_t>(std::clamp(value, 0.0f, 1.0f) * 65536.0f + 0.5f);
+}
+
+void OutputStage::configure(const Config& config) {
+    m_config = config;
+    for (size_t c = 0; c < 3; ++c) {
+        const float balance = std::clamp(config.balance[c], 0.0f, 1.0f);
+        for (size_t v = 0; v < 256; ++v) {
+            const float level = std::pow(v / 255.0f, config.gamma) * balance;
+            m_lut[c * 256 + v] = static_cast<uint16_t>(std::lround(std::clamp(level, 0.0f, 1.0f) * 65280.0f));
+        }
+    }
+    m_scale = to_q16(config.brightness);
+    m_identity = config.gamma == 1.0f && m_scale == 65536 && !config.dither && config.max_milliamps <= 0.0f
+        && config.balance[0] >= 1.0f && config.balance[1] >= 1.0f && config.balance[2] >= 1.0f;
+    if (!config.dither) {
+        m_residual.clear();
+    }
+}
+
+float OutputStage::milliamps(size_t pixels, uint64_t channel_sum) const {
+    return pixels * m_config.idle_milliamps + channel_sum * (m_config.milliamps_per_channel / 255.0f);
+}
+
+void OutputStage::process(const std::vector<uint8_t>& frame, uint8_t* out) {
+    if (frame.empty()) {
+        return;
+    }
+    if (m_identity) {
+        std::copy(frame.begin(), frame.end(), out);
+        m_stats.frames++;
+        return;
+    }
+    out[0] = frame[0];
+    const uint8_t* in = frame.data() + 1;
+    uint8_t* dst = out + 1;
+    const size_t bytes = frame.size() - 1;
+    const size_t pixels = bytes / 3;
+    const size_t used = pixels * 3;
+    if (m_config.dither && m_residual.size() != bytes) {
+        // half a step, so the first frame rounds
+        m_residual.assign(bytes, 128);
+    }
+
+    const uint32_t scale = m_scale;
+    uint32_t level[BLOCK * 3];
+    // sum of the levels at full brightness (8.8) and of the bytes sent
+    uint64_t full = 0;
+    uint64_t sent = 0;
+    for (size_t start = 0; start < used; start += BLOCK * 3) {
+        const size_t count = std::min(BLOCK * 3, used - start);
+        for (size_t i = 0; i < count; i += 3) {
+            level[i] = m_lut[in[start + i]];
+            level[i + 1] = m_lut[256 + in[start + i + 1]];
+            level[i + 2] = m_lut[512 + in[start + i + 2]];
+        }
+        if (m_config.dither) {
+            uint8_t* residual = m_residual.data() + start;
+            for (size_t i = 0; i < count; ++i) {
+                full += level[i];
+                const uint32_t value = ((level[i] * scale) >> 16) + residual[i];
+                dst[start + i] = static_cast<uint8_t>(value >> 8);
+                residual[i] = static_cast<uint8_t>(value);
+                sent += value >> 8;
+            }
+        } else {
+            for (size_t i = 0; i < count; ++i) {
+                full += level[i];
+                const uint32_t value = (((level[i] * scale) >> 16) + 128) >> 8;
+                dst[start + i] = static_cast<uint8_t>(value);
+                sent += value;
+            }
+        }
+    }
+    // a trailing partial pixel goes out as it is
+    std::copy(in + used, in + bytes, dst + used);
+
+    float applied = scale / 65536.0f;
+    float drawn = milliamps(pixels, sent);
+    const float max = m_config.max_milliamps;
+    const float idle = pixels * m_config.idle_milliamps;
+    if (max > 0.0f && drawn > max) {
+        const float factor = drawn > idle ? std::clamp((max - idle) / (drawn - idle), 0.0f, 1.0f) : 0.0f;
+        const uint32_t k = to_q16(factor);
+        for (size_t i = 0; i < used; ++i) {
+            dst[i] = static_cast<uint8_t>((dst[i] * k) >> 16);
+        }
+        drawn = idle + (drawn - idle) * factor;
+        applied *= factor;
+        m_stats.limited++;
+    }
+
+    // Next frame's scale: the brightness, lowered if this frame would need it
+    float next = std::clamp(m_config.brightness, 0.0f, 1.0f);
+    if (max > 0.0f) {
+        // rounding (or dithering) can put every channel up to a step above its level
+        const float headroom = milliamps(0, used) * (m_config.dither ? 1.0f : 0.5f);
+        const float wanted = idle + headroom + (milliamps(0, full) / 256.0f) * next;
+        if (wanted > max) {
+            next *= wanted > idle + headroom
+                ? std::clamp((max - idle - headroom) / (wanted - idle - headroom), 0.0f, 1.0f) : 0.0f;
+        }
+    }
+    m_scale = to_q16(next);
+
+    m_stats.frames++;
+    m_stats.milliamps = drawn;
+    m_stats.scale = applied;
+}
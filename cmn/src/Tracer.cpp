@@ -0,0 +1,169 @@
+#include <Tracer.h>
+
+#include "spdlog/spdlog.h"
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#include <unistd.h>
+
+static volatile std::sig_atomic_t s_dump_requested = 0;
+static volatile std::sig_atomic_t s_toggle_requested = 0;
+
+static void on_dump_signal(int) {
+    s_dump_requested = 1;
+}
+
+static void on_toggle_signal(int) {
+    s_toggle_requested = 1;
+}
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::~Tracer() {
+    m_watch_stop = true;
+    if (m_watch_thread.joinable()) {
+        m_watch_thread.join();
+    }
+}
+
+void Tracer::set_thread_name(const char* name) {
+    t_name = name;
+    if (t_buffer) {
+        t_buffer->name.store(name, std::memory_order_relaxed);
+    }
+}
+
+Tracer::Buffer& Tracer::buffer() {
+    if (!t_buffer) {
+        auto buffer = std::make_unique<Buffer>();
+        buffer->events.resize(CAPACITY);
+        buffer->name.store(t_name, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        buffer->tid = static_cast<uint32_t>(m_buffers.size() + 1);
+        t_buffer = buffer.get();
+        m_buffers.push_back(std::move(buffer));
+    }
+    return *t_buffer;
+}
+
+void Tracer::record(const char* name, uint64_t start_ns, uint64_t end_ns, uint64_t frame) {
+    Buffer& b = buffer();
+    const uint64_t head = b.head.load(std::memory_order_relaxed);
+    b.events[head & (CAPACITY - 1)] = Event{name, start_ns, end_ns, frame};
+    b.head.store(head + 1, std::memory_order_release);
+}
+
+void Tracer::write_chrome_json(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    fmt::memory_buffer text;
+    fmt::format_to(std::back_inserter(text), "{{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    const char* separator = "";
+    std::vector<Event> events;
+    for (const auto& buffer : m_buffers) {
+        const char* name = buffer->name.load(std::memory_order_relaxed);
+        fmt::format_to(std::back_inserter(text),
+            "{}{{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": {}, \"args\": {{\"name\": \"{}\"}}}}",
+            separator, buffer->tid, name ? name : fmt::format("thread {}", buffer->tid));
+        separator = ",\n";
+
+        // The thread keeps writing while this copies: whatever it may have
+        // overwritten meanwhile (up to the slot it's writing now) is left out
+        const uint64_t head = buffer->head.load(std::memory_order_acquire);
+        const uint64_t first = head > CAPACITY ? head - CAPACITY : 0;
+        events.clear();
+        for (uint64_t i = first; i < head; ++i) {
+            events.push_back(buffer->events[i & (CAPACITY - 1)]);
+        }
+        const uint64_t after = buffer->head.load(std::memory_order_acquire);
+        const uint64_t valid = after + 1 > CAPACITY ? after + 1 - CAPACITY : 0;
+        const size_t skip = static_cast<size_t>(std::min<uint64_t>(valid > first ? valid - first : 0, events.size()));
+
+        for (size_t i = skip; i < events.size(); ++i) {
+            const Event& event = events[i];
+            // names are string literals, no escaping needed
+            // microseconds, printed from integers
+            const uint64_t ts = event.start_ns - std::min(event.start_ns, m_epoch_ns);
+            const uint64_t dur = event.end_ns - std::min(event.end_ns, event.start_ns);
+            fmt::format_to(std::back_inserter(text),
+                ",\n{{\"name\": \"{}\", \"ph\": \"X\", \"pid\": 1, \"tid\": {}, \"ts\": {}.{:03}, \"dur\": {}.{:03}",
+                event.name, buffer->tid, ts / 1000, ts % 1000, dur / 1000, dur % 1000);
+            if (event.frame != NO_FRAME) {
+                fmt::format_to(std::back_inserter(text), ", \"args\": {{\"frame\": {}}}", event.frame);
+            }
+            text.push_back('}');
+        }
+    }
+    fmt::format_to(std::back_inserter(text), "\n]}}\n");
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+int Tracer::dump(const std::string& path) const {
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out) {
+            spdlog::error("Unable to write trace to {}", path);
+            return -1;
+        }
+        write_chrome_json(out);
+        if (!out) {
+            spdlog::error("Unable to write trace to {}", path);
+            return -1;
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        spdlog::error("Unable to write trace to {}", path);
+        return -1;
+    }
+    spdlog::info("Wrote trace to {}", path);
+    return 0;
+}
+
+int Tracer::watch(const std::string& path) {
+    unwatch();
+    if (dump(path) != 0) {
+        return -1;
+    }
+    m_path = path;
+    set_enabled(true);
+    std::signal(SIGUSR1, on_dump_signal);
+    std::signal(SIGUSR2, on_toggle_signal);
+    m_watch_stop = false;
+    // signal handlers can only set flags, this does the work
+    m_watch_thread = std::thread([this]() {
+        while (!m_watch_stop) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            if (s_toggle_requested) {
+                s_toggle_requested = 0;
+                set_enabled(!enabled());
+                spdlog::info("Tracing {}", enabled() ? "on" : "off");
+            }
+            if (s_dump_requested) {
+                s_dump_requested = 0;
+                dump(m_path);
+            }
+        }
+    });
+    spdlog::info("Tracing to {}: kill -USR1 {} dumps, -USR2 toggles", path, static_cast<long>(getpid()));
+    return 0;
+}
+
+void Tracer::unwatch() {
+    if (!m_watch_thread.joinable()) {
+        return;
+    }
+    m_watch_stop = true;
+    m_watch_thread.join();
+    std::signal(SIGUSR1, SIG_DFL);
+    std::signal(SIGUSR2, SIG_DFL);
+    dump(m_path);
+}
@@ -1,12 +1,17 @@
 #include <Usb.h>
+#include <Metrics.h>
+#include <Tracer.h>
 
 #include <libusb-1.0/libusb.h>
 #include "spdlog/spdlog.h"
 #include <fmt/core.h>
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <utility>
 
 template <> struct fmt::formatter<libusb_device_descriptor> {
     // A simple formatter that doesn't parse any format specs.
@@ -24,82 +29,243 @@ template <> struct fmt::formatter<libusb_device_descriptor> {
     }
 };
 
+// Looked up once, recording never locks. Shared by every device.
+struct UsbMetrics {
+    Metrics::Counter& opens = Metrics::instance().counter("usb.opens");
+    Metrics::Counter& submitted = Metrics::instance().counter("usb.submitted");
+    Metrics::Counter& submit_errors = Metrics::instance().counter("usb.submit_errors");
+    Metrics::Counter& completed = Metrics::instance().counter("usb.completed");
+    Metrics::Counter& failed = Metrics::instance().counter("usb.failed");
+    // submit to completion callback
+    Metrics::Histogram& transfer_ns = Metrics::instance().histogram("usb.transfer_ns");
+    // blocking write_and_reopen()
+    Metrics::Histogram& write_ns = Metrics::instance().histogram("usb.write_ns");
+};
+
+static UsbMetrics& usb_metrics() {
+    static UsbMetrics metrics;
+    return metrics;
+}
+
 Usb::Usb(uint64_t m_vendor_id, uint64_t m_product_id)
     : m_vendor_id(m_vendor_id), m_product_id(m_product_id) {}
 
+Usb::Usb(uint64_t m_vendor_id, uint64_t m_product_id, const std::string& serial)
+    : m_vendor_id(m_vendor_id), m_product_id(m_product_id), m_serial(serial) {}
+
+static std::string read_string(libusb_device_handle* handle, uint8_t index) {
+    if (index == 0) {
+        return std::string();
+    }
+    unsigned char buffer[256];
+    int r = libusb_get_string_descriptor_ascii(handle, index, buffer, sizeof(buffer));
+    return r > 0 ? std::string(reinterpret_cast<char*>(buffer), r) : std::string();
+}
+
+static void set_log_level(libusb_context* ctx) {
+    if (spdlog::get_level() == spdlog::level::debug)
+        libusb_set_option(ctx, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_DEBUG);
+    else if (spdlog::get_level() == spdlog::level::info)
+        libusb_set_option(ctx, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_INFO);
+    else if (spdlog::get_level() == spdlog::level::warn)
+        libusb_set_option(ctx, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_WARNING);
+    else if (spdlog::get_level() == spdlog::level::err)
+        libusb_set_option(ctx, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_ERROR);
+}
+
+// One libusb context for the process, made on first use. It lives until the
+// process exits, so reconnecting never pays for libusb_init/libusb_exit again
+// and hotplug callbacks stay registered across them.
+static libusb_context* shared_context() {
+    static libusb_context* ctx = []() -> libusb_context* {
+        libusb_context* ctx = nullptr;
+        int r = libusb_init(&ctx);
+        if (r < 0) {
+            spdlog::error("Error initializing libusb: {}", libusb_error_name(r));
+            return nullptr;
+        }
+        set_log_level(ctx);
+        return ctx;
+    }();
+    return ctx;
+}
+
+// How often wait_for_device() says to try anyway, in case hotplug missed the device
+static const std::chrono::seconds HOTPLUG_POLL_INTERVAL(2);
+
+static int LIBUSB_CALL on_hotplug_event(libusb_context*, libusb_device* device,
+        libusb_hotplug_event event, void* user_data) {
+    static_cast<Usb*>(user_data)->on_hotplug(device, event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED);
+    // stay registered
+    return 0;
+}
+
+int Usb::list_serials(std::vector<std::string>& serials, uint64_t vendor_id, uint64_t product_id) {
+    serials.clear();
+    libusb_context* ctx = shared_context();
+    if (!ctx) {
+        return LIBUSB_ERROR_OTHER;
+    }
+    libusb_device** list = nullptr;
+    ssize_t count = libusb_get_device_list(ctx, &list);
+    if (count < 0) {
+        spdlog::error("Error getting device list: {}", libusb_error_name(count));
+        return count;
+    }
+    for (ssize_t i = 0; i < count; ++i) {
+        libusb_device_descriptor desc;
+        if (libusb_get_device_descriptor(list[i], &desc) < 0
+                || desc.idVendor != vendor_id || desc.idProduct != product_id) {
+            continue;
+        }
+        libusb_device_handle* handle = nullptr;
+        int r = libusb_open(list[i], &handle);
+        if (r < 0) {
+            spdlog::warn("Error opening device to read its serial: {}", libusb_error_name(r));
+            continue;
+        }
+        serials.push_back(read_string(handle, desc.iSerialNumber));
+        libusb_close(handle);
+    }
+    libusb_free_device_list(list, 1);
+    return 0;
+}
+
 Usb::~Usb() {
+    deregister_hotplug();
     close();
 }
 
+// The hotplug callback points at the object it was registered for, so a
+// moved-from Usb drops its registration and the new one registers again
 Usb::Usb(Usb&& other) noexcept {
     if (this != &other) {
+        other.deregister_hotplug();
         m_vendor_id = other.m_vendor_id;
         m_product_id = other.m_product_id;
+        m_serial = std::move(other.m_serial);
+        m_opened_serial = std::move(other.m_opened_serial);
         m_ctx = other.m_ctx;
-        m_list = other.m_list;
+        m_device = other.m_device.load();
         m_dev_handle = other.m_dev_handle;
         m_out_endpoint_address = other.m_out_endpoint_address;
+        m_arrived = other.m_arrived.load();
+        m_left = other.m_left.load();
 
         // Nullify the other's pointers to prevent double free
         other.m_ctx = nullptr;
-        other.m_list = nullptr;
+        other.m_device = nullptr;
         other.m_dev_handle = nullptr;
         other.m_out_endpoint_address = 0;
     }
 }
 
 Usb& Usb::operator=(Usb&& other) noexcept {
-    *this = std::move(other);
+    if (this != &other) {
+        deregister_hotplug();
+        other.deregister_hotplug();
+        close();
+        m_vendor_id = other.m_vendor_id;
+        m_product_id = other.m_product_id;
+        m_serial = std::move(other.m_serial);
+        m_opened_serial = std::move(other.m_opened_serial);
+        m_ctx = std::exchange(other.m_ctx, nullptr);
+        m_device = other.m_device.exchange(nullptr);
+        m_dev_handle = std::exchange(other.m_dev_handle, nullptr);
+        m_out_endpoint_address = std::exchange(other.m_out_endpoint_address, 0);
+        m_arrived = other.m_arrived.load();
+        m_left = other.m_left.load();
+    }
     return *this;
 }
 
+void Usb::register_hotplug() {
+    if (m_hotplug || !m_ctx || !libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+        return;
+    }
+    int r = libusb_hotplug_register_callback(m_ctx,
+        static_cast<libusb_hotplug_event>(LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT),
+        LIBUSB_HOTPLUG_NO_FLAGS, static_cast<int>(m_vendor_id), static_cast<int>(m_product_id),
+        LIBUSB_HOTPLUG_MATCH_ANY, on_hotplug_event, this, &m_hotplug_handle);
+    if (r != LIBUSB_SUCCESS) {
+        spdlog::warn("Unable to register for USB hotplug, polling instead: {}", libusb_error_name(r));
+        return;
+    }
+    m_hotplug = true;
+}
+
+void Usb::deregister_hotplug() {
+    if (m_hotplug) {
+        libusb_hotplug_deregister_callback(m_ctx, m_hotplug_handle);
+        m_hotplug = false;
+    }
+}
+
+void Usb::on_hotplug(libusb_device* device, bool arrived) {
+    if (arrived) {
+        // could be another device with the same VID/PID, open() checks the serial
+        m_arrived = true;
+    } else if (device == m_device) {
+        m_left = true;
+    }
+}
+
+bool Usb::wait_for_device(int timeout_ms) {
+    m_ctx = shared_context();
+    register_hotplug();
+    // A transfer error on a device that never left: reopen right away
+    if (!m_hotplug || !m_left) {
+        return true;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (m_arrived.exchange(false) || now - m_last_attempt >= HOTPLUG_POLL_INTERVAL) {
+        m_last_attempt = now;
+        return true;
+    }
+    timeval tv{timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+    libusb_handle_events_timeout_completed(m_ctx, &tv, nullptr);
+    if (m_arrived.exchange(false)) {
+        m_last_attempt = std::chrono::steady_clock::now();
+        return true;
+    }
+    return false;
+}
+
 int Usb::open() {
     // https://libusb.sourceforge.io/api-1.0/
     // https://stackoverflow.com/questions/17239565/how-to-most-properly-use-libusb-to-talk-to-connected-usb-devices
-    // libusb_device_handle* dev_handle = nullptr;
     int r = 0; // For return values
 
-    // Initialize libusb
-    r = libusb_init(&m_ctx);
-    if (r < 0) {
-        spdlog::error("Error initializing libusb: {}",  libusb_error_name(r));
-        return r;
+    close();
+    m_ctx = shared_context();
+    if (!m_ctx) {
+        return LIBUSB_ERROR_OTHER;
     }
-
-    // Set verbosity level (optional)
-    
-    if (spdlog::get_level() == spdlog::level::debug) 
-        libusb_set_option(m_ctx, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_DEBUG);
-    else if (spdlog::get_level() == spdlog::level::info)
-        libusb_set_option(m_ctx, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_INFO);
-    else if (spdlog::get_level() == spdlog::level::warn)
-        libusb_set_option(m_ctx, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_WARNING);
-    else if (spdlog::get_level() == spdlog::level::err)
-        libusb_set_option(m_ctx, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_ERROR);
+    register_hotplug();
 
     // Get a list of all connected USB devices
-    ssize_t count = libusb_get_device_list(m_ctx, &m_list);
+    libusb_device** list = nullptr;
+    ssize_t count = libusb_get_device_list(m_ctx, &list);
     if (count < 0) {
         spdlog::error("Error getting device list: {}", libusb_error_name(count));
-        close();
         return count;
     }
 
     // Iterate through devices to find the desired one
     for (ssize_t i = 0; i < count; ++i) {
-        libusb_device* device = m_list[i];
+        libusb_device* device = list[i];
         libusb_device_descriptor desc;
         r = libusb_get_device_descriptor(device, &desc);
         if (r < 0) {
             spdlog::warn("Error getting device descriptor: {}",  libusb_error_name(r));
             continue;
         }
+        // The descriptor is cached, no need to open other devices to look at it
+        if (desc.idVendor != m_vendor_id || desc.idProduct != m_product_id) {
+            continue;
+        }
         spdlog::info("Found usb device: {}", desc);
 
-        // if (desc.idVendor == m_vendor_id && desc.idProduct == m_product_id) {
-        //     std::cout << "Found desired device (Vendor ID: 0x" << std::hex << desc.idVendor
-        //               << ", Product ID: 0x" << desc.idProduct << ")" << std::dec << std::endl;
-
         // Open the device
         r = libusb_open(device, &m_dev_handle);
         if (r < 0) {
@@ -113,12 +279,16 @@ int Usb::open() {
         // [2025-10-13 17:16:15.308] [info] Found usb device: libusb_device_descriptor(bcdUSB=0x0200, bDeviceClass=0xef, idVendor=0x16c0, idProduct=0x0483, bcdDevice=0x0279)
         // [2025-10-13 17:16:15.308] [info] Opened device (0x16c0/0x0483): USB Serial
         spdlog::info("Opened device (0x{:04x}/0x{:04x}): {}", desc.idVendor, desc.idProduct, product_string);
-        if (desc.idVendor != m_vendor_id || desc.idProduct != m_product_id) {
-            spdlog::info("Device does not match desired VID/PID (0x{:04x}/0x{:04x}), closing.", m_vendor_id, m_product_id);
+        std::string serial = read_string(m_dev_handle, desc.iSerialNumber);
+        if (!m_serial.empty() && serial != m_serial) {
+            spdlog::info("Device serial {} is not {}, closing.", serial, m_serial);
             libusb_close(m_dev_handle);
             m_dev_handle = nullptr;
             continue;
         }
+        m_opened_serial = serial;
+        m_device = libusb_ref_device(device);
+        libusb_free_device_list(list, 1);
         // Detach kernel driver if active (necessary on some systems)
         if (libusb_kernel_driver_active(m_dev_handle, 0) == 1) { // Assuming interface 0
             r = libusb_detach_kernel_driver(m_dev_handle, 0);
@@ -167,10 +337,19 @@ int Usb::open() {
             close();
             return -1;
         }
+        usb_metrics().opens.add();
+        m_left = false;
         return 0; // Exit device search loop after finding and interacting with the device
     }
 
-    spdlog::error("No USB devices found.");
+    libusb_free_device_list(list, 1);
+    // not plugged in, wait_for_device() waits for it to arrive
+    m_left = true;
+    if (m_serial.empty()) {
+        spdlog::error("No USB devices found.");
+    } else {
+        spdlog::error("No USB device with serial {} found.", m_serial);
+    }
     return -1;
 };
 
@@ -180,45 +359,120 @@ int Usb::close() {
         libusb_release_interface(m_dev_handle, 0);
         libusb_close(m_dev_handle);
     }
-    // Free the device list and exit libusb
-    if (m_list) libusb_free_device_list(m_list, 1);
-    if (m_ctx) libusb_exit(m_ctx);
-    
+    // The context stays, it's shared
+    if (m_device) libusb_unref_device(m_device);
+
     m_dev_handle = nullptr;
-    m_list = nullptr;
-    m_ctx = nullptr;
+    m_device = nullptr;
+    m_out_endpoint_address = 0;
     return -1;
 }
 
+void Usb::pack(const std::vector<uint8_t>& frame, std::vector<uint8_t>& out) {
+    out.resize(std::max(frame.size(), MIN_TRANSFER_SIZE));
+    std::copy(frame.begin(), frame.end(), out.begin());
+    std::fill(out.begin() + frame.size(), out.end(), 0);
+}
+
 bool Usb::is_open() {
     return m_dev_handle;
 }
 
-int Usb::write_and_reopen(std::vector<uint8_t>& data, int timeout_ms, bool is_retry) {
-    if (!is_open()) {
+int Usb::write_and_reopen(std::vector<uint8_t>& data, int timeout_ms) {
+    if (!is_open() && (!wait_for_device(0) || open() != 0)) {
         spdlog::error("Device not open. Cannot write data.");
-        return -1;
+        return LIBUSB_ERROR_NO_DEVICE;
     }
     // Write data to the OUT endpoint
     int actual_length;
-    // CANT SEND DATA SMALLER THAN 7 BYTES
-    if (data.size() < 8) {
-        spdlog::warn("Data size {} is less than 8 bytes, padding with zeros.", data.size());
-        data.resize(8, 0);
+    if (data.size() < MIN_TRANSFER_SIZE) {
+        spdlog::warn("Data size {} is less than {} bytes, padding with zeros.", data.size(), MIN_TRANSFER_SIZE);
+        data.resize(MIN_TRANSFER_SIZE, 0);
     }
 
+    const uint64_t start = Metrics::now_ns();
     int r = libusb_bulk_transfer(m_dev_handle, m_out_endpoint_address,
                                 data.data(), data.size(),
                                 &actual_length, timeout_ms);
+    const uint64_t end = Metrics::now_ns();
+    usb_metrics().write_ns.record(end - start);
+    if (Tracer::enabled()) {
+        Tracer::instance().record("usb.bulk_transfer", start, end, Tracer::frame());
+    }
 
     if (r == 0) {
         spdlog::debug("Successfully wrote {} bytes to the device.", actual_length);
     } else {
-        spdlog::error("Error writing data: {} ({}) - trying to reopen", libusb_error_name(r), r);
-        if (!is_retry) {
-            r = open();
-            r = write_and_reopen(data, timeout_ms, true);
+        spdlog::error("Error writing data: {} ({}) - reopening on the next write", libusb_error_name(r), r);
+        close();
+    }
+    return r;
+}
+
+static UsbStatus to_usb_status(libusb_transfer_status status) {
+    switch (status) {
+        case LIBUSB_TRANSFER_COMPLETED: return UsbStatus::Completed;
+        case LIBUSB_TRANSFER_TIMED_OUT: return UsbStatus::TimedOut;
+        case LIBUSB_TRANSFER_CANCELLED: return UsbStatus::Cancelled;
+        case LIBUSB_TRANSFER_NO_DEVICE: return UsbStatus::NoDevice;
+        default: return UsbStatus::Error;
+    }
+}
+
+static void on_transfer_done(libusb_transfer* native) {
+    auto transfer = static_cast<UsbTransfer*>(native->user_data);
+    transfer->status = to_usb_status(native->status);
+    transfer->actual_length = native->actual_length;
+    auto& metrics = usb_metrics();
+    const uint64_t now = Metrics::now_ns();
+    metrics.transfer_ns.record(now - transfer->submitted_ns);
+    if (Tracer::enabled()) {
+        Tracer::instance().record("usb.transfer", transfer->submitted_ns, now, transfer->trace_frame);
+    }
+    (transfer->status == UsbStatus::Completed ? metrics.completed : metrics.failed).add();
+    if (transfer->on_complete) {
+        transfer->on_complete(*transfer);
+    }
+}
+
+int Usb::submit(UsbTransfer& transfer) {
+    if (!is_open() || m_left) {
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+    auto native = static_cast<libusb_transfer*>(transfer.native);
+    if (!native) {
+        native = libusb_alloc_transfer(0);
+        if (!native) {
+            return LIBUSB_ERROR_NO_MEM;
         }
+        transfer.native = native;
+    }
+    libusb_fill_bulk_transfer(native, m_dev_handle, m_out_endpoint_address,
+                              transfer.buffer.data(), transfer.length,
+                              on_transfer_done, &transfer, transfer.timeout_ms);
+    transfer.submitted_ns = Metrics::now_ns();
+    int r = libusb_submit_transfer(native);
+    if (r < 0) {
+        usb_metrics().submit_errors.add();
+        spdlog::error("Error submitting transfer: {} ({})", libusb_error_name(r), r);
+    } else {
+        usb_metrics().submitted.add();
     }
     return r;
+}
+
+void Usb::release(UsbTransfer& transfer) {
+    if (transfer.native) {
+        libusb_free_transfer(static_cast<libusb_transfer*>(transfer.native));
+        transfer.native = nullptr;
+    }
+}
+
+int Usb::handle_events(int timeout_ms) {
+    if (!m_ctx) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+    timeval tv{timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+    return libusb_handle_events_timeout_completed(m_ctx, &tv, nullptr);
 }
\ No newline at end of file
@@ -0,0 +1,293 @@
+#include <UsbOutput.h>
+#include <Metrics.h>
+#include <Tracer.h>
+#include <Usb.h>
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+
+// How long the event thread blocks in the transport before looking at its flags
+static const int EVENT_TIMEOUT_MS = 100;
+static const std::chrono::milliseconds MIN_RECONNECT_DELAY{250};
+static const std::chrono::milliseconds MAX_RECONNECT_DELAY{2000};
+
+// Looked up once, recording never locks
+struct LatencyMetrics {
+    // submitted to completed
+    Metrics::Histogram& usb_ns = Metrics::instance().histogram("latency.usb_ns");
+    // captured to completed: sound to light, short of the controller's own delay
+    Metrics::Histogram& total_ns = Metrics::instance().histogram("latency.total_ns");
+};
+
+static LatencyMetrics& latency_metrics() {
+    static LatencyMetrics metrics;
+    return metrics;
+}
+
+UsbOutput::UsbOutput(std::unique_ptr<UsbTransport> transport, size_t max_in_flight)
+    : m_transport(std::move(transport)) {
+    if (max_in_flight == 0) max_in_flight = 1;
+    for (size_t i = 0; i < max_in_flight; ++i) {
+        auto slot = std::make_unique<Slot>();
+        slot->transfer.on_complete = [this, i](UsbTransfer& transfer) {
+            this->on_complete(i, transfer);
+        };
+        m_slots.push_back(std::move(slot));
+    }
+}
+
+UsbOutput::~UsbOutput() {
+    stop();
+}
+
+int UsbOutput::start() {
+    if (m_thread.joinable()) {
+        return 0;
+    }
+    m_stop = false;
+    m_connected = false;
+    // The first open happens on the event thread too
+    m_thread = std::thread(&UsbOutput::event_thread, this);
+    return 0;
+}
+
+void UsbOutput::stop() {
+    m_stop = true;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    m_thread = std::thread();
+}
+
+int UsbOutput::set_transport(std::unique_ptr<UsbTransport> transport) {
+    if (m_thread.joinable() || !transport) {
+        spdlog::error("The transport can only be changed while the USB output is stopped");
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& slot : m_slots) {
+        m_transport->release(slot->transfer);
+    }
+    m_transport->close();
+    m_transport = std::move(transport);
+    return 0;
+}
+
+void UsbOutput::set_wire_format(WireFormat format, size_t keyframe_interval) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_wire_format = format;
+    m_encoder.set_keyframe_interval(keyframe_interval);
+    m_encoder.request_keyframe();
+}
+
+void UsbOutput::set_output_stage(const OutputStage::Config& config) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stage.configure(config);
+}
+
+bool UsbOutput::ready() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_connected && m_in_flight < m_slots.size();
+}
+
+bool UsbOutput::send(const std::vector<uint8_t>& frame, uint16_t frame_number, uint64_t origin_ns) {
+    Tracer::Span span("usb.send");
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_connected) {
+        m_dropped++;
+        return false;
+    }
+    for (size_t i = 0; i < m_slots.size(); ++i) {
+        if (!m_slots[i]->busy) {
+            if (!encode_locked(frame, frame_number, i)) {
+                return true;
+            }
+            m_slots[i]->transfer.trace_frame = Tracer::frame();
+            m_slots[i]->transfer.origin_ns = origin_ns;
+            return submit_locked(i);
+        }
+    }
+    // Everything is in flight, keep only the newest frame
+    if (m_has_pending) {
+        m_dropped++;
+    }
+    m_pending.assign(frame.begin(), frame.end());
+    m_pending_number = frame_number;
+    m_pending_trace_frame = Tracer::frame();
+    m_pending_origin_ns = origin_ns;
+    m_has_pending = true;
+    return true;
+}
+
+// Fills the slot's buffer, returns false if there is nothing to send
+bool UsbOutput::encode_locked(const std::vector<uint8_t>& frame, uint16_t frame_number, size_t i) {
+    auto& buffer = m_slots[i]->transfer.buffer;
+    m_raw_bytes += frame.size();
+    if (m_wire_format == WireFormat::Numbered && !frame.empty()) {
+        // the stage copies the v1 header byte to [2], the number overwrites it
+        const size_t size = frame.size() - 1 + frame_format::V3_HEADER_SIZE;
+        buffer.resize(std::max(size, Usb::MIN_TRANSFER_SIZE));
+        m_stage.process(frame, buffer.data() + frame_format::V3_HEADER_SIZE - 1);
+        buffer[0] = frame_format::V3_HEADER;
+        buffer[1] = static_cast<uint8_t>(frame_number);
+        buffer[2] = static_cast<uint8_t>(frame_number >> 8);
+        std::fill(buffer.begin() + size, buffer.end(), 0);
+        return true;
+    }
+    if (m_wire_format == WireFormat::Raw) {
+        // straight into the transfer buffer, zero padded like Usb::pack
+        buffer.resize(std::max(frame.size(), Usb::MIN_TRANSFER_SIZE));
+        m_stage.process(frame, buffer.data());
+        std::fill(buffer.begin() + frame.size(), buffer.end(), 0);
+        return true;
+    }
+    m_staged.resize(frame.size());
+    m_stage.process(frame, m_staged.data());
+    if (!m_encoder.encode(m_staged, m_encoded)) {
+        return false;
+    }
+    Usb::pack(m_encoded, buffer);
+    return true;
+}
+
+bool UsbOutput::submit_locked(size_t i) {
+    auto& slot = *m_slots[i];
+    slot.transfer.length = slot.transfer.buffer.size();
+    slot.transfer.timeout_ms = m_timeout_ms;
+    slot.transfer.submitted_ns = Metrics::now_ns();
+    int r = m_transport->submit(slot.transfer);
+    if (r < 0) {
+        m_failed++;
+        m_connected = false;
+        m_encoder.request_keyframe();
+        return false;
+    }
+    m_bytes_sent += slot.transfer.length;
+    slot.busy = true;
+    m_in_flight++;
+    m_submitted++;
+    return true;
+}
+
+void UsbOutput::on_complete(size_t i, UsbTransfer& transfer) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_slots[i]->busy = false;
+    m_in_flight--;
+    if (transfer.status == UsbStatus::Completed) {
+        m_completed++;
+        auto& latency = latency_metrics();
+        const uint64_t now = Metrics::now_ns();
+        latency.usb_ns.record(now - transfer.submitted_ns);
+        if (transfer.origin_ns != 0 && transfer.origin_ns < now) {
+            latency.total_ns.record(now - transfer.origin_ns);
+        }
+        spdlog::debug("Successfully wrote {} bytes to the device.", transfer.actual_length);
+    } else {
+        m_failed++;
+        // the receiver may have missed a delta
+        m_encoder.request_keyframe();
+        if (transfer.status == UsbStatus::Error || transfer.status == UsbStatus::NoDevice) {
+            if (m_connected) {
+                spdlog::error("USB transfer failed ({}), reconnecting in the background", static_cast<int>(transfer.status));
+            }
+            m_connected = false;
+        }
+    }
+    if (m_connected && m_has_pending) {
+        m_has_pending = false;
+        if (encode_locked(m_pending, m_pending_number, i)) {
+            m_slots[i]->transfer.trace_frame = m_pending_trace_frame;
+            m_slots[i]->transfer.origin_ns = m_pending_origin_ns;
+            submit_locked(i);
+        }
+    }
+}
+
+void UsbOutput::event_thread() {
+    Tracer::set_thread_name("usb");
+    while (!m_stop) {
+        if (!m_connected) {
+            reconnect();
+            continue;
+        }
+        m_transport->handle_events(EVENT_TIMEOUT_MS);
+    }
+    drain();
+    for (auto& slot : m_slots) {
+        m_transport->release(slot->transfer);
+    }
+    m_transport->close();
+}
+
+void UsbOutput::drain() {
+    // Let in flight transfers complete (or fail) before their buffers go away
+    for (int i = 0; i < 20; ++i) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_in_flight == 0) {
+                return;
+            }
+        }
+        m_transport->handle_events(EVENT_TIMEOUT_MS);
+    }
+    spdlog::warn("USB transfers still in flight after draining");
+}
+
+void UsbOutput::reconnect() {
+    drain();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_in_flight > 0) {
+            // try again, the transport still owns those buffers
+            return;
+        }
+        m_has_pending = false;
+        // the device starts from scratch after a reconnect
+        m_encoder.request_keyframe();
+        for (auto& slot : m_slots) {
+            m_transport->release(slot->transfer);
+        }
+    }
+    m_transport->close();
+    // hotplug (where the transport has it) says when the device is back
+    if (!m_transport->wait_for_device(EVENT_TIMEOUT_MS)) {
+        return;
+    }
+    if (m_transport->open() == 0) {
+        spdlog::info("USB output connected");
+        if (m_was_connected) {
+            m_reconnects++;
+        }
+        m_was_connected = true;
+        m_reconnect_delay = MIN_RECONNECT_DELAY;
+        m_connected = true;
+        return;
+    }
+    // Back off without holding up stop()
+    auto until = std::chrono::steady_clock::now() + m_reconnect_delay;
+    while (!m_stop && std::chrono::steady_clock::now() < until) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(EVENT_TIMEOUT_MS) / 4);
+    }
+    m_reconnect_delay = std::min(m_reconnect_delay * 2, MAX_RECONNECT_DELAY);
+}
+
+UsbOutput::Stats UsbOutput::stats() const {
+    Stats stats;
+    stats.submitted = m_submitted;
+    stats.completed = m_completed;
+    stats.failed = m_failed;
+    stats.dropped = m_dropped;
+    stats.reconnects = m_reconnects;
+    stats.connected = m_connected;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    stats.in_flight = m_in_flight;
+    stats.bytes_sent = m_bytes_sent;
+    stats.raw_bytes = m_raw_bytes;
+    stats.keyframes = m_encoder.stats().keyframes;
+    stats.unchanged = m_encoder.stats().unchanged;
+    stats.milliamps = m_stage.stats().milliamps;
+    stats.output_scale = m_stage.stats().scale;
+    stats.power_limited = m_stage.stats().limited;
+    return stats;
+}
@@ -0,0 +1,209 @@
+#include <UsbOutputGroup.h>
+#include <FrameDecoder.h>
+#include <Usb.h>
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+UsbOutputGroup::~UsbOutputGroup() {
+    stop();
+}
+
+int UsbOutputGroup::parse_panels(const std::string& spec, std::vector<Panel>& panels) {
+    panels.clear();
+    size_t start = 0;
+    while (start < spec.size()) {
+        size_t end = spec.find(';', start);
+        if (end == std::string::npos) {
+            end = spec.size();
+        }
+        const std::string item = spec.substr(start, end - start);
+        start = end + 1;
+        if (item.empty()) {
+            continue;
+        }
+        const size_t at = item.rfind('@');
+        Panel panel;
+        int used = 0;
+        if (at == std::string::npos || at == 0 || std::sscanf(item.c_str() + at + 1, "%zu,%zu,%zux%zu%n",
+                &panel.x, &panel.y, &panel.width, &panel.height, &used) != 4) {
+            spdlog::error("Bad panel '{}', expected serial@x,y,wxh[:wiring]", item);
+            return -1;
+        }
+        const std::string wiring = item.substr(at + 1 + used);
+        if (wiring == "" || wiring == ":rows") {
+            panel.wiring = Panel::Wiring::RowMajor;
+        } else if (wiring == ":serpentine") {
+            panel.wiring = Panel::Wiring::Serpentine;
+        } else if (wiring == ":columns") {
+            panel.wiring = Panel::Wiring::ColumnSerpentine;
+        } else {
+            spdlog::error("Bad panel '{}': unknown wiring '{}', expected rows, serpentine or columns", item, wiring.substr(1));
+            return -1;
+        }
+        panel.serial = item.substr(0, at);
+        panels.push_back(panel);
+    }
+    return 0;
+}
+
+std::vector<uint32_t> UsbOutputGroup::wiring_table(const Panel& panel) {
+    layout::Serpentine serpentine;
+    layout::ColumnSerpentine columns;
+    serpentine.resize(panel.width, panel.height);
+    columns.resize(panel.width, panel.height);
+    std::vector<uint32_t> table;
+    table.reserve(panel.width * panel.height);
+    for (size_t y = 0; y < panel.height; ++y) {
+        for (size_t x = 0; x < panel.width; ++x) {
+            const size_t index = panel.wiring == Panel::Wiring::Serpentine ? serpentine.index(x, y)
+                : panel.wiring == Panel::Wiring::ColumnSerpentine ? columns.index(x, y) : y * panel.width + x;
+            table.push_back(static_cast<uint32_t>(index));
+        }
+    }
+    return table;
+}
+
+int UsbOutputGroup::add_panel(const Panel& panel, std::unique_ptr<UsbTransport> transport) {
+    if (m_running) {
+        spdlog::error("Can't add panel {} to a running output group", panel.serial);
+        return -1;
+    }
+    if (panel.width == 0 || panel.height == 0 || !transport) {
+        spdlog::error("Panel {} needs a size and a transport", panel.serial);
+        return -1;
+    }
+    Entry entry;
+    entry.panel = panel;
+    entry.layout.resize(panel.width, panel.height);
+    if (!panel.table.empty()) {
+        if (entry.layout.set_table(panel.table) != 0) {
+            spdlog::error("Bad wiring table for panel {}", panel.serial);
+            return -1;
+        }
+        entry.row_major = false;
+    } else if (panel.wiring != Panel::Wiring::RowMajor) {
+        entry.layout.set_table(wiring_table(panel));
+        entry.row_major = false;
+    }
+    entry.output = std::make_unique<UsbOutput>(std::move(transport), m_max_in_flight);
+    entry.output->set_wire_format(UsbOutput::WireFormat::Numbered);
+    entry.frame.assign(1 + panel.width * panel.height * frame_format::BYTES_PER_PIXEL, 0);
+    entry.frame[0] = frame_format::V1_HEADER;
+    m_panels.push_back(std::move(entry));
+    // every panel's share of the power budget just shrank
+    set_output_stage(m_stage);
+    return 0;
+}
+
+int UsbOutputGroup::add_devices(const std::vector<Panel>& panels, uint64_t vendor_id, uint64_t product_id) {
+    std::vector<std::string> serials;
+    if (Usb::list_serials(serials, vendor_id, product_id) != 0) {
+        return -1;
+    }
+    for (const auto& serial : serials) {
+        auto found = std::find_if(panels.begin(), panels.end(), [&serial](const Panel& p) { return p.serial == serial; });
+        if (found == panels.end()) {
+            spdlog::warn("USB device {} has no panel, leaving it alone", serial);
+        }
+    }
+    // Panels not plugged in yet are added too, their outputs keep trying to open them
+    for (const auto& panel : panels) {
+        if (std::find(serials.begin(), serials.end(), panel.serial) == serials.end()) {
+            spdlog::warn("Panel {} is not connected yet", panel.serial);
+        }
+        if (add_panel(panel, std::make_unique<Usb>(vendor_id, product_id, panel.serial)) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+size_t UsbOutputGroup::width() const {
+    size_t width = 0;
+    for (const auto& entry : m_panels) {
+        width = std::max(width, entry.panel.x + entry.panel.width);
+    }
+    return width;
+}
+
+size_t UsbOutputGroup::height() const {
+    size_t height = 0;
+    for (const auto& entry : m_panels) {
+        height = std::max(height, entry.panel.y + entry.panel.height);
+    }
+    return height;
+}
+
+int UsbOutputGroup::start() {
+    if (m_running) {
+        return 0;
+    }
+    for (auto& entry : m_panels) {
+        if (entry.output->start() != 0) {
+            spdlog::error("Unable to start the output for panel {}", entry.panel.serial);
+            stop();
+            return -1;
+        }
+    }
+    m_running = true;
+    return 0;
+}
+
+void UsbOutputGroup::stop() {
+    for (auto& entry : m_panels) {
+        entry.output->stop();
+    }
+    m_running = false;
+}
+
+void UsbOutputGroup::set_output_stage(const OutputStage::Config& config) {
+    m_stage = config;
+    size_t pixels = 0;
+    for (const auto& entry : m_panels) {
+        pixels += entry.panel.width * entry.panel.height;
+    }
+    // The power cap is for the whole wall: each panel gets its share by pixel
+    // count, so together they can never draw more than the budget
+    for (auto& entry : m_panels) {
+        OutputStage::Config panel = config;
+        if (config.max_milliamps > 0.0f && pixels > 0) {
+            panel.max_milliamps = config.max_milliamps * (entry.panel.width * entry.panel.height) / pixels;
+        }
+        entry.output->set_output_stage(panel);
+    }
+}
+
+bool UsbOutputGroup::can_send() {
+    size_t connected = 0;
+    for (const auto& entry : m_panels) {
+        if (!entry.output->connected()) {
+            continue;
+        }
+        connected++;
+        if (!entry.output->ready()) {
+            m_skipped++;
+            return false;
+        }
+    }
+    return connected > 0;
+}
+
+void UsbOutputGroup::send_tiles(uint64_t origin_ns) {
+    for (auto& entry : m_panels) {
+        // disconnected panels count it as dropped
+        entry.output->send(entry.frame, m_frame_number, origin_ns);
+    }
+    m_frame_number++;
+}
+
+std::vector<UsbOutputGroup::PanelStats> UsbOutputGroup::stats() const {
+    std::vector<PanelStats> stats;
+    for (const auto& entry : m_panels) {
+        stats.push_back(PanelStats{entry.panel, entry.output->stats()});
+    }
+    return stats;
+}
@@ -0,0 +1,109 @@
+#include <WorkerPool.h>
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+
+// Pool and index of the worker running on this thread, so nested submits stay local
+static thread_local const WorkerPool* s_pool = nullptr;
+static thread_local int s_worker = -1;
+
+WorkerPool::WorkerPool(size_t num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < num_threads; ++i) {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < num_threads; ++i) {
+        m_workers[i]->thread = std::thread([this, i]() {
+            this->run(i);
+        });
+    }
+    spdlog::info("Started {} worker threads", num_threads);
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleep_mutex);
+        m_stop = true;
+    }
+    m_sleep.notify_all();
+    for (auto& worker : m_workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+int WorkerPool::current_worker() const {
+    return s_pool == this ? s_worker : -1;
+}
+
+void WorkerPool::submit(Task task) {
+    int self = current_worker();
+    size_t index = self >= 0 ? static_cast<size_t>(self) : m_next.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+    {
+        std::lock_guard<std::mutex> lock(m_workers[index]->mutex);
+        m_workers[index]->tasks.push_back(std::move(task));
+    }
+    m_pending.fetch_add(1, std::memory_order_release);
+    // taking the lock orders this against a worker about to sleep, so the wake isn't lost
+    {
+        std::lock_guard<std::mutex> lock(m_sleep_mutex);
+    }
+    m_sleep.notify_one();
+}
+
+bool WorkerPool::take(size_t index, Task& task) {
+    {
+        Worker& own = *m_workers[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.front());
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < m_workers.size(); ++i) {
+        Worker& victim = *m_workers[(index + i) % m_workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            m_workers[index]->stolen.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkerPool::run(size_t index) {
+    s_pool = this;
+    s_worker = static_cast<int>(index);
+    Task task;
+    while (true) {
+        if (take(index, task)) {
+            m_pending.fetch_sub(1, std::memory_order_acq_rel);
+            task();
+            task = nullptr;
+            m_workers[index]->executed.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_sleep_mutex);
+        m_sleep.wait(lock, [this]() {
+            return m_stop || m_pending.load(std::memory_order_acquire) > 0;
+        });
+        if (m_stop) {
+            return;
+        }
+    }
+}
+
+std::vector<WorkerPool::Stats> WorkerPool::stats() const {
+    std::vector<Stats> stats;
+    for (const auto& worker : m_workers) {
+        stats.push_back(Stats{worker->executed.load(std::memory_order_relaxed), worker->stolen.load(std::memory_order_relaxed)});
+    }
+    return stats;
+}